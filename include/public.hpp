@@ -25,7 +25,12 @@ enum EnMsgType
     HEART_CHECK_MSG, // 心跳检测消息
     HEART_CHECK_MSG_ACK, // 心跳检测响应消息
     NAME_CHANGE_MSG, // 更改用户名消息
-    NAME_CHANGE_MSG_ACK // 更改用户名响应消息
+    NAME_CHANGE_MSG_ACK, // 更改用户名响应消息
+    LOGIN_OFFLINE_MSG, // 登录后推送的离线消息
+    LOGIN_FRIEND_LIST_MSG, // 登录后推送的好友列表
+    LOGIN_GROUP_LIST_MSG, // 登录后推送的群组列表
+    OFFLINE_MSG_ACK, // 客户端确认收到一页离线消息
+    PRESENCE_MSG // 好友在线状态变化推送，一帧合并多个好友的变化
 };
 
 #endif  // PUBLIC_H
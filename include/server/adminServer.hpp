@@ -0,0 +1,42 @@
+#ifndef ADMINSERVER_H
+#define ADMINSERVER_H
+
+#include <muduo/net/TcpServer.h>
+#include <muduo/net/EventLoop.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+using namespace muduo;
+using namespace muduo::net;
+
+/*
+管理端口：只认最简单的HTTP/1.x GET请求，按路径返回注册的页面后关闭连接，供Prometheus抓取指标和人工查看统计；
+页面在所属EventLoop线程中生成，生成函数应当很快返回；不做鉴权，只应监听在本机地址上
+*/
+class AdminServer
+{
+public:
+    using PageGenerator = std::function<std::string()>;
+
+    AdminServer(EventLoop *loop, const InetAddress &listenAddr);
+    //注册页面，path形如"/metrics"
+    void addPage(const std::string &path, const std::string &contentType, PageGenerator generator);
+    void start();
+
+private:
+    struct Page
+    {
+        std::string contentType;
+        PageGenerator generator;
+    };
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time);
+    static void reply(const TcpConnectionPtr &conn, const std::string &status,
+                      const std::string &contentType, const std::string &body);
+
+    TcpServer _server;
+    std::unordered_map<std::string, Page> _pages;
+};
+
+#endif // ADMINSERVER_H
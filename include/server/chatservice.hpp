@@ -10,7 +10,11 @@ using namespace std;
 #include "offlineMsgModel.hpp"
 #include "friendModel.hpp"
 #include "groupModel.hpp"
+#include "relationLogModel.hpp"
+#include "groupMemberCache.hpp"
 #include "redis.hpp"
+#include "presenceNotifier.hpp"
+#include "common/InstrumentedMutex.hpp"
 using namespace muduo;
 using namespace muduo::net;
 using json = nlohmann::json;
@@ -31,7 +35,9 @@ public:
     void oneChat(const TcpConnectionPtr &conn, json &js, Timestamp time);
     //处理注册响应业务
     void regAck(const TcpConnectionPtr &conn, json &js, Timestamp time);
-    //服务器异常，业务重置方法
+    //服务器启动时的状态清理
+    void startup();
+    //服务器退出，业务重置方法：本机用户下线并刷出所有待写数据
     void reset();
     //获取消息对应的处理器
     MsgHandler getHandler(int msgid);
@@ -50,6 +56,8 @@ public:
     void groupChat(const TcpConnectionPtr &conn, json &js, Timestamp time);
     //处理注销业务
     void loginout(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    //处理客户端对一页离线消息的确认
+    void offlineMsgAck(const TcpConnectionPtr &conn, json &js, Timestamp time);
 private:
     ChatService();
     //存储消息id和其对应的处理方法
@@ -58,15 +66,57 @@ private:
     //存储在线用户的通信连接
     unordered_map<int, TcpConnectionPtr> _userConnMap;
 
-    //定义互斥锁，保证_userConnMap的线程安全
-    mutex _connMutex;
+    //定义互斥锁，保证_userConnMap的线程安全；所有消息转发都经过这把锁，统计其竞争情况
+    InstrumentedMutex _connMutex{"conn_map"};
     //数据操作类对象
     UserModel _userModel;
     OfflineMsgModel _offlineMsgModel;
     FriendModel _friendModel;
     GroupModel _groupModel;
+    RelationLogModel _relationLogModel;
     Redis _redis;
+    //好友在线状态推送，按接收方防抖合并
+    PresenceNotifier _presenceNotifier;
+    //群成员缓存，群聊转发不再逐条查询数据库
+    GroupMemberCache _groupMemberCache;
+    //本节点标识，用于忽略自己发出的缓存失效通知
+    string _nodeId;
     
+    //离线消息每页条数，限制单帧大小和每个连接占用的内存
+    static const int kOfflinePageSize = 100;
+    //已下发、等待客户端确认的一页离线消息
+    struct OfflineDrain
+    {
+        TcpConnectionPtr conn;
+        int cursor = 0; //本页最后一条消息的id
+        vector<int> ids; //本页消息的id，确认后按id删除
+        bool more = false; //是否还有下一页
+    };
+    //userid -> 待确认的离线消息页
+    unordered_map<int, OfflineDrain> _offlineDrainMap;
+    mutex _drainMutex;
+    //查询并下发一页id大于afterId的离线消息
+    void sendOfflinePage(const TcpConnectionPtr &conn, int userid, int afterId);
+    //登录校验结果返回后的处理：记录连接、更新状态、回复登录响应，再并行推送离线消息、好友和群组
+    //friendVersion/groupVersion为客户端上次同步到的各分片版本号，为空表示需要全量列表
+    void loginVerified(const TcpConnectionPtr &conn, int id, const string &pwd, const vector<long long> &friendVersion,
+                       const vector<long long> &groupVersion, User user, ErrorCode error);
+    //推送好友列表：版本号有效时只下发新增好友和在线好友id，否则下发全量列表
+    void sendFriendList(const TcpConnectionPtr &conn, int userid, const vector<long long> &version);
+    //推送群组列表：版本号有效时只下发新加入和成员有变化的群组，否则下发全量列表
+    void sendGroupList(const TcpConnectionPtr &conn, int userid, const vector<long long> &version);
+    //查询群成员：优先读缓存，未命中时从数据库加载并写入缓存，加载失败返回nullptr
+    GroupMemberCache::Members groupMembers(int groupid);
+    //通知其他节点关系发生了变化：type为'g'时表示用户b加入群组a，为'f'时表示用户a添加好友b，为'u'时表示用户a上线(b=1)或下线(b=0)，
+    //为'r'时表示注册了id为a、用户名为b的新用户
+    void publishRelationChange(char type, int a, int b);
+    void publishRelationChange(char type, int a, const string &b);
+    //处理其他节点发来的关系变化通知
+    void handleRelationChange(string msg);
+    //用户在本节点上线或下线：推送给本节点上的好友并广播给其他节点
+    void presenceChanged(int userid, bool online);
+    //把userid的状态变化推送给本节点上在线的好友
+    void fanOutPresence(int userid, bool online);
     //处理redis订阅消息的回调函数
     void handleRedisSubscribeMessage(int userid, string msg);
 };
@@ -0,0 +1,551 @@
+#ifndef BINARYLOGFORMAT_HPP
+#define BINARYLOGFORMAT_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <istream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 二进制日志格式
+ * 文件以8字节魔数开头，之后是连续的记录，每条记录以1字节类型开头，多字节整数按主机字节序（小端）写入：
+ *   'F' 调用点定义：u32 id, u8 级别, u32 行号, u16 长度 + 文件名, u16 长度 + 格式串
+ *   'E' 日志事件：  u32 id, u64 微秒时间戳, u32 线程id, u16 长度 + 参数
+ *   'L' 丢弃通知：  u64 条数
+ * 参数逐个编码为1字节类型加值：'i' i64, 'u' u64, 'd' double, 's' u16 长度 + 字节, 'p' u64；
+ * 调用点定义在它的第一条事件之前写出，换文件后重新写出，因此每个文件都可以单独解码
+ */
+class BinaryLogFormat {
+public:
+    static constexpr char kMagic[8] = {'C', 'H', 'A', 'T', 'B', 'L', 'G', '1'};
+    static constexpr char kSiteRecord = 'F';
+    static constexpr char kEventRecord = 'E';
+    static constexpr char kDroppedRecord = 'L';
+    static constexpr size_t kMaxString = 0xFFFF;
+
+    // 与LogLevel的取值一一对应，宽度与文本日志一致
+    static const char* levelName(int level) {
+        static const char* const kNames[] = {"DEBUG", "INFO ", "WARN ", "ERROR", "FATAL"};
+        return level >= 0 && level < 5 ? kNames[level] : "UNKNOWN";
+    }
+};
+
+/**
+ * 日志参数缓冲：不超过内联容量时不分配内存，超出后转存到string
+ */
+class BinaryLogBuffer {
+public:
+    static const size_t kInlineBytes = 200;
+
+    BinaryLogBuffer() = default;
+    BinaryLogBuffer(const BinaryLogBuffer& other) { *this = other; }
+    BinaryLogBuffer(BinaryLogBuffer&& other) noexcept { *this = std::move(other); }
+
+    // 只复制已使用的部分，入队出队时不必搬动整个内联数组
+    BinaryLogBuffer& operator=(const BinaryLogBuffer& other) {
+        if (this != &other) {
+            overflow_ = other.overflow_;
+            size_ = other.size_;
+            if (overflow_.empty()) {
+                memcpy(inline_, other.inline_, size_);
+            }
+        }
+        return *this;
+    }
+
+    BinaryLogBuffer& operator=(BinaryLogBuffer&& other) noexcept {
+        if (this != &other) {
+            overflow_ = std::move(other.overflow_);
+            other.overflow_.clear();
+            size_ = other.size_;
+            if (overflow_.empty()) {
+                memcpy(inline_, other.inline_, size_);
+            }
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    void append(const void* data, size_t len) {
+        if (overflow_.empty() && size_ + len <= kInlineBytes) {
+            memcpy(inline_ + size_, data, len);
+        } else {
+            if (overflow_.empty()) {
+                overflow_.assign(inline_, size_);
+            }
+            overflow_.append(static_cast<const char*>(data), len);
+        }
+        size_ += len;
+    }
+
+    template <typename T>
+    void appendValue(T value) {
+        append(&value, sizeof(value));
+    }
+
+    const char* data() const { return overflow_.empty() ? inline_ : overflow_.data(); }
+    size_t size() const { return size_; }
+
+    void clear() {
+        size_ = 0;
+        overflow_.clear();
+    }
+
+private:
+    char inline_[kInlineBytes];
+    size_t size_ = 0;
+    std::string overflow_;
+};
+
+/**
+ * 参数编码：整数、枚举、浮点数、C字符串、std::string和指针，即printf格式串能接受的参数
+ */
+class BinaryLogEncoder {
+public:
+    static void encode(BinaryLogBuffer&) {}
+
+    template <typename T, typename... Rest>
+    static void encode(BinaryLogBuffer& buf, const T& value, const Rest&... rest) {
+        encodeOne(buf, value);
+        encode(buf, rest...);
+    }
+
+private:
+    template <typename T>
+    struct Unsupported : std::false_type {};
+
+    template <typename T>
+    static void encodeOne(BinaryLogBuffer& buf, const T& value) {
+        using D = typename std::decay<T>::type;
+        if constexpr (std::is_same<D, std::string>::value) {
+            putString(buf, value.data(), value.size());
+        } else if constexpr (std::is_same<D, const char*>::value || std::is_same<D, char*>::value) {
+            const char* s = value;
+            if (s == nullptr) {
+                s = "(null)";
+            }
+            putString(buf, s, strlen(s));
+        } else if constexpr (std::is_floating_point<D>::value) {
+            buf.appendValue('d');
+            buf.appendValue(static_cast<double>(value));
+        } else if constexpr (std::is_enum<D>::value) {
+            buf.appendValue('i');
+            buf.appendValue(static_cast<int64_t>(value));
+        } else if constexpr (std::is_integral<D>::value && std::is_signed<D>::value) {
+            buf.appendValue('i');
+            buf.appendValue(static_cast<int64_t>(value));
+        } else if constexpr (std::is_integral<D>::value) {
+            buf.appendValue('u');
+            buf.appendValue(static_cast<uint64_t>(value));
+        } else if constexpr (std::is_pointer<D>::value) {
+            buf.appendValue('p');
+            buf.appendValue(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+        } else {
+            static_assert(Unsupported<D>::value, "unsupported binary log argument type");
+        }
+    }
+
+    static void putString(BinaryLogBuffer& buf, const char* s, size_t len) {
+        // 超长字符串截断
+        uint16_t n = static_cast<uint16_t>(len < BinaryLogFormat::kMaxString ? len : BinaryLogFormat::kMaxString);
+        buf.appendValue('s');
+        buf.appendValue(n);
+        buf.append(s, n);
+    }
+};
+
+/**
+ * 二进制日志解码：逐条读出事件，按格式串还原为文本行或JSON行
+ */
+class BinaryLogReader {
+public:
+    struct Arg {
+        char type = 'i';
+        int64_t i = 0;
+        uint64_t u = 0;
+        double d = 0;
+        std::string s;
+    };
+
+    struct Entry {
+        bool dropped = false;       // true表示丢弃通知，只有droppedCount有效
+        uint64_t droppedCount = 0;
+        uint32_t id = 0;
+        uint64_t timeUs = 0;
+        uint32_t tid = 0;
+        int level = 0;
+        std::string file;
+        int line = 0;
+        std::string fmt;
+        std::vector<Arg> args;
+    };
+
+    explicit BinaryLogReader(std::istream& in) : in_(in) {}
+
+    // 校验文件头，失败时error()给出原因
+    bool readHeader() {
+        char magic[sizeof(BinaryLogFormat::kMagic)];
+        if (!in_.read(magic, sizeof(magic)) || memcmp(magic, BinaryLogFormat::kMagic, sizeof(magic)) != 0) {
+            error_ = "not a binary chat log";
+            return false;
+        }
+        return true;
+    }
+
+    // 读出下一条事件或丢弃通知，到达文件末尾或数据损坏时返回false
+    bool next(Entry& out) {
+        char type;
+        while (in_.get(type)) {
+            if (type == BinaryLogFormat::kSiteRecord) {
+                if (!readSite()) {
+                    return false;
+                }
+            } else if (type == BinaryLogFormat::kEventRecord) {
+                return readEvent(out);
+            } else if (type == BinaryLogFormat::kDroppedRecord) {
+                out = Entry();
+                out.dropped = true;
+                return read(out.droppedCount) || fail("truncated dropped record");
+            } else {
+                return fail("unknown record type");
+            }
+        }
+        return false;
+    }
+
+    // 文件正常结束时为空
+    const std::string& error() const { return error_; }
+
+    // 按printf语义把参数代入格式串，参数不足时输出<missing>
+    static std::string render(const std::string& fmt, const std::vector<Arg>& args) {
+        std::string out;
+        size_t next = 0;
+        size_t i = 0;
+        while (i < fmt.size()) {
+            char c = fmt[i++];
+            if (c != '%') {
+                out += c;
+                continue;
+            }
+            if (i < fmt.size() && fmt[i] == '%') {
+                out += '%';
+                i++;
+                continue;
+            }
+            // 标志、宽度、精度原样保留，'*'用参数替换
+            std::string spec = "%";
+            while (i < fmt.size() && strchr("-+ #0'", fmt[i]) != nullptr) {
+                spec += fmt[i++];
+            }
+            for (int part = 0; part < 2; part++) {
+                if (part == 1) {
+                    if (i >= fmt.size() || fmt[i] != '.') {
+                        break;
+                    }
+                    spec += fmt[i++];
+                }
+                if (i < fmt.size() && fmt[i] == '*') {
+                    i++;
+                    spec += std::to_string(next < args.size() ? asSigned(args[next]) : 0);
+                    next++;
+                }
+                while (i < fmt.size() && fmt[i] >= '0' && fmt[i] <= '9') {
+                    spec += fmt[i++];
+                }
+            }
+            // 长度修饰只用来决定整数宽度，值统一按64位取出
+            bool wide = false;
+            while (i < fmt.size() && strchr("hlLqjzt", fmt[i]) != nullptr) {
+                wide = wide || fmt[i] != 'h';
+                i++;
+            }
+            if (i >= fmt.size()) {
+                out += spec;
+                break;
+            }
+            char conv = fmt[i++];
+            if (conv == 'n') {
+                continue;
+            }
+            if (next >= args.size()) {
+                out += "<missing>";
+                continue;
+            }
+            const Arg& arg = args[next++];
+            char buf[128];
+            std::string full;
+            int len = 0;
+            switch (conv) {
+                case 'd': case 'i':
+                    full = spec + "lld";
+                    len = snprintf(buf, sizeof(buf), full.c_str(),
+                                   static_cast<long long>(wide ? asSigned(arg) : static_cast<int>(asSigned(arg))));
+                    break;
+                case 'u': case 'o': case 'x': case 'X': {
+                    full = spec + "ll" + conv;
+                    uint64_t value = asUnsigned(arg);
+                    // 不带l/ll修饰时是32位参数，负数按32位补码输出
+                    if (!wide) {
+                        value = static_cast<unsigned int>(value);
+                    }
+                    len = snprintf(buf, sizeof(buf), full.c_str(), static_cast<unsigned long long>(value));
+                    break;
+                }
+                case 'c':
+                    full = spec + "c";
+                    len = snprintf(buf, sizeof(buf), full.c_str(), static_cast<int>(asSigned(arg)));
+                    break;
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    full = spec + conv;
+                    len = snprintf(buf, sizeof(buf), full.c_str(), asDouble(arg));
+                    break;
+                case 'p':
+                    full = spec + "p";
+                    len = snprintf(buf, sizeof(buf), full.c_str(), reinterpret_cast<void*>(static_cast<uintptr_t>(asUnsigned(arg))));
+                    break;
+                case 's': {
+                    std::string text = arg.type == 's' ? arg.s : "<not a string>";
+                    if (spec.size() == 1) {
+                        // 最常见的%s直接追加，不受缓冲区长度限制
+                        out += text;
+                        continue;
+                    }
+                    full = spec + "s";
+                    int need = snprintf(nullptr, 0, full.c_str(), text.c_str());
+                    if (need > 0) {
+                        std::string formatted(need, '\0');
+                        snprintf(&formatted[0], need + 1, full.c_str(), text.c_str());
+                        out += formatted;
+                    }
+                    continue;
+                }
+                default:
+                    out += spec + conv;
+                    continue;
+            }
+            if (len > 0) {
+                out.append(buf, static_cast<size_t>(len) < sizeof(buf) ? len : sizeof(buf) - 1);
+            }
+        }
+        return out;
+    }
+
+    // 与文本日志相同的行格式：[时间] [级别] [线程] [文件:行号] 消息
+    static std::string toText(const Entry& entry) {
+        if (entry.dropped) {
+            return "[dropped " + std::to_string(entry.droppedCount) + " records]";
+        }
+        std::string out = "[" + formatTime(entry.timeUs) + "] [" + BinaryLogFormat::levelName(entry.level)
+                        + "] [" + std::to_string(entry.tid) + "]";
+        if (!entry.file.empty() && entry.line > 0) {
+            out += " [" + baseName(entry.file) + ":" + std::to_string(entry.line) + "]";
+        }
+        out += " " + render(entry.fmt, entry.args);
+        return out;
+    }
+
+    // 每条一个JSON对象，便于jq等工具过滤
+    static std::string toJson(const Entry& entry) {
+        if (entry.dropped) {
+            return "{\"dropped\":" + std::to_string(entry.droppedCount) + "}";
+        }
+        std::string level = BinaryLogFormat::levelName(entry.level);
+        while (!level.empty() && level.back() == ' ') {
+            level.pop_back();
+        }
+        std::string out = "{\"time\":\"" + formatTime(entry.timeUs) + "\""
+                        + ",\"ts_us\":" + std::to_string(entry.timeUs)
+                        + ",\"level\":\"" + level + "\""
+                        + ",\"tid\":" + std::to_string(entry.tid)
+                        + ",\"file\":\"" + jsonEscape(baseName(entry.file)) + "\""
+                        + ",\"line\":" + std::to_string(entry.line)
+                        + ",\"fmt\":\"" + jsonEscape(entry.fmt) + "\""
+                        + ",\"args\":[";
+        for (size_t i = 0; i < entry.args.size(); i++) {
+            const Arg& arg = entry.args[i];
+            if (i > 0) {
+                out += ",";
+            }
+            switch (arg.type) {
+                case 'i': out += std::to_string(arg.i); break;
+                case 'u': out += std::to_string(arg.u); break;
+                case 'd': {
+                    char buf[32];
+                    snprintf(buf, sizeof(buf), "%.17g", arg.d);
+                    // JSON没有inf/nan
+                    out += (strchr(buf, 'n') != nullptr || strchr(buf, 'i') != nullptr) ? "null" : buf;
+                    break;
+                }
+                case 's': out += "\"" + jsonEscape(arg.s) + "\""; break;
+                default: out += std::to_string(arg.u); break;
+            }
+        }
+        out += "],\"msg\":\"" + jsonEscape(render(entry.fmt, entry.args)) + "\"}";
+        return out;
+    }
+
+private:
+    struct Site {
+        int level = 0;
+        int line = 0;
+        std::string file;
+        std::string fmt;
+    };
+
+    template <typename T>
+    bool read(T& value) {
+        return static_cast<bool>(in_.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    bool readString(std::string& out) {
+        uint16_t len = 0;
+        if (!read(len)) {
+            return false;
+        }
+        out.resize(len);
+        return len == 0 || static_cast<bool>(in_.read(&out[0], len));
+    }
+
+    bool fail(const char* reason) {
+        error_ = reason;
+        return false;
+    }
+
+    bool readSite() {
+        uint32_t id = 0;
+        uint8_t level = 0;
+        uint32_t line = 0;
+        Site site;
+        if (!read(id) || !read(level) || !read(line) || !readString(site.file) || !readString(site.fmt)) {
+            return fail("truncated site record");
+        }
+        site.level = level;
+        site.line = static_cast<int>(line);
+        // 追加写入的文件里，新进程的定义覆盖上一个进程的同号定义
+        sites_[id] = std::move(site);
+        return true;
+    }
+
+    bool readEvent(Entry& out) {
+        out = Entry();
+        uint16_t len = 0;
+        if (!read(out.id) || !read(out.timeUs) || !read(out.tid) || !read(len)) {
+            return fail("truncated event record");
+        }
+        std::string payload(len, '\0');
+        if (len > 0 && !in_.read(&payload[0], len)) {
+            return fail("truncated event record");
+        }
+        auto it = sites_.find(out.id);
+        if (it == sites_.end()) {
+            return fail("event refers to an undefined call site");
+        }
+        out.level = it->second.level;
+        out.file = it->second.file;
+        out.line = it->second.line;
+        out.fmt = it->second.fmt;
+        return decodeArgs(payload, out.args) || fail("malformed event arguments");
+    }
+
+    static bool decodeArgs(const std::string& payload, std::vector<Arg>& args) {
+        size_t pos = 0;
+        auto take = [&payload, &pos](void* dst, size_t n) {
+            if (pos + n > payload.size()) {
+                return false;
+            }
+            memcpy(dst, payload.data() + pos, n);
+            pos += n;
+            return true;
+        };
+        while (pos < payload.size()) {
+            Arg arg;
+            arg.type = payload[pos++];
+            bool ok = true;
+            switch (arg.type) {
+                case 'i': ok = take(&arg.i, sizeof(arg.i)); arg.u = static_cast<uint64_t>(arg.i); break;
+                case 'u': case 'p': ok = take(&arg.u, sizeof(arg.u)); arg.i = static_cast<int64_t>(arg.u); break;
+                case 'd': ok = take(&arg.d, sizeof(arg.d)); break;
+                case 's': {
+                    uint16_t n = 0;
+                    ok = take(&n, sizeof(n)) && pos + n <= payload.size();
+                    if (ok) {
+                        arg.s.assign(payload, pos, n);
+                        pos += n;
+                    }
+                    break;
+                }
+                default: ok = false; break;
+            }
+            if (!ok) {
+                return false;
+            }
+            args.push_back(std::move(arg));
+        }
+        return true;
+    }
+
+    static int64_t asSigned(const Arg& arg) {
+        return arg.type == 'd' ? static_cast<int64_t>(arg.d) : arg.i;
+    }
+
+    static uint64_t asUnsigned(const Arg& arg) {
+        return arg.type == 'd' ? static_cast<uint64_t>(arg.d) : arg.u;
+    }
+
+    static double asDouble(const Arg& arg) {
+        if (arg.type == 'd') {
+            return arg.d;
+        }
+        return arg.type == 'i' ? static_cast<double>(arg.i) : static_cast<double>(arg.u);
+    }
+
+    static std::string formatTime(uint64_t timeUs) {
+        time_t seconds = static_cast<time_t>(timeUs / 1000000);
+        struct tm tmBuf;
+        localtime_r(&seconds, &tmBuf);
+        char buf[40];
+        size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tmBuf);
+        snprintf(buf + n, sizeof(buf) - n, ".%03d", static_cast<int>(timeUs / 1000 % 1000));
+        return buf;
+    }
+
+    static std::string baseName(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static std::string jsonEscape(const std::string& s) {
+        std::string out;
+        out.reserve(s.size());
+        for (unsigned char c : s) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out += buf;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        return out;
+    }
+
+    std::istream& in_;
+    std::unordered_map<uint32_t, Site> sites_;
+    std::string error_;
+};
+
+#endif // BINARYLOGFORMAT_HPP
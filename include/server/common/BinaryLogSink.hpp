@@ -0,0 +1,120 @@
+#ifndef BINARYLOGSINK_HPP
+#define BINARYLOGSINK_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <chrono>
+#include "BinaryLogFormat.hpp"
+#include "MpscRingBuffer.hpp"
+#include "LogFileRotator.hpp"
+
+/**
+ * 二进制日志输出（单例，异步）
+ * 调用线程不做任何文本格式化，只把调用点id、时间戳、线程id和原始参数放入无锁环形队列，
+ * 由后台线程写入二进制文件；调用点（文件、行号、级别、格式串）只在第一次使用时登记一次；
+ * 文件用chatlog_decode还原为文本行或JSON行，格式见BinaryLogFormat.hpp
+ */
+class BinaryLogSink {
+public:
+    struct Options {
+        std::string path;                   // 日志文件路径
+        size_t queueCapacity = 8192;        // 异步队列容量（条数）
+        bool blockWhenFull = false;         // 队列满时阻塞生产者(true)或丢弃(false)，ERROR及以上级别总是等待
+        int flushIntervalMs = 1000;         // 后台线程把缓冲写入磁盘的最长间隔
+        bool enableRotation = true;         // 超过maxFileSize或到达轮转时刻后轮转
+        size_t maxFileSize = 10 * 1024 * 1024;
+        int maxFileCount = 5;
+        int rotateIntervalSeconds = 0;      // 按时间轮转的间隔（秒），0表示只按大小轮转
+    };
+
+    static BinaryLogSink& getInstance();
+
+    // 打开日志文件并启动后台线程，已打开时先关闭
+    bool open(const Options& options);
+    // 写出剩余日志并停止后台线程
+    void close();
+    bool isOpen() const { return open_.load(std::memory_order_acquire); }
+
+    // 登记调用点，返回调用点id；日志宏用函数局部静态变量保存，每个调用点只登记一次
+    uint32_t registerSite(int level, const char* file, int line, const char* fmt);
+
+    // 提交一条日志，参数原样编码，不做格式化
+    template <typename... Args>
+    void write(uint32_t site, int level, const Args&... args) {
+        Event event;
+        event.site = site;
+        event.level = level;
+        event.timeUs = nowMicros();
+        event.tid = currentTid();
+        BinaryLogEncoder::encode(event.args, args...);
+        submit(event);
+    }
+
+    // 等待已提交的日志全部写出并刷盘
+    void flush();
+
+private:
+    struct Event {
+        uint32_t site = 0;
+        int level = 0;
+        uint64_t timeUs = 0;
+        uint32_t tid = 0;
+        BinaryLogBuffer args;
+    };
+
+    struct Site {
+        int level;
+        int line;
+        std::string file;
+        std::string fmt;
+    };
+
+    BinaryLogSink() = default;
+    ~BinaryLogSink();
+    BinaryLogSink(const BinaryLogSink&) = delete;
+    BinaryLogSink& operator=(const BinaryLogSink&) = delete;
+
+    static uint64_t nowMicros();
+    static uint32_t currentTid();
+
+    void submit(Event& event);
+    void writerTask();
+    void writeEvent(const Event& event);
+    void writeDropped(uint64_t count);
+    // 补写尚未写入当前文件的调用点定义
+    void writeSitesUpTo(uint32_t site);
+    void writeBytes(const void* data, size_t len);
+    bool openFile();
+    // 与文本日志相同：只交换到预先打开的下一个文件，改名在后台完成
+    void maybeRotate();
+    void scheduleTimedRotation();
+
+    Options options_;
+    std::unique_ptr<std::ofstream> file_;
+    std::unique_ptr<LogFileRotator> rotator_; // 未启用轮转时为空
+    std::unique_ptr<MpscRingBuffer<Event>> queue_;
+    std::thread writer_;
+    std::mutex mutex_;                     // 保护后台线程的启停和flush请求
+    std::condition_variable writerCv_;
+    std::condition_variable flushedCv_;
+    std::atomic<bool> open_{false};
+    bool stopping_ = false;
+    bool flushRequested_ = false;
+    unsigned long long flushGeneration_ = 0;
+    std::atomic<unsigned long long> dropped_{0};
+
+    std::mutex sitesMutex_;                // 保护sites_
+    std::vector<Site> sites_;              // 下标即调用点id，进程内只增不减
+    size_t sitesWritten_ = 0;              // 已写入当前文件的调用点数，仅后台线程访问
+    size_t fileSize_ = 0;                  // 仅后台线程访问
+    std::chrono::system_clock::time_point nextTimedRotation_; // 仅后台线程访问
+};
+
+#endif // BINARYLOGSINK_HPP
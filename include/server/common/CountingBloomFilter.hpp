@@ -0,0 +1,130 @@
+#ifndef COUNTINGBLOOMFILTER_HPP
+#define COUNTINGBLOOMFILTER_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+
+/**
+ * 计数布隆过滤器
+ * 每个位置是一个4位计数器（两个打包在一个字节中），因此支持删除；
+ * mightContain返回false表示一定不存在，返回true表示可能存在（误判率约为构造时给定的fpRate）；
+ * 计数器达到15后不再增减，避免溢出后误删其他元素；
+ * 非线程安全，并发访问由调用方加锁
+ */
+class CountingBloomFilter {
+public:
+    /**
+     * @param expectedItems 预计元素个数
+     * @param fpRate 期望误判率
+     */
+    CountingBloomFilter(size_t expectedItems, double fpRate = 0.01) {
+        if (expectedItems == 0) {
+            expectedItems = 1;
+        }
+        if (fpRate <= 0 || fpRate >= 1) {
+            fpRate = 0.01;
+        }
+        // m = -n*ln(p)/(ln2)^2, k = m/n*ln2
+        double ln2 = std::log(2.0);
+        double bits = -static_cast<double>(expectedItems) * std::log(fpRate) / (ln2 * ln2);
+        counters_ = static_cast<size_t>(bits) + 1;
+        hashCount_ = static_cast<int>(std::round(bits / expectedItems * ln2));
+        if (hashCount_ < 1) {
+            hashCount_ = 1;
+        }
+        table_.assign((counters_ + 1) / 2, 0);
+    }
+
+    template <typename T>
+    void add(const T& item) {
+        uint64_t h1, h2;
+        hashPair(std::hash<T>()(item), h1, h2);
+        for (int i = 0; i < hashCount_; i++) {
+            size_t slot = (h1 + i * h2) % counters_;
+            unsigned value = counterAt(slot);
+            if (value < kMaxCount) {
+                setCounter(slot, value + 1);
+            }
+        }
+        items_++;
+    }
+
+    /**
+     * 删除一个之前add过的元素；删除未添加过的元素会造成误删
+     */
+    template <typename T>
+    void remove(const T& item) {
+        uint64_t h1, h2;
+        hashPair(std::hash<T>()(item), h1, h2);
+        if (!containsHashes(h1, h2)) {
+            return;
+        }
+        for (int i = 0; i < hashCount_; i++) {
+            size_t slot = (h1 + i * h2) % counters_;
+            unsigned value = counterAt(slot);
+            if (value > 0 && value < kMaxCount) {
+                setCounter(slot, value - 1);
+            }
+        }
+        if (items_ > 0) {
+            items_--;
+        }
+    }
+
+    template <typename T>
+    bool mightContain(const T& item) const {
+        uint64_t h1, h2;
+        hashPair(std::hash<T>()(item), h1, h2);
+        return containsHashes(h1, h2);
+    }
+
+    size_t size() const { return items_; }
+    size_t memoryBytes() const { return table_.size(); }
+    int hashCount() const { return hashCount_; }
+
+private:
+    static const unsigned kMaxCount = 15;
+
+    // 由一个哈希值派生两个独立哈希，用 h1 + i*h2 模拟k个哈希函数
+    static void hashPair(size_t hash, uint64_t& h1, uint64_t& h2) {
+        uint64_t x = static_cast<uint64_t>(hash);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        h1 = x;
+        h2 = ((x >> 32) | (x << 32)) | 1; // 奇数，保证各探测位置不同
+    }
+
+    bool containsHashes(uint64_t h1, uint64_t h2) const {
+        for (int i = 0; i < hashCount_; i++) {
+            if (counterAt((h1 + i * h2) % counters_) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    unsigned counterAt(size_t slot) const {
+        uint8_t byte = table_[slot / 2];
+        return (slot & 1) ? (byte >> 4) : (byte & 0x0F);
+    }
+
+    void setCounter(size_t slot, unsigned value) {
+        uint8_t& byte = table_[slot / 2];
+        if (slot & 1) {
+            byte = static_cast<uint8_t>((byte & 0x0F) | (value << 4));
+        } else {
+            byte = static_cast<uint8_t>((byte & 0xF0) | value);
+        }
+    }
+
+    std::vector<uint8_t> table_;
+    size_t counters_ = 0;
+    int hashCount_ = 1;
+    size_t items_ = 0;
+};
+
+#endif // COUNTINGBLOOMFILTER_HPP
@@ -0,0 +1,110 @@
+#ifndef DEBOUNCEQUEUE_HPP
+#define DEBOUNCEQUEUE_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+/**
+ * 按接收方合并的防抖队列
+ * 每个接收方K累积一批条目，同一条目键S重复出现时只保留最新的值V（例如同一用户先下线又上线，只通知最终状态）；
+ * 接收方的第一条条目入队后经过window时间，或条目数达到maxItems时，整批可以取出；
+ * 条目按首次出现的顺序输出；非线程安全，并发访问由调用方加锁
+ */
+template <typename K, typename S, typename V>
+class DebounceQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Items = std::vector<std::pair<S, V>>;
+
+    /**
+     * @param window 防抖窗口
+     * @param maxItems 单个接收方累积到此条数时不再等待窗口结束
+     */
+    DebounceQueue(std::chrono::milliseconds window, size_t maxItems)
+        : window_(window), maxItems_(maxItems > 0 ? maxItems : 1) {}
+
+    /**
+     * 加入一条条目
+     * @return 该接收方的批次是否已满，调用方可据此提前唤醒刷出线程
+     */
+    bool add(const K& recipient, const S& key, const V& value, Clock::time_point now = Clock::now()) {
+        Batch& batch = pending_[recipient];
+        if (batch.items.empty()) {
+            batch.dueAt = now + window_;
+        }
+        auto it = batch.index.find(key);
+        if (it != batch.index.end()) {
+            batch.items[it->second].second = value;
+        } else {
+            batch.index[key] = batch.items.size();
+            batch.items.emplace_back(key, value);
+        }
+        return batch.items.size() >= maxItems_;
+    }
+
+    /**
+     * 取出已到期或已满的批次
+     */
+    std::vector<std::pair<K, Items>> takeReady(Clock::time_point now = Clock::now()) {
+        std::vector<std::pair<K, Items>> ready;
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (now >= it->second.dueAt || it->second.items.size() >= maxItems_) {
+                ready.emplace_back(it->first, std::move(it->second.items));
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return ready;
+    }
+
+    /**
+     * 取出全部批次（退出时使用）
+     */
+    std::vector<std::pair<K, Items>> takeAll() {
+        std::vector<std::pair<K, Items>> all;
+        for (auto& entry : pending_) {
+            all.emplace_back(entry.first, std::move(entry.second.items));
+        }
+        pending_.clear();
+        return all;
+    }
+
+    /**
+     * 丢弃接收方尚未发出的批次（例如接收方已下线）
+     */
+    void erase(const K& recipient) {
+        pending_.erase(recipient);
+    }
+
+    /**
+     * 最早到期的时刻，队列为空时返回time_point::max()
+     */
+    Clock::time_point nextDue() const {
+        auto due = Clock::time_point::max();
+        for (const auto& entry : pending_) {
+            if (entry.second.dueAt < due) {
+                due = entry.second.dueAt;
+            }
+        }
+        return due;
+    }
+
+    bool empty() const { return pending_.empty(); }
+    size_t recipients() const { return pending_.size(); }
+
+private:
+    struct Batch {
+        Items items;
+        std::unordered_map<S, size_t> index; // 条目键 -> items中的下标
+        Clock::time_point dueAt;
+    };
+
+    std::unordered_map<K, Batch> pending_;
+    std::chrono::milliseconds window_;
+    size_t maxItems_;
+};
+
+#endif // DEBOUNCEQUEUE_HPP
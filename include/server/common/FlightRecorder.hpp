@@ -0,0 +1,48 @@
+#ifndef FLIGHTRECORDER_HPP
+#define FLIGHTRECORDER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 飞行记录器记录的事件类型，a/b两个参数的含义见注释
+enum class FlightEvent : uint16_t {
+    MSG_RECEIVED,     // a=字节数
+    MSG_DISPATCHED,   // a=msgid，业务处理函数返回时记录
+    MSG_SENT,         // a=接收方用户id，b=字节数
+    DB_QUERY_START,   // a=0表示update，1表示query
+    DB_QUERY_END,     // a=同上，b=1成功/0失败
+    REDIS_PUBLISH,    // a=通道（命名通道为-1），b=1成功/0失败
+    EVENT_COUNT
+};
+
+/**
+ * 常开的飞行记录器
+ * 每个线程第一次记录时分配一个固定大小的环形缓冲（kEventsPerThread条），之后只由该线程写入，
+ * 写满后覆盖最旧的事件；记录只做几次relaxed原子写，不加锁、不分配内存、线程之间不共享缓存行。
+ * dump在普通线程上下文中把所有线程最近的事件写入新文件；installCrashHandler在致命信号
+ * （SIGSEGV/SIGBUS/SIGFPE/SIGILL/SIGABRT）时用异步信号安全的方式写出，再按默认方式结束进程。
+ * 输出按线程分段，段内按时间先后排列，每行以微秒时间戳开头，可用sort -n合并成全局时间线
+ */
+class FlightRecorder {
+public:
+    static const size_t kEventsPerThread = 1024;
+    static const size_t kMaxThreads = 256;   // 超出的线程不记录；线程退出后其缓冲（及其中的事件）保留到被新线程复用
+
+    static void record(FlightEvent event, int64_t a = 0, int64_t b = 0);
+
+    // 输出文件所在目录，默认为当前目录；应在installCrashHandler之前设置
+    static void setDumpDirectory(const std::string& dir);
+    // 写入<目录>/flight-<pid>-<unix秒>.log，返回文件路径，失败时返回空串
+    static std::string dump();
+    // 写入已打开的文件描述符，异步信号安全
+    static void dumpTo(int fd);
+    // 注册致命信号的处理函数，并为调用线程设置备用信号栈（栈溢出时仍能写出）；其他线程第一次record时各自设置备用栈
+    // 多个线程同时崩溃时只有第一个写出，其余线程等待进程结束
+    static void installCrashHandler();
+
+    static const char* eventName(FlightEvent event);
+};
+
+#endif // FLIGHTRECORDER_HPP
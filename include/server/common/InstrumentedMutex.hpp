@@ -0,0 +1,93 @@
+#ifndef INSTRUMENTEDMUTEX_HPP
+#define INSTRUMENTEDMUTEX_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+// 编译期开关：定义为0时InstrumentedMutex只是std::mutex的薄包装，不做任何统计
+#ifndef CHAT_LOCK_STATS
+#define CHAT_LOCK_STATS 1
+#endif
+
+class LockStats;
+
+// 加锁调用点，由CHAT_LOCK_SITE在每个调用点生成一个静态实例
+struct LockSite {
+    const char* file;
+    int line;
+};
+
+// 标记下一次加锁的调用点并返回锁本身：lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(mutex));
+// 只写一个线程局部变量，不展开调用栈；未标记的加锁（如condition_variable_any重新加锁）记为返回地址
+#define CHAT_LOCK_SITE(mutex) \
+    ((mutex).at([]() -> const LockSite* { static const LockSite site{__FILE__, __LINE__}; return &site; }()))
+
+/**
+ * 带竞争统计的互斥锁，可直接替换std::mutex（满足Lockable，配合lock_guard/unique_lock/condition_variable_any使用）
+ * 每次加锁先try_lock：成功时只记一次获取次数；失败说明发生竞争，阻塞等待的时长记入等待直方图，
+ * 并记在等待开始时持有者的调用点（CHAT_LOCK_SITE标记的文件:行号）名下，用来找出是哪段代码占着锁。
+ * 统计按锁名汇总，同名的多个实例（例如每个MySQL连接各一把锁）共用一份；
+ * 指标为chat_lock_acquisitions_total、chat_lock_contended_total、chat_lock_wait_microseconds，
+ * 持有者调用点见dumpAll。统计默认关闭，运行期用setEnabled(true)打开，关闭时只多一次原子读取
+ */
+class InstrumentedMutex {
+public:
+    // name用作指标标签，应为字符串字面量
+    explicit InstrumentedMutex(const char* name);
+    InstrumentedMutex(const InstrumentedMutex&) = delete;
+    InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+    void lock() {
+#if CHAT_LOCK_STATS
+        if (enabled()) {
+            lockInstrumented();
+            return;
+        }
+#endif
+        mutex_.lock();
+    }
+
+    bool try_lock() {
+#if CHAT_LOCK_STATS
+        if (enabled()) {
+            return tryLockInstrumented();
+        }
+#endif
+        return mutex_.try_lock();
+    }
+
+    void unlock() { mutex_.unlock(); }
+
+    // 记录下一次加锁的调用点，通过CHAT_LOCK_SITE使用
+    InstrumentedMutex& at(const LockSite* site) {
+#if CHAT_LOCK_STATS
+        if (enabled()) {
+            nextSite_ = site;
+        }
+#else
+        (void)site;
+#endif
+        return *this;
+    }
+
+    static void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 按锁汇总的竞争报告：获取次数、竞争比例、等待分位数，以及造成等待最多的持有者调用点
+    static std::string dumpAll();
+
+private:
+    // 不内联，未标记调用点时__builtin_return_address(0)是调用lock()的函数中的地址
+    __attribute__((noinline)) void lockInstrumented();
+    __attribute__((noinline)) bool tryLockInstrumented();
+
+    static std::atomic<bool> enabled_;
+    static thread_local const LockSite* nextSite_; // CHAT_LOCK_SITE标记、尚未被加锁取走的调用点
+
+    std::mutex mutex_;
+    LockStats* stats_;                  // 进程内不释放，按锁名共享
+    std::atomic<void*> holder_{nullptr}; // 当前（或最近一次）持有者的调用点
+};
+
+#endif // INSTRUMENTEDMUTEX_HPP
@@ -0,0 +1,67 @@
+#ifndef LOGFILEROTATOR_HPP
+#define LOGFILEROTATOR_HPP
+
+#include <string>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+using namespace std;
+
+/**
+ * 日志文件轮转（文件系统操作在后台线程完成）
+ * 后台线程预先打开下一个文件 base.next；写线程轮转时只交换两个文件流，旧文件的关闭、
+ * base.(N-1)的删除、base.i -> base.(i+1)、base -> base.1 以及 base.next -> base 的改名都在后台进行，
+ * 已打开的文件流跟随改名，写线程切换后可以立即继续写入；
+ * 备用文件尚未就绪（上一轮改名还没做完）时trySwitch返回false，调用方继续写当前文件，不等待
+ */
+class LogFileRotator {
+public:
+    /**
+     * @param basePath 当前日志文件路径
+     * @param maxFileCount 保留的文件数（含当前文件）
+     * @param header 每个新文件开头写入的内容（例如二进制日志的魔数），追加到已有内容的文件时不写
+     */
+    LogFileRotator(const string& basePath, int maxFileCount, const string& header = "");
+    // 完成尚未做完的改名后停止后台线程；未启用的备用文件被删除
+    ~LogFileRotator();
+
+    LogFileRotator(const LogFileRotator&) = delete;
+    LogFileRotator& operator=(const LogFileRotator&) = delete;
+
+    // 以追加方式打开当前文件并返回已有长度，仅在初始化时由调用线程执行
+    unique_ptr<ofstream> openCurrent(size_t& size);
+
+    /**
+     * 由写线程调用：备用文件已就绪时与current交换，旧文件交给后台线程关闭和改名
+     * @param size 切换成功时设为新文件的已有长度
+     * @return 是否完成切换
+     */
+    bool trySwitch(unique_ptr<ofstream>& current, size_t& size);
+
+    // 后台线程是否空闲（没有待完成的改名且备用文件已就绪），用于测试
+    bool idle();
+
+private:
+    void workerTask();
+    void renameFiles();
+    void prepareStandby();
+    unique_ptr<ofstream> openFile(const string& path, size_t& size);
+
+    string basePath_;
+    string nextPath_;
+    int maxFileCount_;
+    string header_;
+
+    mutex mutex_;
+    condition_variable cv_;
+    unique_ptr<ofstream> standby_;         // 预先打开的base.next
+    size_t standbySize_ = 0;
+    unique_ptr<ofstream> retired_;         // 已换下、等待关闭和改名的文件
+    bool stopping_ = false;
+    thread worker_;
+};
+
+#endif // LOGFILEROTATOR_HPP
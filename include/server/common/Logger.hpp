@@ -8,9 +8,21 @@
 #include <sstream>
 #include <chrono>
 #include <iomanip>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include "MpscRingBuffer.hpp"
+#include "BinaryLogSink.hpp"
+#include "LogFileRotator.hpp"
 
 using namespace std;
 
+// 编译期最低日志级别（0=DEBUG ... 4=FATAL），低于它的CHAT_LOG_*调用点在编译时整体移除，
+// 由CMake选项CHAT_LOG_MIN_LEVEL传入
+#ifndef CHAT_LOG_MIN_LEVEL
+#define CHAT_LOG_MIN_LEVEL 0
+#endif
+
 // 日志级别枚举
 enum class LogLevel {
     DEBUG = 0,
@@ -30,9 +42,20 @@ struct LogConfig {
     size_t maxFileSize = 10 * 1024 * 1024;     // 最大文件大小(10MB)
     int maxFileCount = 5;                      // 最大文件数量
     bool enableRotation = true;                // 是否启用日志轮转
+    int rotateIntervalSeconds = 0;             // 按时间轮转的间隔（秒），0表示只按大小轮转；轮转时刻对齐到间隔的整数倍（UTC）
+    size_t queueCapacity = 8192;               // 异步队列容量（条数）
+    bool blockWhenFull = false;                // 队列满时阻塞生产者(true)或丢弃(false)，ERROR及以上级别总是等待
+    int flushIntervalMs = 1000;                // 后台线程把缓冲写入磁盘的最长间隔
+    bool enableBinary = false;                 // CHAT_LOG_*宏改写二进制日志（不再格式化文本），用chatlog_decode查看
+    string binaryFileName = "chat_server.blog"; // 二进制日志文件名，位于logDir下
 };
 
-// 单例日志类
+/**
+ * 单例日志类（异步）
+ * 调用线程只负责格式化并把整行放入无锁环形队列，由后台线程批量写入控制台和文件；
+ * 文件写入使用缓冲，按flushIntervalMs定期刷盘，ERROR及以上级别会唤醒后台线程立即写出并刷盘；
+ * 队列满时按blockWhenFull丢弃或等待，丢弃的条数由后台线程定期报告
+ */
 class Logger {
 public:
     static Logger& getInstance();
@@ -40,15 +63,26 @@ public:
     // 初始化日志系统
     void init(const LogConfig& config = LogConfig());
     
-    // 记录日志
-    void log(LogLevel level, const string& message, const string& file = "", int line = 0);
+    // 记录日志，FATAL级别会等待写出后返回
+    void log(LogLevel level, const string& message, const char* file = "", int line = 0);
+
+    // 记录调用方已格式化好的一行（不含换行），原样写出，不再加时间戳等前缀
+    void logFormatted(LogLevel level, const char* text, size_t len);
     
     // 便捷方法
-    void debug(const string& message, const string& file = "", int line = 0);
-    void info(const string& message, const string& file = "", int line = 0);
-    void warn(const string& message, const string& file = "", int line = 0);
-    void error(const string& message, const string& file = "", int line = 0);
-    void fatal(const string& message, const string& file = "", int line = 0);
+    void debug(const string& message, const char* file = "", int line = 0);
+    void info(const string& message, const char* file = "", int line = 0);
+    void warn(const string& message, const char* file = "", int line = 0);
+    void error(const string& message, const char* file = "", int line = 0);
+    void fatal(const string& message, const char* file = "", int line = 0);
+
+    // 运行期级别检查，宏在求值任何日志参数之前调用
+    bool shouldLog(LogLevel level) const {
+        return initialized_.load(memory_order_acquire) && static_cast<int>(level) >= level_.load(memory_order_relaxed);
+    }
+
+    // printf风格格式化，格式串与参数类型由编译器检查（-Wformat），长度不受限制
+    static string format(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
     
     // 设置日志级别
     void setLogLevel(LogLevel level);
@@ -56,8 +90,11 @@ public:
     // 获取当前日志级别
     LogLevel getLogLevel() const;
     
-    // 刷新日志缓冲区
+    // 等待已提交的日志全部写出并刷盘
     void flush();
+
+    // 异步队列中尚未写出的条数（近似值）
+    size_t queueDepth() const;
     
     // 关闭日志系统
     void shutdown();
@@ -70,61 +107,94 @@ private:
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
     
+    // 一条待写出的日志
+    struct LogRecord {
+        LogLevel level = LogLevel::INFO;
+        string text;
+    };
+
     // 内部方法
-    string formatMessage(LogLevel level, const string& message, const string& file, int line);
-    string getCurrentTime();
-    string levelToString(LogLevel level);
+    // 放入异步队列，按级别决定队列满时丢弃还是等待
+    void enqueue(LogRecord& record);
+    void writerTask();
+    // 写出一条日志，返回是否需要立即刷盘
+    bool writeRecord(const LogRecord& record);
+    void flushStreams();
+    string formatMessage(LogLevel level, const string& message, const char* file, int line);
+    // 追加 "YYYY-mm-dd HH:MM:SS.mmm"，日期时间部分按线程每秒格式化一次
+    static void appendCurrentTime(string& out);
+    static const char* levelToString(LogLevel level);
     void writeToFile(const string& message);
     void writeToConsole(const string& message, LogLevel level);
-    void rotateLogFile();
-    bool shouldLog(LogLevel level) const;
+    // 超过大小或到达轮转时刻时换到预先打开的下一个文件，改名由LogFileRotator在后台完成
+    void maybeRotate();
+    void scheduleTimedRotation();
     void ensureLogDirectory();
     
 private:
     LogConfig config_;
     unique_ptr<ofstream> fileStream_;
-    mutex logMutex_;
-    bool initialized_ = false;
-    size_t currentFileSize_ = 0;
+    unique_ptr<LogFileRotator> rotator_;   // 未启用轮转时为空
+    mutex logMutex_;                       // 保护配置、后台线程的启停和flush请求，不在写日志路径上
+    condition_variable writerCv_;          // 唤醒后台线程
+    condition_variable flushedCv_;         // 通知flush调用方已写出
+    atomic<bool> initialized_{false};
+    atomic<int> level_{static_cast<int>(LogLevel::INFO)};
+    unique_ptr<MpscRingBuffer<LogRecord>> queue_;
+    thread writer_;
+    bool stopping_ = false;
+    bool flushRequested_ = false;
+    unsigned long long flushGeneration_ = 0;
+    atomic<unsigned long long> dropped_{0}; // 队列满被丢弃的条数
+    size_t currentFileSize_ = 0;           // 仅后台线程访问
+    chrono::system_clock::time_point nextTimedRotation_; // 仅后台线程访问
 };
 
 // 日志宏定义
-#define CHAT_LOG_DEBUG(msg) Logger::getInstance().debug(msg, __FILE__, __LINE__)
-#define CHAT_LOG_INFO(msg) Logger::getInstance().info(msg, __FILE__, __LINE__)
-#define CHAT_LOG_WARN(msg) Logger::getInstance().warn(msg, __FILE__, __LINE__)
-#define CHAT_LOG_ERROR(msg) Logger::getInstance().error(msg, __FILE__, __LINE__)
-#define CHAT_LOG_FATAL(msg) Logger::getInstance().fatal(msg, __FILE__, __LINE__)
-
-// 格式化日志宏
-#define CHAT_LOG_DEBUG_F(fmt, ...) do { \
-    char buffer[1024]; \
-    snprintf(buffer, sizeof(buffer), fmt, ##__VA_ARGS__); \
-    Logger::getInstance().debug(buffer, __FILE__, __LINE__); \
+// 先做编译期级别判断（if constexpr，低于CHAT_LOG_MIN_LEVEL的调用点不生成代码），
+// 再做运行期级别判断，两者都通过后才求值msg和格式化参数；
+// 启用二进制日志时调用点第一次执行时登记一次，之后只写入调用点id和原始参数
+#define CHAT_LOG_AT(level, msg) do { \
+    if constexpr (static_cast<int>(level) >= CHAT_LOG_MIN_LEVEL) { \
+        if (::Logger::getInstance().shouldLog(level)) { \
+            if (::BinaryLogSink::getInstance().isOpen()) { \
+                static const uint32_t chatLogSite = ::BinaryLogSink::getInstance().registerSite( \
+                    static_cast<int>(level), __FILE__, __LINE__, "%s"); \
+                ::BinaryLogSink::getInstance().write(chatLogSite, static_cast<int>(level), msg); \
+            } else { \
+                ::Logger::getInstance().log(level, msg, __FILE__, __LINE__); \
+            } \
+        } \
+    } \
 } while(0)
 
-#define CHAT_LOG_INFO_F(fmt, ...) do { \
-    char buffer[1024]; \
-    snprintf(buffer, sizeof(buffer), fmt, ##__VA_ARGS__); \
-    Logger::getInstance().info(buffer, __FILE__, __LINE__); \
-} while(0)
+#define CHAT_LOG_DEBUG(msg) CHAT_LOG_AT(LogLevel::DEBUG, msg)
+#define CHAT_LOG_INFO(msg) CHAT_LOG_AT(LogLevel::INFO, msg)
+#define CHAT_LOG_WARN(msg) CHAT_LOG_AT(LogLevel::WARN, msg)
+#define CHAT_LOG_ERROR(msg) CHAT_LOG_AT(LogLevel::ERROR, msg)
+#define CHAT_LOG_FATAL(msg) CHAT_LOG_AT(LogLevel::FATAL, msg)
 
-#define CHAT_LOG_WARN_F(fmt, ...) do { \
-    char buffer[1024]; \
-    snprintf(buffer, sizeof(buffer), fmt, ##__VA_ARGS__); \
-    Logger::getInstance().warn(buffer, __FILE__, __LINE__); \
+// 格式化日志：文本模式下级别检查通过后才调用Logger::format，参数类型按格式串检查（两种模式都检查）；
+// 二进制模式下不做格式化，由解码工具按格式串还原
+#define CHAT_LOG_AT_F(level, fmt, ...) do { \
+    if constexpr (static_cast<int>(level) >= CHAT_LOG_MIN_LEVEL) { \
+        if (::Logger::getInstance().shouldLog(level)) { \
+            if (::BinaryLogSink::getInstance().isOpen()) { \
+                static const uint32_t chatLogSite = ::BinaryLogSink::getInstance().registerSite( \
+                    static_cast<int>(level), __FILE__, __LINE__, fmt); \
+                ::BinaryLogSink::getInstance().write(chatLogSite, static_cast<int>(level), ##__VA_ARGS__); \
+            } else { \
+                ::Logger::getInstance().log(level, ::Logger::format(fmt, ##__VA_ARGS__), __FILE__, __LINE__); \
+            } \
+        } \
+    } \
 } while(0)
 
-#define CHAT_LOG_ERROR_F(fmt, ...) do { \
-    char buffer[1024]; \
-    snprintf(buffer, sizeof(buffer), fmt, ##__VA_ARGS__); \
-    Logger::getInstance().error(buffer, __FILE__, __LINE__); \
-} while(0)
-
-#define CHAT_LOG_FATAL_F(fmt, ...) do { \
-    char buffer[1024]; \
-    snprintf(buffer, sizeof(buffer), fmt, ##__VA_ARGS__); \
-    Logger::getInstance().fatal(buffer, __FILE__, __LINE__); \
-} while(0)
+#define CHAT_LOG_DEBUG_F(fmt, ...) CHAT_LOG_AT_F(LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#define CHAT_LOG_INFO_F(fmt, ...) CHAT_LOG_AT_F(LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define CHAT_LOG_WARN_F(fmt, ...) CHAT_LOG_AT_F(LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define CHAT_LOG_ERROR_F(fmt, ...) CHAT_LOG_AT_F(LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define CHAT_LOG_FATAL_F(fmt, ...) CHAT_LOG_AT_F(LogLevel::FATAL, fmt, ##__VA_ARGS__)
 
 // 性能日志类
 class PerformanceLogger {
@@ -0,0 +1,144 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * 计数器：只增不减，更新只有一次relaxed原子加
+ */
+class MetricCounter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * 仪表：可增可减的当前值，例如在线连接数
+ */
+class MetricGauge {
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+/**
+ * HDR直方图（对数-线性分桶）
+ * 小于128的值每个值一个桶；更大的值每个2的幂区间再线性分成64个桶，相对误差不超过1/64；
+ * 超过记录范围（2^36，按微秒约19小时）的值计入最后一个桶。
+ * record只做几次relaxed原子操作，可在任意线程并发调用；读取不加锁，得到的是近似一致的快照
+ */
+class HdrHistogram {
+public:
+    static const int kSubBucketBits = 7;
+    static const size_t kSubBucketCount = size_t(1) << kSubBucketBits;   // 128
+    static const size_t kSubBucketHalf = kSubBucketCount / 2;           // 64
+    static const int kMaxValueBits = 36;
+    static const size_t kBucketCount = kSubBucketCount + (kMaxValueBits - kSubBucketBits) * kSubBucketHalf;
+
+    HdrHistogram();
+    HdrHistogram(const HdrHistogram&) = delete;
+    HdrHistogram& operator=(const HdrHistogram&) = delete;
+
+    // 记录一个非负值，负值按0计
+    void record(int64_t value);
+    // 返回分位数（p取值0~100），结果为所在桶内的最大值，且不超过记录到的最大值；无数据时返回0
+    int64_t percentile(double p) const;
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    int64_t max() const { return max_.load(std::memory_order_relaxed); }
+    void reset();
+
+    static size_t bucketIndex(uint64_t value);
+    // 返回第idx个桶能表示的最大值
+    static uint64_t bucketUpperBound(size_t idx);
+
+private:
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<int64_t> max_{0};
+};
+
+/**
+ * 在作用域结束时把经过的微秒数记入直方图
+ */
+class ScopedLatency {
+public:
+    explicit ScopedLatency(HdrHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() {
+        histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+    }
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    HdrHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * 指标注册表（单例）
+ * 按 名字+标签 查找或创建指标，返回的引用在进程内一直有效；查找要加锁，热路径应把引用保存在静态变量或成员中，
+ * 之后的更新都是无锁的。renderPrometheus按Prometheus文本格式(0.0.4)输出快照，
+ * 直方图按summary类型输出0.5/0.9/0.99/0.999分位及_sum/_count，最大值另作name_max仪表输出
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    // labels为已拼好的标签串，例如 msgid="5",op="query"，可用label()生成；同名指标类型必须一致，否则抛出logic_error
+    MetricCounter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    MetricGauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    HdrHistogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+    // 抓取时才求值的仪表，例如队列长度；同名同标签重复登记时替换旧的回调
+    void gaugeCallback(const std::string& name, const std::string& help,
+                       std::function<int64_t()> callback, const std::string& labels = "");
+
+    std::string renderPrometheus();
+
+    // 生成 key="value"，对value中的\、"和换行转义
+    static std::string label(const std::string& key, const std::string& value);
+
+private:
+    enum class Type { COUNTER, GAUGE, SUMMARY };
+
+    struct Series {
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<HdrHistogram> histogram;
+        std::function<int64_t()> callback;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::map<std::string, Series> series;   // 键为标签串
+    };
+
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    Series& findOrCreate(const std::string& name, const std::string& help, Type type, const std::string& labels);
+
+    std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,64 @@
+#ifndef MUDUOLOGBRIDGE_HPP
+#define MUDUOLOGBRIDGE_HPP
+
+#include <cstring>
+#include "Logger.hpp"
+
+using namespace std;
+
+/**
+ * 把muduo的LOG_*输出接到项目Logger上
+ * muduo按自己的格式拼好整行后交给输出回调，这里只从固定位置取出级别，整行原样进入同一个异步队列，
+ * 共用同一个文件和轮转策略，不再逐行写stdout；muduo的行保留自己的格式（"日期 时间 线程id 级别 消息 - 文件:行号"），
+ * 不再解析重排；muduo在格式化之前按自己的级别过滤，调整级别时用setLogLevel同时设置两边
+ */
+class MuduoLogBridge {
+public:
+    // 安装输出和刷新回调，并把muduo的级别设为与Logger一致；需在Logger::init之后调用
+    static void install();
+
+    // 同时设置Logger和muduo的日志级别
+    static void setLogLevel(LogLevel level);
+
+    /**
+     * 取出muduo一行日志的级别："日期 时间 线程id 级别 ..."，级别字段定宽6个字符
+     * 级别字段无法识别时返回false
+     */
+    static bool levelOf(const char* msg, int len, LogLevel& level) {
+        // 跳过日期、时间和（可能带前导空格的）线程id
+        int pos = 0;
+        for (int field = 0; field < 3; field++) {
+            while (pos < len && msg[pos] == ' ') {
+                pos++;
+            }
+            while (pos < len && msg[pos] != ' ') {
+                pos++;
+            }
+        }
+        pos++;
+        static const struct {
+            const char* name;
+            LogLevel level;
+        } kLevels[] = {
+            {"TRACE ", LogLevel::DEBUG}, {"DEBUG ", LogLevel::DEBUG}, {"INFO  ", LogLevel::INFO},
+            {"WARN  ", LogLevel::WARN}, {"ERROR ", LogLevel::ERROR}, {"FATAL ", LogLevel::FATAL},
+        };
+        const int kLevelWidth = 6;
+        if (pos + kLevelWidth > len) {
+            return false;
+        }
+        for (const auto& candidate : kLevels) {
+            if (memcmp(msg + pos, candidate.name, kLevelWidth) == 0) {
+                level = candidate.level;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static void output(const char* msg, int len);
+    static void flush();
+};
+
+#endif // MUDUOLOGBRIDGE_HPP
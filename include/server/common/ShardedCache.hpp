@@ -0,0 +1,289 @@
+#ifndef SHARDEDCACHE_HPP
+#define SHARDEDCACHE_HPP
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <functional>
+
+/**
+ * 分段并发缓存（LRU淘汰 + TinyLFU准入 + TTL）
+ * 按key的哈希分成若干段，每段一把锁、一条LRU链表和一个频率草图；
+ * 段满时新key只有在近期访问频率高于LRU尾部的淘汰候选时才会被接纳，
+ * 避免一次性扫描（例如向大量随机id发消息）把热点数据挤出缓存；
+ * 频率草图为4行4位计数的Count-Min Sketch（每个条目约8字节），累计访问次数达到容量的10倍时全部减半，使频率随时间衰减
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ShardedCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t rejections = 0;  // 因频率低未被接纳
+        uint64_t evictions = 0;   // 为新key让出空间
+        uint64_t expirations = 0; // 超过TTL被丢弃
+        size_t size = 0;
+    };
+
+    /**
+     * @param capacity 总容量（条目数），平均分到各段
+     * @param ttl 条目有效期，为0表示永不过期
+     * @param shardCount 分段数
+     */
+    ShardedCache(size_t capacity, std::chrono::milliseconds ttl, size_t shardCount = 16)
+        : ttl_(ttl) {
+        if (shardCount == 0) {
+            shardCount = 1;
+        }
+        size_t perShard = capacity / shardCount > 0 ? capacity / shardCount : 1;
+        for (size_t i = 0; i < shardCount; i++) {
+            shards_.emplace_back(new Shard(perShard));
+        }
+    }
+
+    ShardedCache(const ShardedCache&) = delete;
+    ShardedCache& operator=(const ShardedCache&) = delete;
+
+    /**
+     * 查询，命中时拷贝到out并返回true
+     */
+    bool get(const K& key, V& out) {
+        size_t h = hasher_(key);
+        Shard& shard = shardOf(h);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sketch.increment(h);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses_++;
+            return false;
+        }
+        if (expired(*it->second)) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+            expirations_++;
+            misses_++;
+            return false;
+        }
+        // 移到链表头部（最近使用）
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        out = it->second->value;
+        hits_++;
+        return true;
+    }
+
+    /**
+     * 写入；key已存在时直接覆盖，段满时按TinyLFU决定是否接纳
+     * @return 是否写入了缓存
+     */
+    bool put(const K& key, const V& value) {
+        size_t h = hasher_(key);
+        Shard& shard = shardOf(h);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->value = value;
+            it->second->expiresAt = deadline();
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return true;
+        }
+        if (shard.lru.size() >= shard.capacity) {
+            Node& victim = shard.lru.back();
+            // 已过期的尾部条目直接淘汰，否则比较频率
+            if (!expired(victim) && shard.sketch.estimate(h) <= shard.sketch.estimate(hasher_(victim.key))) {
+                rejections_++;
+                return false;
+            }
+            shard.index.erase(victim.key);
+            shard.lru.pop_back();
+            evictions_++;
+        }
+        shard.lru.push_front(Node{key, value, deadline()});
+        shard.index[key] = shard.lru.begin();
+        return true;
+    }
+
+    /**
+     * key已缓存时在锁内调用fn(value&)原地修改（写穿透），未缓存时不做处理
+     * @return 是否修改了缓存
+     */
+    template <typename Fn>
+    bool update(const K& key, Fn fn) {
+        size_t h = hasher_(key);
+        Shard& shard = shardOf(h);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            return false;
+        }
+        fn(it->second->value);
+        return true;
+    }
+
+    void invalidate(const K& key) {
+        Shard& shard = shardOf(hasher_(key));
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+    }
+
+    void clear() {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->lru.clear();
+            shard->index.clear();
+        }
+    }
+
+    Stats stats() {
+        Stats s;
+        s.hits = hits_.load();
+        s.misses = misses_.load();
+        s.rejections = rejections_.load();
+        s.evictions = evictions_.load();
+        s.expirations = expirations_.load();
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            s.size += shard->lru.size();
+        }
+        return s;
+    }
+
+    std::string dumpStats(const std::string& name) {
+        Stats s = stats();
+        uint64_t total = s.hits + s.misses;
+        return "[" + name + "] size=" + std::to_string(s.size)
+            + " hits=" + std::to_string(s.hits)
+            + " misses=" + std::to_string(s.misses)
+            + " hitRate=" + std::to_string(total > 0 ? s.hits * 100 / total : 0) + "%"
+            + " rejections=" + std::to_string(s.rejections)
+            + " evictions=" + std::to_string(s.evictions)
+            + " expirations=" + std::to_string(s.expirations);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Node {
+        K key;
+        V value;
+        Clock::time_point expiresAt;
+    };
+
+    // 4行Count-Min Sketch，每个计数4位，两个计数打包在一个字节中
+    class FrequencySketch {
+    public:
+        explicit FrequencySketch(size_t capacity) {
+            // 宽度取容量4倍以上的2的幂，降低冷key与热点key碰撞导致的频率高估
+            size_t width = 16;
+            while (width < capacity * 4) {
+                width <<= 1;
+            }
+            mask_ = width - 1;
+            table_.assign(kDepth * width / 2, 0);
+            resetAt_ = capacity * 10;
+        }
+
+        void increment(size_t hash) {
+            bool added = false;
+            for (size_t row = 0; row < kDepth; row++) {
+                added = incrementAt(row, indexOf(hash, row)) || added;
+            }
+            if (added && ++additions_ >= resetAt_) {
+                halve();
+            }
+        }
+
+        unsigned estimate(size_t hash) const {
+            unsigned freq = 15;
+            for (size_t row = 0; row < kDepth; row++) {
+                unsigned value = counterAt(row, indexOf(hash, row));
+                freq = value < freq ? value : freq;
+            }
+            return freq;
+        }
+
+    private:
+        static const size_t kDepth = 4;
+
+        size_t indexOf(size_t hash, size_t row) const {
+            // splitmix64混合，每行使用不同的种子
+            uint64_t x = static_cast<uint64_t>(hash) + 0x9E3779B97F4A7C15ULL * (row + 1);
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            x ^= x >> 31;
+            return static_cast<size_t>(x) & mask_;
+        }
+
+        unsigned counterAt(size_t row, size_t index) const {
+            size_t slot = row * (mask_ + 1) + index;
+            uint8_t byte = table_[slot / 2];
+            return (slot & 1) ? (byte >> 4) : (byte & 0x0F);
+        }
+
+        bool incrementAt(size_t row, size_t index) {
+            size_t slot = row * (mask_ + 1) + index;
+            uint8_t& byte = table_[slot / 2];
+            unsigned shift = (slot & 1) ? 4 : 0;
+            if (((byte >> shift) & 0x0F) == 15) {
+                return false;
+            }
+            byte = static_cast<uint8_t>(byte + (1u << shift));
+            return true;
+        }
+
+        void halve() {
+            for (uint8_t& byte : table_) {
+                byte = static_cast<uint8_t>((byte >> 1) & 0x77);
+            }
+            additions_ /= 2;
+        }
+
+        std::vector<uint8_t> table_;
+        size_t mask_ = 0;
+        size_t additions_ = 0;
+        size_t resetAt_ = 0;
+    };
+
+    struct Shard {
+        explicit Shard(size_t cap) : capacity(cap), sketch(cap) {}
+        std::mutex mutex;
+        size_t capacity;
+        std::list<Node> lru; // 头部为最近使用
+        std::unordered_map<K, typename std::list<Node>::iterator, Hash> index;
+        FrequencySketch sketch;
+    };
+
+    Shard& shardOf(size_t hash) {
+        // std::hash<int>是恒等映射，先混合再取模，连续的id也能均匀分到各段
+        uint64_t x = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+        return *shards_[static_cast<size_t>(x >> 32) % shards_.size()];
+    }
+
+    Clock::time_point deadline() const {
+        return ttl_.count() > 0 ? Clock::now() + ttl_ : Clock::time_point::max();
+    }
+
+    bool expired(const Node& node) const {
+        return ttl_.count() > 0 && Clock::now() >= node.expiresAt;
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::chrono::milliseconds ttl_;
+    Hash hasher_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> rejections_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> expirations_{0};
+};
+
+#endif // SHARDEDCACHE_HPP
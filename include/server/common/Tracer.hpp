@@ -0,0 +1,106 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * 按消息采样的阶段耗时追踪
+ * 消息入口按采样率决定是否追踪，被选中的消息分配一个64位trace id，保存在当前线程的上下文中；
+ * 处理过程中的TraceSpan只在上下文中有trace id时记录（阶段名、开始时间、耗时、线程、一个整数参数），
+ * 未被采样时只多一次线程局部变量的读取。记录写入固定大小的环形缓冲，写满后覆盖最旧的记录，写入无锁；
+ * exportChromeJson导出为Chrome trace格式，可在chrome://tracing或Perfetto中打开。
+ * 上下文只在同一线程内有效，投递到DB线程等异步执行的部分不会被记录；跨节点转发时由调用方把trace id带在消息中
+ */
+class Tracer {
+public:
+    static const size_t kDefaultCapacity = 16384;
+
+    static Tracer& instance();
+
+    explicit Tracer(size_t capacity = kDefaultCapacity);
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // 每n条消息追踪1条，0表示关闭（默认）
+    void setSampleEvery(uint32_t n) { sampleEvery_.store(n, std::memory_order_relaxed); }
+    uint32_t sampleEvery() const { return sampleEvery_.load(std::memory_order_relaxed); }
+    // 按采样率决定是否追踪一条新消息，选中时返回新的trace id，否则返回0
+    uint64_t sample();
+
+    // 记录一个阶段，时间单位为微秒（系统时钟，便于对齐不同节点的记录）
+    void record(uint64_t traceId, const char* name, int64_t arg, uint64_t startUs, uint64_t durationUs);
+    // 导出缓冲中现有的记录，按开始时间排序
+    std::string exportChromeJson() const;
+    // 缓冲中现有的记录数
+    size_t size() const;
+
+    // 当前线程正在追踪的trace id，没有时为0
+    static uint64_t current();
+    static uint64_t nowMicros();
+    // trace id与16位十六进制串互转，格式不对时返回0
+    static std::string idToString(uint64_t id);
+    static uint64_t idFromString(const std::string& text);
+
+private:
+    // 槽位字段都是原子变量，用序号判断读到的是否是一次完整的写入（seqlock）
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};   // 奇数表示正在写，偶数为写完的第sequence/2条
+        std::atomic<uint64_t> traceId{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<int64_t> arg{0};
+        std::atomic<uint64_t> startUs{0};
+        std::atomic<uint64_t> durationUs{0};
+        std::atomic<uint32_t> tid{0};
+    };
+
+    static uint32_t currentTid();
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    std::atomic<uint64_t> next_{0};
+    std::atomic<uint32_t> sampleEvery_{0};
+    std::atomic<uint64_t> sampleCounter_{0};
+    std::atomic<uint64_t> idCounter_{0};
+    uint64_t idPrefix_;   // 进程随机前缀，避免不同节点生成相同的trace id
+};
+
+/**
+ * 在消息入口建立当前线程的trace上下文，析构时恢复之前的上下文；traceId为0表示本条消息不追踪
+ */
+class TraceScope {
+public:
+    explicit TraceScope(uint64_t traceId);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    uint64_t previous_;
+};
+
+/**
+ * 记录一个阶段的耗时，name必须是字符串字面量（只保存指针）；当前线程没有trace上下文时什么都不做
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, int64_t arg = 0)
+        : traceId_(Tracer::current()), name_(name), arg_(arg), startUs_(traceId_ != 0 ? Tracer::nowMicros() : 0) {}
+    ~TraceSpan() {
+        if (traceId_ != 0) {
+            Tracer::instance().record(traceId_, name_, arg_, startUs_, Tracer::nowMicros() - startUs_);
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    uint64_t traceId_;
+    const char* name_;
+    int64_t arg_;
+    uint64_t startUs_;
+};
+
+#endif // TRACER_HPP
@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+using namespace std;
+/*
+批量写入器：把同一分片、同一张表的单行insert合并成多行insert
+缓冲行数达到上限或最早一行等待超过最大延迟时由后台线程刷出；
+每行返回一个future，语句提交成功后置为true（持久化确认），失败置为false；
+也可改为传入回调，由写入线程在确认时调用，调用方无需占用线程等待future
+*/
+class BatchInsertWriter
+{
+public:
+    static BatchInsertWriter* getInstance();
+
+    // 行的确认回调，参数为是否提交成功；在写入线程中调用，应尽快返回（例如只投递到IO线程）
+    using Ack = function<void(bool)>;
+
+    // 追加一行，row为已转义的values元组内容，例如 "1, 'hello'"
+    future<bool> append(int shard, const string& table, const string& columns, string row);
+    // 追加一行，确认时调用done（可为空）
+    void append(int shard, const string& table, const string& columns, string row, Ack done);
+    // 一次追加多行（同一分片、同一张表），只加一次锁
+    vector<future<bool>> append(int shard, const string& table, const string& columns, vector<string> rows);
+    // 立即刷出所有缓冲并等待写入完成
+    void flush();
+    // 设置刷出策略：单批最大行数、最大等待毫秒数
+    void setFlushPolicy(size_t maxRows, int maxDelayMs);
+    // 刷出剩余数据并停止后台线程，之后的append同步写入
+    void shutdown();
+
+private:
+    // 同一分片、同一张表、同一列清单的待写入行
+    struct Batch
+    {
+        int shard = 0;
+        string table;
+        string columns;
+        vector<string> rows;
+        vector<Ack> acks;
+        chrono::steady_clock::time_point firstAt; // 最早一行入队时刻
+    };
+
+    BatchInsertWriter();
+    ~BatchInsertWriter();
+    BatchInsertWriter(const BatchInsertWriter&) = delete;
+    BatchInsertWriter& operator=(const BatchInsertWriter&) = delete;
+
+    // 各重载的公共部分，acks与rows一一对应
+    void appendRows(int shard, const string& table, const string& columns, vector<string> rows, vector<Ack> acks);
+    void flushTask();
+    // 调用方需持有batchMutex，取出需要刷出的批次；force为true时取出全部
+    vector<Batch> takeReadyLocked(bool force);
+    // 调用方需持有batchMutex，返回最早到期的时刻
+    chrono::steady_clock::time_point nextDeadlineLocked() const;
+    // 执行多行insert并设置各行的确认结果
+    static void writeBatch(Batch& batch);
+
+    unordered_map<string, Batch> batches; // key: 分片|表名|列清单
+    mutex batchMutex;
+    condition_variable cv; // 通知后台线程有数据或有刷出请求
+    condition_variable flushedCv; // 通知flush调用方强制刷出已完成
+    size_t maxRows = 200;
+    chrono::milliseconds maxDelay{10};
+    bool flushRequested = false;
+    unsigned long long flushGeneration = 0; // 每完成一轮强制刷出加一
+    bool stopped = false;
+    thread worker;
+};
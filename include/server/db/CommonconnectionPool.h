@@ -2,27 +2,60 @@
 #include <queue>
 #include <memory>
 #include <string>
+#include <vector>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include "Connection.h"
+#include "PoolStats.h"
+#include "common/InstrumentedMutex.hpp"
+
+// 单个连接池的配置，对应mysql.ini中的一个段
+struct PoolConfig
+{
+    string name = "primary"; // 连接池名称（段名），无段名的全局配置即为primary
+    string role = "primary"; // primary 或 replica
+    string ip = "127.0.0.1"; // 数据库连接的ip
+    unsigned short port = 3306; // 数据库连接的端口
+    string username; // 数据库连接的用户名
+    string password; // 数据库连接的密码
+    string dbname; // 数据库连接的数据库名
+    int initSize = 10;   // 连接池初始连接数量
+    int maxSize = 1024; // 连接池最大连接数量
+    int maxIdleTime = 60;    // 最大空闲时间(秒)
+    int connectionTimeout = 100; // 连接超时时间(毫秒)
+    int maxReplicaLag = 5; // 从库允许的最大复制延迟(秒)，超过后读请求回落到主库
+    int shard = 0; // 所属分片编号
+};
+
 /*
 实现连接池功能
 */
 class ConnectionPool
 {
 public:
-    // 获取连接池对象实例
-    static ConnectionPool* getConnectionPool();
+    // 按配置创建连接池，并启动生产者线程和空闲连接扫描线程
+    explicit ConnectionPool(const PoolConfig& config);
+    // 读取配置文件，每个[段]对应一个连接池，段内未出现的键继承全局配置
+    static bool LoadConfigFile(const string& file, vector<PoolConfig>& configs);
     // 给外部提供接口，从连接池中获取一个可用的空闲连接
     shared_ptr<Connection> getConnection();
+    // 获取连接池运行时统计信息
+    PoolStats& getStats() { return stats; }
+    // 生成当前统计信息的可读报告
+    string dumpStats();
+    const string& getName() const { return name; }
+    bool isReplica() const { return role == "replica"; }
+    int getMaxReplicaLag() const { return maxReplicaLag; }
+    int getShard() const { return shard; }
 private:
-    // 单例模式
-    ConnectionPool();
-    bool LoadConfigFile();
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
     void produceConnectionTask();
     void scannerConnectionTask(); // 扫描超过maxIdleTime时间的空闲连接，进行对于的连接回收
+    string name; // 连接池名称
+    string role; // 连接池角色 primary/replica
     string ip; // 数据库连接的ip
     unsigned short port; // 数据库连接的端口
     string username; // 数据库连接的用户名
@@ -32,8 +65,11 @@ private:
     int maxSize; // 连接池最大连接数量
     int maxIdleTime;    // 最大空闲时间
     int connectionTimeout; // 连接超时时间
+    int maxReplicaLag; // 从库允许的最大复制延迟
+    int shard; // 所属分片编号
     queue<Connection*> connectionQue; //存储mysql连接的队列
-    mutex queMutex; // 维护连接池的互斥锁
-    atomic_int connectionCnt; // 记录连接池中的连接数量
-    condition_variable cv; // 条件变量用于生产者和消费者 两个线程间的通信
-};
\ No newline at end of file
+    InstrumentedMutex queMutex{"connection_pool"}; // 维护连接池的互斥锁，各连接池的统计汇总在一起
+    atomic_int connectionCnt{0}; // 记录连接池中的连接数量
+    condition_variable_any cv; // 条件变量用于生产者和消费者 两个线程间的通信（queMutex不是std::mutex，需用_any版本）
+    PoolStats stats; // 连接池运行时统计
+};
@@ -5,6 +5,8 @@
 #include <ctime>
 #include <mutex>
 #include <atomic>
+#include "PoolStats.h"
+#include "common/InstrumentedMutex.hpp"
 using namespace std;
 
 class Connection
@@ -27,11 +29,23 @@ public:
     bool isValid();
     // 获取原始MySQL连接指针（谨慎使用）
     MYSQL* getConnection();
+    // 获取本连接上最近一次insert生成的自增id，需在归还连接前调用
+    unsigned long long getInsertId();
+    // 设置所属连接池的统计对象，SQL执行耗时和失败次数会记录到其中
+    void setStats(PoolStats* stats) { this->stats = stats; }
+    // 记录连接被借出的时刻，归还时用于计算占用时间
+    void markCheckout() { checkoutTime = PoolStats::Clock::now(); }
+    PoolStats::Clock::time_point getCheckoutTime() const { return checkoutTime; }
     
 private:
+    // 调用方需已持有conn_mutex
+    bool pingLocked();
+
     MYSQL* conn;
     clock_t aliveTime; //记录进入空闲状态后的存活时间
-    mutable std::mutex conn_mutex; // 连接互斥锁
+    PoolStats* stats = nullptr; // 所属连接池的统计信息
+    PoolStats::Clock::time_point checkoutTime; // 最近一次被借出的时刻
+    mutable InstrumentedMutex conn_mutex{"mysql_connection"}; // 连接互斥锁，所有连接的统计汇总在一起
     std::atomic<bool> in_use{false}; // 连接使用状态
 };
 
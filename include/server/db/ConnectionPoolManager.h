@@ -3,26 +3,93 @@
 
 #include <memory>
 #include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
 #include <mysql/mysql.h>
+#include "ShardMap.h"
 
 class Connection;
 class ConnectionPool;
 
+/*
+连接池管理器：按分片持有连接池，每个分片一个主库连接池和若干从库连接池
+写操作和要求读己之写的查询走分片主库，可容忍轻微延迟的读走分片从库；
+不带分片参数的接口作用于0号分片；
+未初始化（单连接模式）时所有操作退化为临时直连，此时只有一个分片
+*/
 class ConnectionPoolManager {
 public:
     static ConnectionPoolManager* getInstance();
     bool init(const std::string& configFile = "mysql.ini");
-    bool update(const std::string& sql);
+    // 在主库上执行insert/update/delete，insertId非空时返回自增主键
+    bool update(const std::string& sql, unsigned long long* insertId = nullptr);
+    // 在主库上查询
     MYSQL_RES* query(const std::string& sql);
-    
+    // 在从库上查询：轮询选择复制延迟不超过阈值的从库，均不可用时回落到主库
+    MYSQL_RES* queryReplica(const std::string& sql);
+
+    // 以下接口显式指定分片，分片编号由getShardMap().shardOf(id)得到
+    bool updateOn(int shard, const std::string& sql, unsigned long long* insertId = nullptr);
+    MYSQL_RES* queryOn(int shard, const std::string& sql);
+    MYSQL_RES* queryReplicaOn(int shard, const std::string& sql);
+    // 分散-聚集查询：sqls[i]在第i个分片上执行（为空则跳过），多个分片并行执行
+    // 返回值与sqls一一对应，调用方负责释放非空的结果集
+    std::vector<MYSQL_RES*> scatterQuery(const std::vector<std::string>& sqls, bool useReplica = true);
+    // 在所有分片主库上执行同一条写语句，全部成功才返回true
+    bool updateAll(const std::string& sql);
+
+    // 事务内可用的操作，均在同一个主库连接上执行
+    struct Transaction {
+        // insertId非空时返回自增主键或LAST_INSERT_ID(expr)的值
+        std::function<bool(const std::string& sql, unsigned long long* insertId)> update;
+        // 调用方负责释放非空的结果集
+        std::function<MYSQL_RES*(const std::string& sql)> query;
+    };
+    // 在分片主库的一个连接上执行事务：body返回true且提交成功才返回true，否则回滚
+    bool transactionOn(int shard, const std::function<bool(Transaction&)>& body);
+
+    // 转义字符串中的 \0 \n \r \\ ' " \x1a，用于拼接SQL字符串字面量（连接字符集为utf8mb4）
+    static std::string escape(const std::string& input);
+
+    ShardMap& getShardMap() { return shardMap; }
+    int shardCount() const { return shardMap.shardCount(); }
+    bool isInitialized() const { return initialized; }
+    // 返回连接池统计报告（连接数、超时、创建/销毁、等待/占用/查询耗时分布）
+    std::string dumpStats();
+
 private:
+    // 从库及其最近一次探测到的复制延迟(秒)，-1表示复制中断或探测失败
+    struct Replica {
+        ConnectionPool* pool;
+        std::atomic<int> lagSeconds{-1};
+    };
+    // 一个分片：主库连接池 + 从库连接池
+    struct Shard {
+        ConnectionPool* primary = nullptr;
+        std::vector<std::unique_ptr<Replica>> replicas;
+        std::atomic<unsigned int> replicaCursor{0}; // 从库轮询游标
+    };
+
     ConnectionPoolManager() = default;
-    ~ConnectionPoolManager() = default;
+    ~ConnectionPoolManager();
     ConnectionPoolManager(const ConnectionPoolManager&) = delete;
     ConnectionPoolManager& operator=(const ConnectionPoolManager&) = delete;
-    
-    ConnectionPool* pool = nullptr;
+
+    MYSQL_RES* queryPool(ConnectionPool* target, const std::string& sql);
+    // 未启用连接池时的临时直连
+    bool updateDirect(const std::string& sql, unsigned long long* insertId);
+    MYSQL_RES* queryDirect(const std::string& sql);
+    // 在已建立的连接上执行事务
+    static bool runTransaction(MYSQL* mysql, const std::function<bool(Transaction&)>& body);
+    // 后台线程：定期探测各从库的复制延迟
+    void replicaLagMonitorTask();
+    int probeReplicaLag(ConnectionPool* replica);
+
+    std::vector<std::unique_ptr<ConnectionPool>> pools; // 所有连接池
+    std::vector<std::unique_ptr<Shard>> shards; // 下标即分片编号
+    ShardMap shardMap;
     bool initialized = false;
 };
 
-#endif
\ No newline at end of file
+#endif
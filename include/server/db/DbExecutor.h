@@ -0,0 +1,158 @@
+#pragma once
+#include <muduo/net/EventLoop.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+using namespace std;
+
+// 异步查询的完成状态
+enum class DbStatus
+{
+    OK,          // 执行完成
+    TIMEOUT,     // 排队超过截止时间，未执行
+    OVERLOADED,  // 队列已满，未入队
+    FAILED       // 执行中抛出异常
+};
+
+// submit返回的future在非OK状态下抛出此异常
+class DbExecutorError : public runtime_error
+{
+public:
+    DbExecutorError(DbStatus status, const string& what) : runtime_error(what), status(status) {}
+    DbStatus status;
+};
+
+/*
+数据库异步执行器：固定数量的DB线程从有界队列取任务执行，IO线程只负责投递，不再等待MySQL往返；
+完成方式二选一：submit返回future；post把结果回调投递到发起请求的EventLoop（queueInLoop），
+回调与该连接的其他事件在同一个IO线程中串行执行；
+每个任务带排队截止时间，出队时已过期的任务不再执行，直接以TIMEOUT完成，避免积压时执行早已无人等待的查询；
+截止时间只限制排队，任务开始执行后不会被中断，单条SQL的耗时由连接上的MYSQL_OPT_READ_TIMEOUT/WRITE_TIMEOUT兜底
+*/
+class DbExecutor
+{
+public:
+    static DbExecutor* getInstance();
+
+    // 提交任务，返回future；排队超过queueTimeoutMs、队列满或任务异常时future.get()抛出异常
+    template <typename F>
+    auto submit(F task, int queueTimeoutMs = kDefaultQueueTimeoutMs) -> future<decltype(task())>;
+    // 提交任务，完成后在loop线程中调用done(status, result)；非OK时result为默认值，task需有非void返回值
+    template <typename F, typename Done>
+    void post(muduo::net::EventLoop* loop, F task, Done done, int queueTimeoutMs = kDefaultQueueTimeoutMs);
+
+    // 停止所有DB线程，队列中剩余任务以TIMEOUT完成
+    void shutdown();
+    // 返回队列长度、超时、拒绝等统计
+    string dumpStats();
+    // 当前排队的任务数
+    size_t queueDepth();
+
+    // 默认的排队等待上限
+    static const int kDefaultQueueTimeoutMs = 3000;
+
+private:
+    struct Job
+    {
+        function<void(DbStatus)> run; // 参数为OK时执行任务，否则只通知失败
+        chrono::steady_clock::time_point queueDeadline; // 超过此时刻仍未出队则不再执行
+    };
+
+    DbExecutor();
+    ~DbExecutor();
+    DbExecutor(const DbExecutor&) = delete;
+    DbExecutor& operator=(const DbExecutor&) = delete;
+
+    // 入队，队列满或已停止时返回false
+    bool enqueue(Job job);
+    void workerTask();
+
+    deque<Job> jobs;
+    mutex jobMutex;
+    condition_variable cv;
+    size_t capacity;
+    bool stopped = false;
+    vector<thread> workers;
+
+    atomic<unsigned long long> executed{0};
+    atomic<unsigned long long> timeouts{0};
+    atomic<unsigned long long> rejected{0};
+    atomic<unsigned long long> failures{0};
+};
+
+template <typename F>
+auto DbExecutor::submit(F task, int queueTimeoutMs) -> future<decltype(task())>
+{
+    using T = decltype(task());
+    auto result = make_shared<promise<T>>();
+    future<T> fut = result->get_future();
+
+    Job job;
+    job.queueDeadline = chrono::steady_clock::now() + chrono::milliseconds(queueTimeoutMs);
+    job.run = [this, result, task](DbStatus status) mutable {
+        if (status == DbStatus::TIMEOUT)
+        {
+            result->set_exception(make_exception_ptr(DbExecutorError(status, "db queue deadline exceeded")));
+            return;
+        }
+        try
+        {
+            if constexpr (is_void<T>::value)
+            {
+                task();
+                result->set_value();
+            }
+            else
+            {
+                result->set_value(task());
+            }
+        }
+        catch (...)
+        {
+            failures++;
+            result->set_exception(current_exception());
+        }
+    };
+    if (!enqueue(std::move(job)))
+    {
+        result->set_exception(make_exception_ptr(DbExecutorError(DbStatus::OVERLOADED, "db executor queue full")));
+    }
+    return fut;
+}
+
+template <typename F, typename Done>
+void DbExecutor::post(muduo::net::EventLoop* loop, F task, Done done, int queueTimeoutMs)
+{
+    using T = decltype(task());
+    Job job;
+    job.queueDeadline = chrono::steady_clock::now() + chrono::milliseconds(queueTimeoutMs);
+    job.run = [this, loop, task, done](DbStatus status) mutable {
+        auto value = make_shared<T>();
+        if (status == DbStatus::OK)
+        {
+            try
+            {
+                *value = task();
+            }
+            catch (...)
+            {
+                failures++;
+                status = DbStatus::FAILED;
+            }
+        }
+        loop->queueInLoop([done, status, value]() mutable { done(status, std::move(*value)); });
+    };
+    if (!enqueue(std::move(job)))
+    {
+        loop->queueInLoop([done]() mutable { done(DbStatus::OVERLOADED, T()); });
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <chrono>
+using namespace std;
+/*
+连接池运行时统计：计数器 + 延迟直方图
+所有字段均为原子变量，生产者/消费者/扫描线程无需额外加锁即可更新
+*/
+
+// 以2的幂划分桶的延迟直方图（单位：微秒）
+// 第0个桶记录[0,1)us，第i个桶记录[2^(i-1), 2^i)us，最后一个桶兜底所有更大的值
+class LatencyHistogram
+{
+public:
+    static const int kBucketCount = 32;
+
+    LatencyHistogram();
+    // 记录一次耗时
+    void record(int64_t micros);
+    // 返回分位数（取所在桶的上界，p取值0~100）
+    int64_t percentile(double p) const;
+    uint64_t count() const { return totalCount.load(memory_order_relaxed); }
+    uint64_t sum() const { return totalSum.load(memory_order_relaxed); }
+    int64_t max() const { return maxValue.load(memory_order_relaxed); }
+    uint64_t bucketCount(int idx) const { return buckets[idx].load(memory_order_relaxed); }
+    // 返回第idx个桶的上界（微秒）
+    static int64_t bucketUpperBound(int idx);
+    // 输出 count/avg/p50/p90/p99/max 的摘要
+    string summary() const;
+    void reset();
+
+private:
+    static int bucketIndex(int64_t micros);
+
+    atomic<uint64_t> buckets[kBucketCount];
+    atomic<uint64_t> totalCount;
+    atomic<uint64_t> totalSum;
+    atomic<int64_t> maxValue;
+};
+
+class PoolStats
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    // 返回从start到现在经过的微秒数
+    static int64_t elapsedMicros(Clock::time_point start)
+    {
+        return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+    }
+
+    // 生成可读的统计报告，idle/total为调用时刻连接池的空闲连接数和连接总数
+    string dump(const string& poolName, size_t idle, int total) const;
+    // 清零所有计数器和直方图
+    void reset();
+
+    atomic<uint64_t> checkouts{0};          // 成功借出连接的次数
+    atomic<uint64_t> timeouts{0};           // 等待连接超时的次数
+    atomic<uint64_t> creates{0};            // 新建连接的次数
+    atomic<uint64_t> createFailures{0};     // 新建连接失败的次数
+    atomic<uint64_t> destroys{0};           // 销毁连接的次数
+    atomic<uint64_t> validationFailures{0}; // 借出前校验(ping)失败的次数
+    atomic<uint64_t> queryFailures{0};      // SQL执行失败的次数
+
+    LatencyHistogram waitTime;   // 借连接时在队列上的等待时间
+    LatencyHistogram holdTime;   // 连接从借出到归还的占用时间
+    LatencyHistogram queryTime;  // 单条SQL的执行时间
+};
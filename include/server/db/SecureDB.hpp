@@ -57,6 +57,12 @@ public:
      */
     unsigned long long getAffectedRows();
     
+    /**
+     * 获取最近一次executeUpdate执行失败时的MySQL错误码
+     * @return 错误码，成功时为0
+     */
+    unsigned int getLastErrno() const { return _lastErrno; }
+    
     /**
      * 开始事务
      * @return 是否成功
@@ -84,6 +90,7 @@ public:
     
 private:
     MYSQL* _conn;
+    unsigned int _lastErrno;
     
     /**
      * 绑定参数到预编译语句
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <atomic>
+using namespace std;
+/*
+分片映射：用户id/群组id -> 分片编号
+各分片的MySQL实例配置 auto_increment_increment = 分片数、auto_increment_offset = 分片编号 + 1，
+因此分片k上生成的自增id满足 (id - 1) % 分片数 == k，id本身即可定位所在分片，无需额外的路由表
+*/
+class ShardMap
+{
+public:
+    explicit ShardMap(int shardCount = 1);
+    int shardCount() const { return count; }
+    // 加载配置后设置分片数，须在处理请求之前调用
+    void setShardCount(int shardCount);
+    // 返回id所在的分片，非法id归到0号分片
+    int shardOf(int id) const
+    {
+        return (count <= 1 || id <= 0) ? 0 : (id - 1) % count;
+    }
+    // 新建用户/群组时选择写入的分片（轮询，保持各分片数据量均衡）
+    int nextInsertShard();
+    // 把一组id按所在分片分桶，返回值下标即分片编号
+    vector<vector<int>> groupByShard(const vector<int>& ids) const;
+
+private:
+    int count;
+    atomic<unsigned int> insertCursor{0};
+};
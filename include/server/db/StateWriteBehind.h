@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+using namespace std;
+/*
+用户状态回写队列：登录、注销、异常断开时的状态变更先进入队列，
+同一用户的多次变更只保留最后一次，由后台线程按分片和状态合并成
+update user set state = ... where id in (...) 批量写入，写入online时同时记下本节点名；
+尚未落库的状态可通过pendingState查询，保证读己之写
+*/
+class StateWriteBehind
+{
+public:
+    static StateWriteBehind* getInstance();
+
+    // 记录用户状态变更，立即返回
+    void enqueue(int userid, const string& state);
+    // 查询尚未落库的状态，存在时写入state并返回true
+    bool pendingState(int userid, string& state);
+    // 立即写入所有待写状态并等待完成
+    void flush();
+    // 设置刷出策略：待写用户数上限、最大等待毫秒数
+    void setFlushPolicy(size_t maxPending, int maxDelayMs);
+    // 设置写入user.node的本节点名，应在第一次enqueue之前调用
+    void setNodeName(const string& name);
+    string nodeName();
+    // 刷出剩余状态并停止后台线程，之后的enqueue同步写入
+    void shutdown();
+
+private:
+    StateWriteBehind();
+    ~StateWriteBehind();
+    StateWriteBehind(const StateWriteBehind&) = delete;
+    StateWriteBehind& operator=(const StateWriteBehind&) = delete;
+
+    void flushTask();
+    // 按分片、状态分组写入，返回写入失败的条目
+    static unordered_map<int, string> writeStates(const unordered_map<int, string>& states, const string& node);
+
+    unordered_map<int, string> pending; // 等待写入：userid -> state
+    unordered_map<int, string> inflight; // 正在写入，写完前仍需对读可见
+    mutex stateMutex;
+    condition_variable cv; // 通知后台线程有数据或有刷出请求
+    condition_variable flushedCv; // 通知flush调用方强制刷出已完成
+    string node; // 本节点名，重启后启动清理只清除本节点名下的online
+    size_t maxPending = 500;
+    chrono::milliseconds maxDelay{50};
+    bool flushRequested = false;
+    unsigned long long flushGeneration = 0; // 每完成一轮强制刷出加一
+    bool stopped = false;
+    thread worker;
+};
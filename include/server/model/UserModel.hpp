@@ -3,6 +3,8 @@
 #include "user.hpp"
 #include "common/ErrorCodes.hpp"
 #include <utility>
+#include <vector>
+#include <string>
 
 enum class DBConnectionType {
     SINGLE_CONNECTION,  // 原有的单连接方式
@@ -18,10 +20,26 @@ public:
     ErrorCode insert(User &user);
     // 根据用户号码查询用户信息
     std::pair<User, ErrorCode> query(int id);
-    // 更新用户的状态信息
+    // 更新用户的状态信息：进入回写队列后立即返回，由后台线程批量落库
     bool updateState(User user);
-    // 重置用户的状态信息
+    // 等待回写队列中的状态全部落库
+    void flushState();
+    // 设置本节点名，写入online状态时记入user.node；多节点部署时各节点必须不同且重启后保持不变
+    static void setNodeName(const std::string& name);
+    // 把本节点名下的online用户置为offline（同步执行，用于启动时清理本节点上次异常退出遗留的online状态，
+    // 其他节点上在线的用户不受影响）
     void resetState();
+    // 批量查询用户的id、name、state（先查缓存，未命中的跨分片分散-聚集，走从库）
+    // 有分片查询失败时结果不完整，complete非空则置为false
+    std::vector<User> queryByIds(const std::vector<int>& ids, bool* complete = nullptr);
+    // 丢弃用户的缓存记录（其他节点修改了该用户时调用）
+    static void invalidateCache(int id);
+    // 其他节点推送来的用户状态：直接更新缓存，并在对方落库前覆盖从数据库读到的旧状态
+    static void applyRemoteState(int id, const std::string& state);
+    // 返回用户缓存的命中率等统计
+    static std::string dumpCacheStats();
+    // 从各分片读取全部用户的id和用户名，重建用户存在性过滤器
+    static bool loadExistenceFilter();
     
 private:
     static DBConnectionType connectionType;
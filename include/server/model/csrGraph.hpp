@@ -0,0 +1,86 @@
+#ifndef CSRGRAPH_H
+#define CSRGRAPH_H
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+using namespace std;
+
+/*
+压缩稀疏行（CSR）邻接表：一次性从边集构建，之后的增删记录在增量层中
+  vertices  有出边的顶点id，升序
+  offsets   vertices[i]的邻居位于targets[offsets[i], offsets[i+1])，各段内升序
+  targets   所有邻居顶点id首尾相连
+查找顶点为O(log V)二分，遍历邻居为O(degree)且内存连续；
+增量层超过阈值时合并进新的CSR数组，读者用共享锁，写者用独占锁
+*/
+class CsrGraph
+{
+public:
+    // 用边集(from, to)重建基础数组并清空增量层，重复的边只保留一条
+    void build(vector<pair<int, int>> edges);
+    // 增加一条边，已存在时返回false
+    bool addEdge(int from, int to);
+    // 删除一条边，不存在时返回false
+    bool removeEdge(int from, int to);
+    bool hasEdge(int from, int to);
+    // 返回from的所有邻居
+    vector<int> neighbors(int from);
+    // 在共享锁内对from的每个邻居调用fn，fn中不能再修改本图
+    template <typename Fn>
+    void forEachNeighbor(int from, Fn fn);
+    // 把增量层合并进基础数组
+    void compact();
+
+    size_t edgeCount();
+    size_t overlaySize();
+
+private:
+    struct Csr
+    {
+        vector<int> vertices;
+        vector<uint32_t> offsets;
+        vector<int> targets;
+    };
+    // 返回from在基础数组中的邻居区间，不存在时返回空区间
+    static pair<const int *, const int *> baseRange(const Csr &csr, int from);
+    bool hasEdgeLocked(int from, int to) const;
+    void compactLocked();
+
+    Csr _base;
+    unordered_map<int, vector<int>> _added;   // 基础数组之外新增的边
+    unordered_map<int, vector<int>> _removed; // 基础数组中已删除的边
+    size_t _overlayEdges = 0;
+    shared_mutex _mutex;
+};
+
+template <typename Fn>
+void CsrGraph::forEachNeighbor(int from, Fn fn)
+{
+    shared_lock<shared_mutex> lock(_mutex);
+    auto range = baseRange(_base, from);
+    auto removed = _removed.find(from);
+    for (const int *it = range.first; it != range.second; ++it)
+    {
+        if (removed != _removed.end()
+            && find(removed->second.begin(), removed->second.end(), *it) != removed->second.end())
+        {
+            continue;
+        }
+        fn(*it);
+    }
+    auto added = _added.find(from);
+    if (added != _added.end())
+    {
+        for (int to : added->second)
+        {
+            fn(to);
+        }
+    }
+}
+
+#endif
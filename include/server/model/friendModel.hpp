@@ -1,16 +1,17 @@
 #ifndef FRIENDMODEL_HPP
 #define FRIENDMODEL_HPP
 #include<vector>
+#include<functional>
 #include"user.hpp"
 
 using namespace std;
 class FriendModel
 {
 public:
-    //添加好友关系
-    void insert(int userid, int friendid);
-    //返回用户好友列表
-    vector<User> query(int userid);
+    //添加好友关系，写入经批量写入器合并，落库后在写入线程中调用done(是否成功)
+    void insert(int userid, int friendid, function<void(bool)> done);
+    //返回用户好友列表，查询失败时结果不完整，complete非空则置为false
+    vector<User> query(int userid, bool *complete = nullptr);
     //删除好友关系
     void remove(int userid, int friendid);
 private:
@@ -0,0 +1,57 @@
+#ifndef GROUPMEMBERCACHE_H
+#define GROUPMEMBERCACHE_H
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+using namespace std;
+
+/*
+群成员缓存：groupid -> 按userid升序排列的成员数组
+首次群聊时从数据库加载，加群/建群时原地更新，其他节点的变更通过redis通知失效；
+成员数组不可变，更新时复制后整体替换，读者拿到的shared_ptr在遍历期间始终有效；
+按groupid分段加锁，不同群的读写互不竞争；条目带有效期，redis通知丢失时最终也会重新加载
+*/
+class GroupMemberCache
+{
+public:
+    using Members = shared_ptr<const vector<int>>;
+
+    explicit GroupMemberCache(size_t maxGroups = 100000, chrono::seconds ttl = chrono::seconds(300));
+
+    // 返回群成员，未缓存或已过期时返回nullptr
+    Members get(int groupid);
+    // 开始从数据库加载前取得的版本号，传给put
+    unsigned long long version(int groupid);
+    // 写入从数据库加载的完整成员列表；加载期间该段有过变更（版本号变化）时放弃写入，避免旧数据覆盖新变更
+    bool put(int groupid, vector<int> members, unsigned long long loadVersion);
+    // 群已缓存时加入一个成员，未缓存时不做处理（下次访问再完整加载）
+    void addMember(int groupid, int userid);
+    // 删除一个群的缓存
+    void invalidate(int groupid);
+    // 当前缓存的群数量
+    size_t size();
+
+private:
+    struct Entry
+    {
+        Members members;
+        chrono::steady_clock::time_point loadedAt;
+    };
+    struct Segment
+    {
+        mutex segMutex;
+        unordered_map<int, Entry> groups;
+        unsigned long long version = 0; // 段内任一群发生变更时加一
+    };
+    static const int kSegmentCount = 16;
+
+    Segment &segmentOf(int groupid) { return _segments[static_cast<unsigned int>(groupid) % kSegmentCount]; }
+
+    Segment _segments[kSegmentCount];
+    size_t _maxGroupsPerSegment;
+    chrono::seconds _ttl;
+};
+
+#endif
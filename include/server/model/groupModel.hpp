@@ -3,18 +3,30 @@
 #include "group.hpp"
 #include<string>
 #include<vector>
+#include<functional>
+#include<unordered_map>
 using namespace std;
 class GroupModel
 {
 public:
     //创建群组
     bool createGroup(Group &group);
-    //加入群组
-    void addGroup(int userid, int groupid, string role);
-    //查询用户所在群组信息
-    vector<Group> queryGroups(int userid);
+    //加入群组，写入经批量写入器合并，落库后在写入线程中调用done(是否成功)，done可为空
+    void addGroup(int userid, int groupid, string role, function<void(bool)> done = nullptr);
+    //查询用户所在群组信息，群组和成员各一次批量查询，与群组数量无关
+    //以下批量查询在有分片查询失败时结果不完整，complete非空则置为false
+    vector<Group> queryGroups(int userid, bool *complete = nullptr);
+    //按id批量查询群组信息及成员（增量同步时只加载有变化的群组）
+    vector<Group> queryGroupsByIds(const vector<int> &groupids, bool *complete = nullptr);
+    //批量查询一组群组的成员信息，返回groupid -> 成员列表
+    unordered_map<int, vector<GroupUser>> queryGroupMembers(const vector<int> &groupids, bool *complete = nullptr);
     //根据指定的groupid查询群组用户id列表，除userid自己，主要用户群聊业务给群组其他成员群发消息
     vector<int> queryGroupUsers(int userid, int groupid);
+    //查询群组全部成员id（读主库，结果用于填充群成员缓存），查询失败返回false
+    bool queryGroupMemberIds(int groupid, vector<int> &ids);
+private:
+    //批量加载并填充群组的成员列表
+    void fillMembers(vector<Group> &vec, bool *complete);
 };
 
 #endif
\ No newline at end of file
@@ -2,17 +2,26 @@
 #define OFFLINEMESSAGEMODEL_HPP
 #include <string>
 #include <vector>
+#include <future>
 using namespace std;
+//一条离线消息，id为offlinemessage表的自增主键，用作分页游标
+struct OfflineMsg
+{
+    int id;
+    string message;
+};
 // 提供离线消息的存储，读取，删除
 class OfflineMsgModel
 {
 public:
-    //存储用户的离线消息
-    void insert(int userid, string msg);
-    //删除用户的离线消息
-    void remove(int userid);
-    //查询用户的离线消息
-    vector<string> query(int userid);
+    //存储用户的离线消息，写入经批量写入器合并，future在落库后就绪
+    future<bool> insert(int userid, string msg);
+    //给多个用户存储同一条离线消息（群消息扇出），按分片合并为多行insert
+    vector<future<bool>> insert(const vector<int> &userids, const string &msg);
+    //删除用户已确认收到的离线消息，只删除ids中列出的行
+    bool remove(int userid, const vector<int> &ids);
+    //按id升序查询用户id大于afterId的至多limit条离线消息
+    vector<OfflineMsg> queryPage(int userid, int afterId, int limit);
 private:
     //存储离线消息的表名
     string _offlineMsgTable = "offlinemessage";
@@ -0,0 +1,59 @@
+#ifndef RELATIONLOGMODEL_HPP
+#define RELATIONLOGMODEL_HPP
+#include <string>
+#include <vector>
+using namespace std;
+
+//各分片日志的水位：version为已提交的最大版本号，purged为已清理到的版本号，下标为分片号
+struct RelationWatermark
+{
+    vector<long long> version;
+    vector<long long> purged;
+};
+
+/*
+关系变更日志：好友、所在群组和群成员的每次变化追加一行，在关系表插入成功后写入；
+版本号由各分片relation_seq表中的计数器在事务内分配，计数器行锁使同一分片的日志按版本号顺序提交，不依赖节点时钟；
+客户端登录时带上上次同步到的各分片版本号，服务器只下发此后的变化；
+'friend'和'group'行按用户id存放，'member'行按群组id存放，与对应的关系表同分片
+*/
+class RelationLogModel
+{
+public:
+    //关系表插入成功后调用，投递到DB线程写日志，不阻塞调用线程
+    static void appendFriendAsync(int userid, int friendid);
+    static void appendGroupMemberAsync(int groupid, int userid);
+
+    //用户userid添加了好友friendid
+    bool appendFriend(int userid, int friendid);
+    //用户userid加入了群组groupid，同时记录用户所在群组和群成员两方面的变化
+    bool appendGroupMember(int groupid, int userid);
+
+    //读取各分片的水位，须在查询变化之前读取；任一分片失败返回false
+    bool queryWatermark(RelationWatermark &mark);
+    //客户端版本号能否增量同步：分片数一致且各分片版本号都在[purged, version]之间
+    static bool covers(const RelationWatermark &mark, const vector<long long> &version);
+
+    //以下查询(since, until]之间的变化，失败时返回false，调用方应改为全量同步，避免客户端漏掉变化
+    //查询用户新增的好友id
+    bool queryFriendsSince(int userid, const vector<long long> &since, const vector<long long> &until, vector<int> &ids);
+    //查询用户新加入的群组id
+    bool queryGroupsSince(int userid, const vector<long long> &since, const vector<long long> &until, vector<int> &ids);
+    //在groupids中找出有成员变化的群组
+    bool queryChangedGroups(const vector<int> &groupids, const vector<long long> &since, const vector<long long> &until,
+                            vector<int> &ids);
+    //删除超过保留期限的日志，并推进各分片的purged
+    bool purgeExpired();
+
+private:
+    //在shard上分配版本号并写入一行，失败重试一次，仍失败则让该分片的客户端全量同步
+    static bool appendOn(int shard, int ownerid, const char *kind, int targetid);
+    //推进shard的版本号并把purged提到同一位置，此前的所有客户端版本号失效
+    static bool invalidate(int shard);
+    //补做此前未能执行的invalidate，仍有未完成的返回false
+    static bool flushStale();
+    //按分片执行查询，收集第一列的id，任一分片失败返回false
+    static bool queryIds(const vector<string> &sqls, vector<int> &ids);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SOCIALGRAPH_H
+#define SOCIALGRAPH_H
+#include "csrGraph.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+using namespace std;
+
+/*
+常驻内存的社交关系图：启动时从各分片的friend、groupuser表加载成CSR数组，并定期重新加载，
+纠正丢失的跨节点通知带来的偏差；运行期间的加好友、加群记录在各图的增量层中；
+好友列表、群成员、在线状态扇出等只需遍历邻居的场景直接读内存，不再查询数据库
+*/
+class SocialGraph
+{
+public:
+    static SocialGraph *instance();
+
+    // 从数据库加载全部好友和群成员关系，失败时保持原状态（未加载时调用方回落到数据库查询）；
+    // 加载开始前一段时间内及加载期间的增删在重建后重放，尚未落库或未同步到从库的变更不会被新数组覆盖
+    bool load();
+    bool isLoaded() const { return _loaded.load(memory_order_acquire); }
+
+    CsrGraph &friends() { return _friends; }       // userid -> friendid
+    CsrGraph &friendOf() { return _friendOf; }     // friendid -> userid，状态变化时据此找到需要通知的用户
+    CsrGraph &userGroups() { return _userGroups; } // userid -> groupid
+    CsrGraph &groupUsers() { return _groupUsers; } // groupid -> userid
+
+    // 记录新的好友关系，同时维护两个方向；关系已存在时返回false
+    bool addFriend(int userid, int friendid);
+    // 撤销好友关系（写库失败时回滚，只应撤销本次addFriend返回true的边）
+    void removeFriend(int userid, int friendid);
+    // 记录新的群成员关系，同时维护两个方向；关系已存在时返回false
+    bool addGroupMember(int groupid, int userid);
+    // 撤销群成员关系（写库失败时回滚，只应撤销本次addGroupMember返回true的边）
+    void removeGroupMember(int groupid, int userid);
+
+private:
+    SocialGraph() = default;
+    SocialGraph(const SocialGraph &) = delete;
+    SocialGraph &operator=(const SocialGraph &) = delete;
+
+    // 在所有分片上执行sql，把每行的前两列收集为边
+    static bool loadEdges(const string &sql, vector<pair<int, int>> &edges);
+
+    // 运行期的一次增删
+    struct Change
+    {
+        bool add;
+        bool member; // true为群成员(groupid, userid)，false为好友(userid, friendid)
+        int a;
+        int b;
+    };
+    // 调用方需持有_changeMutex，修改关系图并记下变更供重新加载后重放
+    bool applyLocked(const Change &change);
+    // 调用方需持有_changeMutex，修改关系图
+    bool applyToGraphs(const Change &change);
+
+    // 重新加载时重放加载开始前这段时间内的变更，需长于批量写入的延迟和从库的复制延迟
+    static constexpr chrono::seconds kReplayWindow{60};
+
+    CsrGraph _friends;
+    CsrGraph _friendOf;
+    CsrGraph _userGroups;
+    CsrGraph _groupUsers;
+    mutex _changeMutex; // 串行化运行期的增删与加载结束时的重放
+    bool _loading = false;
+    deque<pair<chrono::steady_clock::time_point, Change>> _recentChanges; // 最近kReplayWindow内的变更，加载期间不清理
+    atomic<bool> _loaded{false};
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef USERFILTER_H
+#define USERFILTER_H
+#include "../common/CountingBloomFilter.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+using namespace std;
+
+/*
+用户存在性过滤器：用户id和用户名各一个计数布隆过滤器
+启动时从各分片加载，注册、删除用户时增量更新（其他节点的注册经关系变更通知到达），并定期整体重建；
+其他节点刚注册的用户在通知到达前不在过滤器中，因此：
+  id：分片内自增id单调递增，不超过上一次重建时该分片最大id的用户在本次重建扫描时一定已经提交，
+      只对这个范围内的id做出"一定不存在"的判断，更大的id视为可能存在
+  用户名：未命中只用于跳过注册前的查重，重复注册最终由user.name的唯一约束拦截
+未加载完成前一律视为可能存在
+*/
+class UserFilter
+{
+public:
+    static UserFilter *instance();
+
+    // 全部用户的(id, 用户名)，读取失败返回false
+    using UserScanner = function<bool(vector<pair<int, string>> &)>;
+    // 用户id所在的分片，分片内的自增id单调递增
+    using ShardOf = function<int(int)>;
+    // 用scanner读取全部用户重建两个过滤器，加载期间的增删在换入新过滤器后重放
+    bool load(const UserScanner &scanner, const ShardOf &shardOf);
+    bool isLoaded() const { return _loaded.load(memory_order_acquire); }
+
+    void addUser(int id, const string &name);
+    void removeUser(int id, const string &name);
+    // 返回false表示该id的用户一定不存在
+    bool mightExist(int id);
+    // 返回false表示已知的用户中没有该用户名（其他节点刚注册的可能尚未通知到）
+    bool mightExistName(const string &name);
+
+private:
+    UserFilter() = default;
+    UserFilter(const UserFilter &) = delete;
+    UserFilter &operator=(const UserFilter &) = delete;
+
+    // 加载期间发生的增删
+    struct Change
+    {
+        bool add;
+        int id;
+        string name;
+    };
+
+    // 上一次重建结束后至少间隔这么久的重建才把上一次的最大id作为可信范围，
+    // 需长于一次注册从分配自增id到提交、并同步到从库的时间
+    static constexpr chrono::seconds kTrustDelay{60};
+
+    unique_ptr<CountingBloomFilter> _ids;
+    unique_ptr<CountingBloomFilter> _names;
+    shared_mutex _mutex;
+    bool _loading = false;
+    vector<Change> _changesDuringLoad;
+    atomic<bool> _loaded{false};
+    ShardOf _shardOf;
+    unordered_map<int, int> _trustedMaxIds; // 分片 -> 不超过该值的id可判断一定不存在
+    unordered_map<int, int> _lastMaxIds;    // 分片 -> 上一次重建扫描到的最大id
+    chrono::steady_clock::time_point _lastScanEnd;
+    bool _scanned = false;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef PRESENCENOTIFIER_H
+#define PRESENCENOTIFIER_H
+#include <muduo/net/TcpConnection.h>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include "common/DebounceQueue.hpp"
+using namespace std;
+using namespace muduo::net;
+
+/*
+在线状态推送：好友上线/下线的通知按接收方合并，防抖窗口内同一接收方的多次变化合成一帧发送，
+同一好友的多次变化只发送最终状态；后台线程在窗口到期时发送，TcpConnection::send可跨线程调用
+*/
+class PresenceNotifier
+{
+public:
+    explicit PresenceNotifier(int debounceMs = 200, size_t maxChanges = 256);
+    ~PresenceNotifier();
+
+    //通知recipient（连接为conn）：userid的状态变为state
+    void notify(int recipient, const TcpConnectionPtr &conn, int userid, const string &state);
+    //接收方下线，丢弃尚未发出的通知
+    void cancel(int recipient);
+    //停止后台线程，未发出的通知直接丢弃（进程退出时接收方也将断开）
+    void shutdown();
+
+private:
+    void flushTask();
+    //把一个接收方的一批变化组成一帧发送
+    static void send(const TcpConnectionPtr &conn, const DebounceQueue<int, int, string>::Items &changes);
+
+    DebounceQueue<int, int, string> _queue; // 接收方 -> (好友id -> 状态)
+    unordered_map<int, weak_ptr<TcpConnection>> _conns; // 接收方的连接，不延长连接的生命周期
+    mutex _mutex;
+    condition_variable _cv;
+    bool _stopped = false;
+    thread _worker;
+};
+
+#endif
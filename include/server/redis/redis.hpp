@@ -5,6 +5,8 @@
 #include <string>
 #include <thread>
 #include <functional>
+#include <mutex>
+#include <unordered_map>
 using namespace std;
 
 class Redis{
@@ -18,7 +20,14 @@ public:
     bool unsubscribe(int channel);
     void observer_channel_message();//在独立线程中接收订阅通道的消息
     void init_notify_handler(function<void(int, string)> fn);//初始化向业务层上报消息的回调对象
+    //命名通道：用于服务器节点之间的广播（例如缓存失效通知），与以用户id命名的通道互不干扰
+    bool publish(const string &channel, const string &message);
+    bool subscribe(const string &channel, function<void(string)> handler);
 private:
+    bool sendSubscribeCommand(const char *command, const string &channel);
+    mutex _publish_mutex; //publish上下文被多个IO线程共用
+    mutex _handler_mutex;
+    unordered_map<string, function<void(string)>> _channel_handlers; //命名通道 -> 回调
     redisContext* _publish_context; //hiredis的上下文对象，负责publish
     redisContext* _subscribe_context;//hiredis的上下文对象，负责subscribe
     function<void(int, string)> _notify_message_handler; //回调操作，收到订阅的消息，给service层上报
@@ -6,6 +6,7 @@
 #include<chrono>
 #include<ctime>
 #include<unordered_map>
+#include<algorithm>
 using namespace std;
 using json = nlohmann::json;
 
@@ -28,10 +29,17 @@ User g_currentUser;
 vector<User> g_currentUserFriendList;
 //记录当前用户所在的群组列表信息
 vector<Group> g_currentUserGroupList;
+//好友列表和群组列表已同步到的版本号（每个分片一项，原样回传），同一用户再次登录时只拉取此后的变化
+json g_friendVersion = json::array();
+json g_groupVersion = json::array();
+//已接收但尚未解析完的数据：一次recv可能包含多条消息，也可能只有半条
+string g_recvBuffer;
 
 // 函数前向声明
 void showCurrentUserDate();
 void readTaskHandler(int clientfd);
+bool recvFrame(int clientfd, json &js);
+void handleServerMessage(json &js);
 string getCurrentTime();
 void mainMenu();
 void help(int clientfd, string str);
@@ -130,6 +138,12 @@ int main(int argc,char *argv[])
                 js["msgid"] = LOGIN_MSG;
                 js["id"] = id;
                 js["pwd"] = pwd;
+                if(id == g_currentUser.getId())
+                {
+                    //本地还保留着该用户的列表，只请求增量
+                    js["friendver"] = g_friendVersion;
+                    js["groupver"] = g_groupVersion;
+                }
                 string request = js.dump();
                 int len = send(g_clientfd,request.c_str(),request.size() + 1,0);
                 if(len == -1)
@@ -138,111 +152,45 @@ int main(int argc,char *argv[])
                 }
                 else
                 {
-                    //接收服务器返回的登录结果
-                    char buffer[1024] = {0};
-                    int len = recv(g_clientfd,buffer,1024,0);
-                    if(len == -1)
+                    //接收服务器返回的登录结果，登录响应之后可能紧跟着离线消息、好友和群组的推送
+                    json js;
+                    if(!recvFrame(g_clientfd, js))
                     {
                         cerr<<"recv login msg error"<<endl;
                     }
+                    else if(js["errno"].get<int>()!= 0)
+                    {
+                        cerr<<"login failed: "<<js["errmsg"]<<endl;
+                    }
                     else
                     {
-                        // Check if buffer is empty or contains valid data
-                        if (strlen(buffer) == 0) {
-                            cerr << "Received empty response from server" << endl;
-                            break;
+                        //换了用户登录时丢弃上一个用户的列表
+                        if(g_currentUser.getId() != id)
+                        {
+                            g_currentUserFriendList.clear();
+                            g_currentUserGroupList.clear();
+                            g_friendVersion = json::array();
+                            g_groupVersion = json::array();
                         }
-                        
-                        try {
-                            json js = json::parse(buffer);
-                            if(js["errno"].get<int>()!= 0)
-                            {
-                                cerr<<"login failed: "<<js["errmsg"]<<endl;
-                            }
-                            else
-                            {
-                                //记录当前用户的信息
-                                g_currentUser.setId(id);
-                                g_currentUser.setName(js["name"]);
-                                
-                                //记录当前用户的好友列表信息
-                                if(js.contains("friends"))
-                                {
-                                    //初始化
-                                    g_currentUserFriendList.clear();
-                                    vector<string> vec = js["friends"];
-                                    for(string &str:vec)
-                                    {
-                                        json js = json::parse(str);
-                                        User user(js["id"],js["name"],js["state"]);
-                                        g_currentUserFriendList.push_back(user);
-                                    }
-                                }
-                                //记录当前用户的群组列表信息
-                                if(js.contains("groups"))
-                                {
-                                    vector<string> vec1 = js["groups"];
-                                    for(string &groupstr:vec1)
-                                    {
-                                        json groupjs = json::parse(groupstr);
-                                        Group group(groupjs["id"],groupjs["groupname"],groupjs["groupdesc"]);
-                                        
-                                        vector<string> vec2 = groupjs["users"];
-                                        for(string &userstr:vec2)
-                                        {
-                                            json userjs = json::parse(userstr);
-                                            GroupUser groupUser;
-                                            groupUser.setId(userjs["id"].get<int>());
-                                            groupUser.setName(userjs["name"]);
-                                            groupUser.setRole(userjs["role"]);
-                                            group.getUsers().push_back(groupUser);
-                                        }
-                                        g_currentUserGroupList.push_back(group);
-                                    }
-                                }
-                                //显示当前用户的基本信息
-                                showCurrentUserDate();
+                        //记录当前用户的信息
+                        g_currentUser.setId(id);
+                        g_currentUser.setName(js["name"]);
+                        //显示当前用户的基本信息，好友和群组列表到达后再次显示
+                        showCurrentUserDate();
 
-                                //显示当前用户的离线消息，个人聊天信息或者群组信息
-                                if(js.contains("offlinemsg"))
-                                {
-                                    vector<string> vec = js["offlinemsg"];
-                                    for(string &str:vec)
-                                    {
-                                        json js = json::parse(str);
-                                        int msgtype = js["msgid"].get<int>();
-                                        if(ONE_CHAT_MSG == msgtype)
-                                        {
-                                            // 一对一聊天消息
-                                            cout << js["time"].get<string>() << "[" << js["id"].get<int>() << "]" << js["name"] << " say: " << js["msg"].get<string>() << endl;
-                                        }
-                                        else if(GROUP_CHAT_MSG == msgtype)
-                                        {
-                                            // 群聊消息
-                                            cout << "群消息["<<js["groupid"]<<"]:"<<js["time"].get<string>() << "[" << js["id"].get<int>() << "]" << js["name"] << " say: " << js["msg"].get<string>() << endl;
-                                        }
-                                    
-                                    }
-                                }
-                                static int threadnumber = 0;
-                                if(threadnumber == 0)
-                                {
-                                    //登陆成功，启动接受线程
-                                    thread readTask(readTaskHandler,g_clientfd);
-                                    readTask.detach();
-                                    threadnumber++;
-                                }
-                                
+                        static int threadnumber = 0;
+                        if(threadnumber == 0)
+                        {
+                            //登陆成功，启动接受线程
+                            thread readTask(readTaskHandler,g_clientfd);
+                            readTask.detach();
+                            threadnumber++;
+                        }
 
-                                isMainMenuRunning = true;
-                                mainMenu();//进入聊天主界面
-                             }
-                         } catch (const json::parse_error& e) {
-                             cerr << "JSON parse error: " << e.what() << endl;
-                             cerr << "Server response: " << buffer << endl;
-                         }
-                     }
-                 }
+                        isMainMenuRunning = true;
+                        mainMenu();//进入聊天主界面
+                    }
+                }
                  break;
              }
              case 2://register业务
@@ -342,37 +290,218 @@ string getCurrentTime()
     return timeStr;
 }
 
-// 接收线程
-void readTaskHandler(int clientfd)
+// 从g_recvBuffer中取出一条完整的json消息，数据不完整时返回false
+static bool takeFrame(json &js)
 {
-    while(isMainMenuRunning)
+    while(true)
+    {
+        //跳过消息之间的空白和结束符
+        size_t begin = g_recvBuffer.find('{');
+        if(begin == string::npos)
+        {
+            g_recvBuffer.clear();
+            return false;
+        }
+        int depth = 0;
+        bool inString = false;
+        bool escaped = false;
+        size_t end = string::npos;
+        for(size_t i = begin; i < g_recvBuffer.size(); i++)
+        {
+            char c = g_recvBuffer[i];
+            if(inString)
+            {
+                if(escaped) escaped = false;
+                else if(c == '\\') escaped = true;
+                else if(c == '"') inString = false;
+            }
+            else if(c == '"') inString = true;
+            else if(c == '{') depth++;
+            else if(c == '}' && --depth == 0)
+            {
+                end = i + 1;
+                break;
+            }
+        }
+        if(end == string::npos)
+        {
+            g_recvBuffer.erase(0, begin);
+            return false;
+        }
+        string frame = g_recvBuffer.substr(begin, end - begin);
+        g_recvBuffer.erase(0, end);
+        try {
+            js = json::parse(frame);
+            return true;
+        } catch (const json::parse_error& e) {
+            cerr << "JSON parse error: " << e.what() << endl;
+            cerr << "Server response: " << frame << endl;
+        }
+    }
+}
+
+// 接收一条完整的json消息，连接出错或关闭时返回false
+bool recvFrame(int clientfd, json &js)
+{
+    while(!takeFrame(js))
     {
         char buffer[1024] = {0};
         int len = recv(clientfd, buffer, 1024, 0);
         if(len == -1 || len == 0)
         {
-            cerr << "recv error or server closed" << endl;
-            close(clientfd);
-            exit(-1);
+            return false;
         }
+        g_recvBuffer.append(buffer, len);
+    }
+    return true;
+}
 
-        // 接收ChatServer转发的数据，反序列化生成json数据对象
-        json js = json::parse(buffer);
-        int msgtype = js["msgid"].get<int>();
-        if(ONE_CHAT_MSG == msgtype)
+// 处理服务器推送的消息
+void handleServerMessage(json &js)
+{
+    int msgtype = js["msgid"].get<int>();
+    if(ONE_CHAT_MSG == msgtype)
+    {
+        // 一对一聊天消息
+        cout << js["time"].get<string>() << "[" << js["id"].get<int>() << "]" << js["name"] << " say: " << js["msg"].get<string>() << endl;
+    }
+    else if(PRESENCE_MSG == msgtype)
+    {
+        //好友在线状态变化，一帧可能包含多个好友
+        for(json &change : js["changes"])
         {
-            // 一对一聊天消息
-            cout << js["time"].get<string>() << "[" << js["id"].get<int>() << "]" << js["name"] << " say: " << js["msg"].get<string>() << endl;
-            continue;
+            int id = change["id"].get<int>();
+            string state = change["state"];
+            for(User &user : g_currentUserFriendList)
+            {
+                if(user.getId() == id)
+                {
+                    user.setState(state);
+                    cout << "好友[" << id << "]" << user.getName() << " " << state << endl;
+                }
+            }
         }
-        else if(GROUP_CHAT_MSG == msgtype)
+    }
+    else if(ONE_CHAT_MSG_ACK == msgtype)
+    {
+        // 一对一聊天失败（例如对方用户不存在）
+        cerr << "chat failed: " << js["errmsg"].get<string>() << endl;
+    }
+    else if(GROUP_CHAT_MSG == msgtype)
+    {
+        // 群聊消息
+        cout << "群消息["<<js["groupid"]<<"]:"<<js["time"].get<string>() << "[" << js["id"].get<int>() << "]" << js["name"] << " say: " << js["msg"].get<string>() << endl;
+    }
+    else if(LOGIN_OFFLINE_MSG == msgtype)
+    {
+        //显示当前用户的离线消息，个人聊天信息或者群组信息
+        vector<string> vec = js["offlinemsg"];
+        for(string &str:vec)
         {
-            // 群聊消息
-            cout << "群消息["<<js["groupid"]<<"]:"<<js["time"].get<string>() << "[" << js["id"].get<int>() << "]" << js["name"] << " say: " << js["msg"].get<string>() << endl;
-            continue;
-            
+            json msgjs = json::parse(str);
+            handleServerMessage(msgjs);
+        }
+        //确认收到这一页，服务器随后删除这些消息并下发下一页
+        json ack;
+        ack["msgid"] = OFFLINE_MSG_ACK;
+        ack["id"] = g_currentUser.getId();
+        ack["cursor"] = js["cursor"];
+        string request = ack.dump();
+        if(send(g_clientfd, request.c_str(), request.size() + 1, 0) == -1)
+        {
+            cerr << "send offline msg ack error" << request << endl;
+        }
+    }
+    else if(LOGIN_FRIEND_LIST_MSG == msgtype)
+    {
+        //记录当前用户的好友列表信息：全量时整体替换，增量时按id合并新增好友并刷新其余好友的在线状态
+        bool delta = js.value("delta", false);
+        if(!delta)
+        {
+            g_currentUserFriendList.clear();
+        }
+        else
+        {
+            vector<int> online = js["online"];
+            for(User &user:g_currentUserFriendList)
+            {
+                bool isOnline = find(online.begin(), online.end(), user.getId()) != online.end();
+                user.setState(isOnline ? "online" : "offline");
+            }
+        }
+        vector<string> vec = js["friends"];
+        for(string &str:vec)
+        {
+            json userjs = json::parse(str);
+            User user(userjs["id"],userjs["name"],"",userjs["state"]);
+            auto it = find_if(g_currentUserFriendList.begin(), g_currentUserFriendList.end(),
+                              [&user](User &u) { return u.getId() == user.getId(); });
+            if(it != g_currentUserFriendList.end())
+            {
+                *it = user;
+            }
+            else
+            {
+                g_currentUserFriendList.push_back(user);
+            }
+        }
+        g_friendVersion = js.value("version", json::array());
+        showCurrentUserDate();
+    }
+    else if(LOGIN_GROUP_LIST_MSG == msgtype)
+    {
+        //记录当前用户的群组列表信息：全量时整体替换，增量时按id替换有变化的群组
+        if(!js.value("delta", false))
+        {
+            g_currentUserGroupList.clear();
+        }
+        vector<string> vec1 = js["groups"];
+        for(string &groupstr:vec1)
+        {
+            json groupjs = json::parse(groupstr);
+            Group group(groupjs["id"],groupjs["groupname"],groupjs["groupdesc"]);
+
+            vector<string> vec2 = groupjs["users"];
+            for(string &userstr:vec2)
+            {
+                json userjs = json::parse(userstr);
+                GroupUser groupUser;
+                groupUser.setId(userjs["id"].get<int>());
+                groupUser.setName(userjs["name"]);
+                groupUser.setState(userjs["state"]);
+                groupUser.setRole(userjs["role"]);
+                group.getUsers().push_back(groupUser);
+            }
+            auto it = find_if(g_currentUserGroupList.begin(), g_currentUserGroupList.end(),
+                              [&group](Group &g) { return g.getId() == group.getId(); });
+            if(it != g_currentUserGroupList.end())
+            {
+                *it = group;
+            }
+            else
+            {
+                g_currentUserGroupList.push_back(group);
+            }
         }
+        g_groupVersion = js.value("version", json::array());
+        showCurrentUserDate();
+    }
+}
 
+// 接收线程
+void readTaskHandler(int clientfd)
+{
+    while(isMainMenuRunning)
+    {
+        // 接收ChatServer转发的数据，反序列化生成json数据对象
+        json js;
+        if(!recvFrame(clientfd, js))
+        {
+            cerr << "recv error or server closed" << endl;
+            close(clientfd);
+            exit(-1);
+        }
+        handleServerMessage(js);
     }
 }
 
@@ -0,0 +1,96 @@
+#include "adminServer.hpp"
+#include <muduo/base/Logging.h>
+#include <algorithm>
+#include <cstring>
+using namespace std;
+using namespace placeholders;
+
+//请求头的上限，超过时直接断开
+static const size_t kMaxRequestBytes = 8192;
+
+AdminServer::AdminServer(EventLoop *loop, const InetAddress &listenAddr)
+    : _server(loop, listenAddr, "AdminServer")
+{
+    _server.setConnectionCallback(bind(&AdminServer::onConnection, this, _1));
+    _server.setMessageCallback(bind(&AdminServer::onMessage, this, _1, _2, _3));
+}
+
+void AdminServer::addPage(const string &path, const string &contentType, PageGenerator generator)
+{
+    _pages[path] = Page{contentType, std::move(generator)};
+}
+
+void AdminServer::start()
+{
+    _server.start();
+}
+
+void AdminServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (!conn->connected())
+    {
+        conn->shutdown();
+    }
+}
+
+void AdminServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time)
+{
+    static const char kHeaderEnd[] = "\r\n\r\n";
+    const char *begin = buf->peek();
+    const char *end = begin + buf->readableBytes();
+    const char *headerEnd = search(begin, end, kHeaderEnd, kHeaderEnd + 4);
+    if (headerEnd == end)
+    {
+        //请求头还没收全
+        if (buf->readableBytes() > kMaxRequestBytes)
+        {
+            buf->retrieve(buf->readableBytes());
+            conn->shutdown();
+        }
+        return;
+    }
+
+    //请求行：METHOD SP PATH SP VERSION，只关心方法和路径，查询参数忽略
+    string requestLine(begin, find(begin, headerEnd, '\r'));
+    buf->retrieve(buf->readableBytes());
+    size_t methodEnd = requestLine.find(' ');
+    size_t pathEnd = methodEnd == string::npos ? string::npos : requestLine.find(' ', methodEnd + 1);
+    if (pathEnd == string::npos)
+    {
+        reply(conn, "400 Bad Request", "text/plain", "bad request\n");
+        return;
+    }
+    string method = requestLine.substr(0, methodEnd);
+    string path = requestLine.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+    path = path.substr(0, path.find('?'));
+    if (method != "GET")
+    {
+        reply(conn, "405 Method Not Allowed", "text/plain", "only GET is supported\n");
+        return;
+    }
+    auto it = _pages.find(path);
+    if (it == _pages.end())
+    {
+        string index;
+        for (const auto &page : _pages)
+        {
+            index += page.first + "\n";
+        }
+        reply(conn, "404 Not Found", "text/plain", index);
+        return;
+    }
+    reply(conn, "200 OK", it->second.contentType, it->second.generator());
+}
+
+void AdminServer::reply(const TcpConnectionPtr &conn, const string &status,
+                        const string &contentType, const string &body)
+{
+    string response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + to_string(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    conn->send(response);
+    //send之后shutdown，muduo会在输出缓冲写完后才关闭写端
+    conn->shutdown();
+}
@@ -1,12 +1,39 @@
 #include "chatserver.hpp"
 #include "chatservice.hpp"
 #include "json.hpp"
+#include "common/Metrics.hpp"
+#include "common/Tracer.hpp"
+#include "common/FlightRecorder.hpp"
+#include <atomic>
 #include <functional>
 #include <string>
 using namespace std;
 using namespace placeholders;
 using json = nlohmann::json;
 
+//msgid取值很小，按下标缓存各消息类型的耗时直方图，只有第一次需要查注册表
+static const int kMaxCachedMsgid = 64;
+
+static HdrHistogram &handlerLatency(int msgid)
+{
+    static const char *kName = "chat_handler_latency_microseconds";
+    static const char *kHelp = "Time spent in the message handler on the IO thread, by msgid";
+    static atomic<HdrHistogram *> cache[kMaxCachedMsgid];
+    if (msgid < 0 || msgid >= kMaxCachedMsgid)
+    {
+        static HdrHistogram &other = MetricsRegistry::instance().histogram(kName, kHelp, MetricsRegistry::label("msgid", "other"));
+        return other;
+    }
+    HdrHistogram *histogram = cache[msgid].load(memory_order_acquire);
+    if (histogram == nullptr)
+    {
+        //并发首次访问时注册表返回同一个对象，重复写入无害
+        histogram = &MetricsRegistry::instance().histogram(kName, kHelp, MetricsRegistry::label("msgid", to_string(msgid)));
+        cache[msgid].store(histogram, memory_order_release);
+    }
+    return *histogram;
+}
+
 ChatServer::ChatServer(EventLoop *loop,  // Changed from ChatServerChatServer to ChatServer
     const InetAddress &listenAddr,
     const string &nameArg)
@@ -39,13 +66,24 @@ void ChatServer::onConnection(const TcpConnectionPtr& conn)
 void ChatServer::onMessage(const TcpConnectionPtr &conn, Buffer *buffer, Timestamp time) 
 {
 
+    //按采样率决定是否追踪本条消息，之后各阶段的TraceSpan记入同一个trace
+    TraceScope trace(Tracer::instance().sample());
     string buf = buffer->retrieveAllAsString();
-    json js = json::parse(buf); // 反序列化
+    FlightRecorder::record(FlightEvent::MSG_RECEIVED, static_cast<int64_t>(buf.size()));
+    json js;
+    {
+        TraceSpan span("json_parse", static_cast<int64_t>(buf.size()));
+        js = json::parse(buf); // 反序列化
+    }
     // 达到的目的：完全解耦网络模块的代码和业务模块的代码
     // 通过js["msgid"]获取=》业务handler=》conn js time
-    auto msgHandler = ChatService::instance()->getHandler(js["msgid"].get<int>());
-    //回调消息绑定好的事件处理器，来执行相应的业务处理
+    int msgid = js["msgid"].get<int>();
+    auto msgHandler = ChatService::instance()->getHandler(msgid);
+    //回调消息绑定好的事件处理器，来执行相应的业务处理；只统计IO线程上的耗时，投递到DB线程的部分不计入
+    ScopedLatency latency(handlerLatency(msgid));
+    TraceSpan span("handler", msgid);
     msgHandler(conn, js, time);
+    FlightRecorder::record(FlightEvent::MSG_DISPATCHED, msgid);
     
 
 }
\ No newline at end of file
@@ -6,14 +6,45 @@
 #include<vector>
 #include<mutex>
 #include<map>
+#include<chrono>
+#include<algorithm>
+#include<unistd.h>
 #include "muduo/base/Logging.h"
 using namespace std;
 using namespace muduo;
 using namespace muduo::net;
 
 #include"UserModel.hpp"
+#include "BatchInsertWriter.h"
+#include "DbExecutor.h"
+#include "socialGraph.hpp"
+#include "userFilter.hpp"
+#include "common/Logger.hpp"
+#include "common/Metrics.hpp"
+#include "common/Tracer.hpp"
+#include "common/FlightRecorder.hpp"
 
 
+//关系变化通知的redis通道，消息格式为 "节点标识:类型:a:b"
+//类型g表示用户b加入群组a，类型f表示用户a添加好友b，类型u表示用户a的状态变化（b为1上线、0下线）
+static const string kRelationChangeChannel = "relation_change";
+
+//经redis转发的聊天消息中携带trace id的字段，只在发送方节点采样时出现
+static const char *kTraceIdField = "traceid";
+
+//转发给其他节点的消息：当前消息被采样时带上trace id，否则原样使用plain（js序列化后的内容）
+static string remotePayload(const json &js, const string &plain)
+{
+    uint64_t traceId = Tracer::current();
+    if (traceId == 0)
+    {
+        return plain;
+    }
+    json traced = js;
+    traced[kTraceIdField] = Tracer::idToString(traceId);
+    return traced.dump();
+}
+
 //获取单例对象的接口函数
 ChatService* ChatService::instance()
 {
@@ -32,89 +63,360 @@ ChatService::ChatService()
     _msgHandlerMap.insert({ADD_GROUP_MSG, std::bind(&ChatService::addGroup, this, _1, _2, _3)});
     _msgHandlerMap.insert({GROUP_CHAT_MSG, std::bind(&ChatService::groupChat, this, _1, _2, _3)});
     _msgHandlerMap.insert({LOGINOUT_MSG, std::bind(&ChatService::loginout, this, _1, _2, _3)});
+    _msgHandlerMap.insert({OFFLINE_MSG_ACK, std::bind(&ChatService::offlineMsgAck, this, _1, _2, _3)});
 
+    _nodeId = to_string(getpid()) + "@" + to_string(chrono::system_clock::now().time_since_epoch().count());
     if(_redis.connect())
     {
         //设置上报消息的回调对象
         _redis.init_notify_handler(std::bind(&ChatService::handleRedisSubscribeMessage, this, _1, _2));
+        //订阅关系变化通知，其他节点加群、加好友后同步本节点的缓存和关系图
+        _redis.subscribe(kRelationChangeChannel, std::bind(&ChatService::handleRelationChange, this, _1));
     }
 }
 
 
+//客户端带来的版本号：每个分片一项，字段缺失或格式不对时为空，按全量同步处理
+static vector<long long> parseVersion(const json &js, const char *key)
+{
+    vector<long long> version;
+    auto it = js.find(key);
+    if (it == js.end() || !it->is_array())
+    {
+        return version;
+    }
+    for (const json &item : *it)
+    {
+        if (!item.is_number_integer())
+        {
+            return vector<long long>();
+        }
+        version.push_back(item.get<long long>());
+    }
+    return version;
+}
+
 //处理登录业务
 void ChatService::login(const TcpConnectionPtr &conn, json &js, Timestamp time)
 {
     int id = js["id"].get<int>();
     string pwd = js["pwd"];
-    auto result = _userModel.query(id);
-    User user = result.first;
-    ErrorCode error = result.second;
-    if (error == ErrorCode::SUCCESS && user.getId() != -1 && user.getPwd() == pwd)
-    {
-        if(user.getState() == "online")
-        {   //该用户已经登录，不允许重复登录
-            json response;
-            response["msgid"] = LOGIN_MSG_ACK;
-            response["errno"] = 2;
-            response["errmsg"] = "该账号已经登陆，请重新输入新账号";
-            conn->send(response.dump());
-        }
-        //登陆成功,记录用户连接信息
-        {
-            lock_guard<mutex> lock(_connMutex); //加锁保证线程安全
-            _userConnMap.insert({id, conn});
-        }
-        //id用户登录成功后，向redis订阅channel(id)
-        _redis.subscribe(id);
-
-        user.setState("online");
-        //更新用户状态信息
-        _userModel.updateState(user);
+    //客户端上次同步到的好友/群组列表版本号，旧客户端不带此字段时全量同步
+    vector<long long> friendVersion = parseVersion(js, "friendver");
+    vector<long long> groupVersion = parseVersion(js, "groupver");
+    //查询在DB线程中执行，结果回调在conn所在的IO线程中执行，IO线程不等待MySQL
+    DbExecutor::getInstance()->post(conn->getLoop(),
+        [this, id]() { return _userModel.query(id); },
+        [this, conn, id, pwd, friendVersion, groupVersion](DbStatus status, pair<User, ErrorCode> result) {
+            if (status != DbStatus::OK)
+            {
+                json response;
+                response["msgid"] = LOGIN_MSG_ACK;
+                response["errno"] = 3;
+                response["errmsg"] = "服务器繁忙，请稍后重试";
+                conn->send(response.dump());
+                return;
+            }
+            loginVerified(conn, id, pwd, friendVersion, groupVersion, result.first, result.second);
+        });
+}
 
+//登录校验结果已返回，在conn所在的IO线程中执行
+void ChatService::loginVerified(const TcpConnectionPtr &conn, int id, const string &pwd, const vector<long long> &friendVersion,
+                                const vector<long long> &groupVersion, User user, ErrorCode error)
+{
+    if (error != ErrorCode::SUCCESS || user.getId() == -1 || user.getPwd() != pwd)
+    {
+        //该用户不存在，登录失败
         json response;
         response["msgid"] = LOGIN_MSG_ACK;
-        response["errno"] = 0;
-        response["id"] = user.getId();
-        response["name"] = user.getName();
-        //查询该用户是否有离线消息
-        vector<string> vec = _offlineMsgModel.query(id);
-        if (!vec.empty())
-        {
-            response["offlinemsg"] = vec;
-            //读取该用户的离线消息后，把该用户的所有离线消息删除掉
-            _offlineMsgModel.remove(id);
-        }
-        //查询该用户的好友信息并返回
-        vector<User> userVec = _friendModel.query(id);
-        if (!userVec.empty())
-        {
+        response["errno"] = 1;
+        response["errmsg"] = "用户名或密码错误";
+        conn->send(response.dump());
+        return;
+    }
+    if (user.getState() == "online")
+    {   //该用户已经登录，不允许重复登录
+        json response;
+        response["msgid"] = LOGIN_MSG_ACK;
+        response["errno"] = 2;
+        response["errmsg"] = "该账号已经登陆，请重新输入新账号";
+        conn->send(response.dump());
+        return;
+    }
+    if (!conn->connected())
+    {
+        //查询期间客户端已断开
+        return;
+    }
+    //登陆成功,记录用户连接信息
+    {
+        lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex)); //加锁保证线程安全
+        _userConnMap.insert({id, conn});
+    }
+    //id用户登录成功后，向redis订阅channel(id)
+    _redis.subscribe(id);
+
+    user.setState("online");
+    //更新用户状态信息，通知在线的好友，并让其他节点缓存的该用户记录失效
+    _userModel.updateState(user);
+    presenceChanged(id, true);
+
+    //认证通过后立即回复，离线消息、好友和群组随后分别推送
+    json response;
+    response["msgid"] = LOGIN_MSG_ACK;
+    response["errno"] = 0;
+    response["id"] = user.getId();
+    response["name"] = user.getName();
+    conn->send(response.dump());
+
+    //三项查询互不依赖，同时投递到DB线程并行执行，各自完成后推送，互不等待
+    //离线消息分页下发，客户端确认一页后再发下一页
+    sendOfflinePage(conn, id, 0);
+    sendFriendList(conn, id, friendVersion);
+    sendGroupList(conn, id, groupVersion);
+}
+
+//好友列表同步结果
+struct FriendListSync
+{
+    bool delta = false;
+    vector<long long> version; //为空时客户端下次登录全量同步
+    vector<User> users; //全量时为全部好友，增量时为新增的好友
+    vector<int> online; //增量时其余好友中在线的id
+};
+
+void ChatService::sendFriendList(const TcpConnectionPtr &conn, int userid, const vector<long long> &version)
+{
+    DbExecutor::getInstance()->post(conn->getLoop(),
+        [this, userid, version]() {
+            FriendListSync sync;
+            //水位在查询之前读取，查询期间提交的变化留到下次同步
+            RelationWatermark mark;
+            bool marked = _relationLogModel.queryWatermark(mark);
+            SocialGraph *graph = SocialGraph::instance();
+            bool complete = false;
+            vector<int> added;
+            if (marked && RelationLogModel::covers(mark, version) && graph->isLoaded()
+                && _relationLogModel.queryFriendsSince(userid, version, mark.version, added))
+            {
+                //增量：新增好友直接按变更日志中的id加载完整信息（本节点可能漏收了对应的变更通知，关系图中未必有这条边），
+                //其余好友只给出在线的id；用户记录大多来自缓存
+                sort(added.begin(), added.end());
+                added.erase(unique(added.begin(), added.end()), added.end());
+                sync.users = _userModel.queryByIds(added, &complete);
+                vector<int> others;
+                for (int id : graph->friends().neighbors(userid))
+                {
+                    if (!binary_search(added.begin(), added.end(), id))
+                    {
+                        others.push_back(id);
+                    }
+                }
+                bool othersComplete = false;
+                vector<User> otherUsers = _userModel.queryByIds(others, &othersComplete);
+                if (complete && othersComplete)
+                {
+                    sync.delta = true;
+                    sync.version = mark.version;
+                    for (User &user : otherUsers)
+                    {
+                        if (user.getState() == "online")
+                        {
+                            sync.online.push_back(user.getId());
+                        }
+                    }
+                    return sync;
+                }
+                //有分片查询失败，增量结果会漏掉好友，改为全量
+            }
+            if (graph->isLoaded())
+            {
+                //好友id来自内存中的关系图，只需一次批量查询好友的名字和状态
+                sync.users = _userModel.queryByIds(graph->friends().neighbors(userid), &complete);
+            }
+            else
+            {
+                sync.users = _friendModel.query(userid, &complete);
+            }
+            //全量结果不完整或水位读取失败时不下发版本号，客户端下次登录时重新全量同步
+            if (complete && marked)
+            {
+                sync.version = mark.version;
+            }
+            return sync;
+        },
+        [conn](DbStatus status, FriendListSync sync) {
+            if (status != DbStatus::OK)
+            {
+                return;
+            }
             vector<string> friendVec;
-            for (User &user : userVec)
+            for (User &user : sync.users)
             {
                 json js;
                 js["id"] = user.getId();
                 js["name"] = user.getName();
                 js["state"] = user.getState();
-                friendVec.push_back(js.dump());  
+                friendVec.push_back(js.dump());
             }
-        }
-        conn->send(response.dump());        
-    }
-    else
-    {
-        //该用户不存在，登录失败
-        json response;
-        response["msgid"] = LOGIN_MSG_ACK;
-        response["errno"] = 1;
-        response["errmsg"] = "用户名或密码错误";
-        
+            json js;
+            js["msgid"] = LOGIN_FRIEND_LIST_MSG;
+            js["version"] = sync.version;
+            js["delta"] = sync.delta;
+            js["friends"] = friendVec;
+            if (sync.delta)
+            {
+                js["online"] = sync.online;
+            }
+            conn->send(js.dump());
+        });
+}
 
-        conn->send(response.dump());
-    }
+//群组列表同步结果
+struct GroupListSync
+{
+    bool delta = false;
+    vector<long long> version; //为空时客户端下次登录全量同步
+    vector<Group> groups; //全量时为全部群组，增量时为新加入和成员有变化的群组
+};
+
+void ChatService::sendGroupList(const TcpConnectionPtr &conn, int userid, const vector<long long> &version)
+{
+    DbExecutor::getInstance()->post(conn->getLoop(),
+        [this, userid, version]() {
+            GroupListSync sync;
+            //群成员日志随群组分布在各分片，版本号逐分片比较
+            RelationWatermark mark;
+            bool marked = _relationLogModel.queryWatermark(mark);
+            SocialGraph *graph = SocialGraph::instance();
+            if (marked && RelationLogModel::covers(mark, version) && graph->isLoaded())
+            {
+                vector<int> changed;
+                if (_relationLogModel.queryGroupsSince(userid, version, mark.version, changed)
+                    && _relationLogModel.queryChangedGroups(graph->userGroups().neighbors(userid), version, mark.version, changed))
+                {
+                    sort(changed.begin(), changed.end());
+                    changed.erase(unique(changed.begin(), changed.end()), changed.end());
+                    bool complete = false;
+                    sync.groups = _groupModel.queryGroupsByIds(changed, &complete);
+                    if (complete)
+                    {
+                        sync.delta = true;
+                        sync.version = mark.version;
+                        return sync;
+                    }
+                    //有分片查询失败，增量结果会漏掉群组或成员，改为全量
+                }
+            }
+            bool complete = false;
+            sync.groups = _groupModel.queryGroups(userid, &complete);
+            //全量结果不完整或水位读取失败时不下发版本号，客户端下次登录时重新全量同步
+            if (complete && marked)
+            {
+                sync.version = mark.version;
+            }
+            return sync;
+        },
+        [conn](DbStatus status, GroupListSync sync) {
+            if (status != DbStatus::OK)
+            {
+                return;
+            }
+            vector<string> groupStrVec;
+            for (Group &group : sync.groups)
+            {
+                json groupjs;
+                groupjs["id"] = group.getId();
+                groupjs["groupname"] = group.getName();
+                groupjs["groupdesc"] = group.getDesc();
+                vector<string> userVec;
+                for (GroupUser &user : group.getUsers())
+                {
+                    json userjs;
+                    userjs["id"] = user.getId();
+                    userjs["name"] = user.getName();
+                    userjs["state"] = user.getState();
+                    userjs["role"] = user.getRole();
+                    userVec.push_back(userjs.dump());
+                }
+                groupjs["users"] = userVec;
+                groupStrVec.push_back(groupjs.dump());
+            }
+            json js;
+            js["msgid"] = LOGIN_GROUP_LIST_MSG;
+            js["version"] = sync.version;
+            js["delta"] = sync.delta;
+            js["groups"] = groupStrVec;
+            conn->send(js.dump());
+        });
+}
+//查询并下发一页id大于afterId的离线消息，记录待确认的行
+void ChatService::sendOfflinePage(const TcpConnectionPtr &conn, int userid, int afterId)
+{
+    DbExecutor::getInstance()->post(conn->getLoop(),
+        [this, userid, afterId]() { return _offlineMsgModel.queryPage(userid, afterId, kOfflinePageSize); },
+        [this, conn, userid](DbStatus status, vector<OfflineMsg> page) {
+            if (status != DbStatus::OK || page.empty() || !conn->connected())
+            {
+                //没有更多消息或查询失败，未下发的消息留在表中等下次登录
+                lock_guard<mutex> lock(_drainMutex);
+                _offlineDrainMap.erase(userid);
+                return;
+            }
+            OfflineDrain drain;
+            drain.conn = conn;
+            drain.cursor = page.back().id;
+            drain.more = page.size() == static_cast<size_t>(kOfflinePageSize);
+            vector<string> vec;
+            vec.reserve(page.size());
+            for (OfflineMsg &msg : page)
+            {
+                drain.ids.push_back(msg.id);
+                vec.push_back(std::move(msg.message));
+            }
 
-    
+            json js;
+            js["msgid"] = LOGIN_OFFLINE_MSG;
+            js["offlinemsg"] = vec;
+            js["cursor"] = drain.cursor;
+            js["more"] = drain.more;
+            {
+                lock_guard<mutex> lock(_drainMutex);
+                _offlineDrainMap[userid] = std::move(drain);
+            }
+            conn->send(js.dump());
+        });
+}
 
+//客户端确认收到一页离线消息：删除这一页，还有剩余时下发下一页
+void ChatService::offlineMsgAck(const TcpConnectionPtr &conn, json &js, Timestamp time)
+{
+    int userid = js["id"].get<int>();
+    int cursor = js["cursor"].get<int>();
+    OfflineDrain drain;
+    {
+        lock_guard<mutex> lock(_drainMutex);
+        auto it = _offlineDrainMap.find(userid);
+        //只接受本连接对当前这一页的确认，重复或过期的确认直接忽略
+        if (it == _offlineDrainMap.end() || it->second.conn != conn || it->second.cursor != cursor)
+        {
+            return;
+        }
+        drain = std::move(it->second);
+        _offlineDrainMap.erase(it);
+    }
+    DbExecutor::getInstance()->post(conn->getLoop(),
+        [this, userid, ids = std::move(drain.ids)]() { return _offlineMsgModel.remove(userid, ids); },
+        [this, conn, userid, cursor, more = drain.more](DbStatus status, bool removed) {
+            //删除失败的行会在下次登录时重新下发，客户端可能收到重复消息，但不会丢失
+            if (more && conn->connected())
+            {
+                sendOfflinePage(conn, userid, cursor);
+            }
+        });
 }
+
 //处理注册业务
 void ChatService::reg(const TcpConnectionPtr &conn, json &js, Timestamp time)
 {
@@ -132,6 +434,8 @@ void ChatService::reg(const TcpConnectionPtr &conn, json &js, Timestamp time)
         response["errno"] = 0;
         response["id"] = user.getId();
         conn->send(response.dump());
+        //本节点的过滤器已在insert中更新，通知其他节点
+        publishRelationChange('r', user.getId(), user.getName());
     }
     else
     {
@@ -153,7 +457,7 @@ MsgHandler ChatService::getHandler(int msgid)
     {
         //返回一个默认的处理器，空操作
         return [=](const TcpConnectionPtr &conn, json &js, Timestamp time){
-            LOG_ERROR << "msgid: " << msgid << " can not find handler!";
+            CHAT_LOG_ERROR_F("msgid: %d can not find handler!", msgid);
         };
     }
     else
@@ -167,7 +471,7 @@ void ChatService::regAck(const TcpConnectionPtr &conn, json &js, Timestamp time)
     // 处理注册响应的逻辑
     // 这里可以根据需要添加具体的处理逻辑
     // 例如，可以记录日志或者执行其他操作
-    LOG_INFO << "Handling registration acknowledgment message";
+    CHAT_LOG_INFO("Handling registration acknowledgment message");
 }
 
 //处理客户端异常退出
@@ -175,7 +479,7 @@ void ChatService::clientCloseException(const TcpConnectionPtr &conn)
 {
     User user;
     {
-        lock_guard<mutex> lock(_connMutex);
+        lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex));
         for (auto it = _userConnMap.begin(); it != _userConnMap.end(); it++)
         {
             if (it->second == conn)
@@ -187,6 +491,11 @@ void ChatService::clientCloseException(const TcpConnectionPtr &conn)
             }
         }
     }
+    //未确认的离线消息留在表中，下次登录重新下发
+    {
+        lock_guard<mutex> lock(_drainMutex);
+        _offlineDrainMap.erase(user.getId());
+    }
     //用户注销，相当于就是下线，在redis中取消订阅通道
     _redis.unsubscribe(user.getId());
     //更新用户的状态信息
@@ -194,46 +503,117 @@ void ChatService::clientCloseException(const TcpConnectionPtr &conn)
     {
         user.setState("offline");
         _userModel.updateState(user);
+        _presenceNotifier.cancel(user.getId());
+        presenceChanged(user.getId(), false);
     }
 }
 //一对一聊天业务
 void ChatService::oneChat(const TcpConnectionPtr &conn, json &js, Timestamp time)
 {
     int toid = js["toid"].get<int>();
+    auto rejectUnknownUser = [&conn]() {
+        json response;
+        response["msgid"] = ONE_CHAT_MSG_ACK;
+        response["errno"] = 1;
+        response["errmsg"] = "用户不存在";
+        conn->send(response.dump());
+    };
+    //过滤器判断toid一定不存在时直接拒绝，不访问数据库，也不写入无人接收的离线消息
+    if (!UserFilter::instance()->mightExist(toid))
+    {
+        rejectUnknownUser();
+        return;
+    }
     {
-        lock_guard<mutex> lock(_connMutex);
+        unique_lock<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex), defer_lock);
+        {
+            TraceSpan span("conn_mutex_wait");
+            lock.lock();
+        }
         auto it = _userConnMap.find(toid);
         if (it != _userConnMap.end())
         {
             //toid在线，转发消息 服务器主动推送消息给toid用户
-            it->second->send(js.dump());
+            TraceSpan span("send_local", toid);
+            string payload = js.dump();
+            it->second->send(payload);
+            FlightRecorder::record(FlightEvent::MSG_SENT, toid, static_cast<int64_t>(payload.size()));
             return;
 
         }
     }
     //查询toid是否在线
-    auto result = _userModel.query(toid);
+    pair<User, ErrorCode> result;
+    {
+        TraceSpan span("user_query", toid);
+        result = _userModel.query(toid);
+    }
     User user = result.first;
     ErrorCode error = result.second;
+    if (error == ErrorCode::USER_NOT_FOUND)
+    {
+        //过滤器可信范围之外的id，查库确认不存在
+        rejectUnknownUser();
+        return;
+    }
     if (error == ErrorCode::SUCCESS && user.getState() == "online")
     {
-        _redis.publish(toid, js.dump());
+        TraceSpan span("redis_publish", toid);
+        _redis.publish(toid, remotePayload(js, js.dump()));
         return;
     }
     //toid不在线，存储离线消息
+    TraceSpan span("offline_insert", toid);
     _offlineMsgModel.insert(toid, js.dump());
 }
-void ChatService::reset()
+void ChatService::startup()
 {
-    //把online状态的用户，设置成offline
+    //本节点上次异常退出时未能下线的用户仍为online，开始服务前同步清理；其他节点上的在线用户不受影响
     _userModel.resetState();
+    //加载好友和群成员关系图，失败时相关查询回落到数据库
+    SocialGraph::instance()->load();
+    //加载用户存在性过滤器，失败时所有查询照常访问数据库
+    UserModel::loadExistenceFilter();
+}
+void ChatService::reset()
+{
+    //本机的连接即将全部断开，不再推送在线状态
+    _presenceNotifier.shutdown();
+    //本机连接上的用户全部下线，与其他状态变更一起经回写队列批量写入，并通知其他节点
+    {
+        lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex));
+        for (auto &entry : _userConnMap)
+        {
+            _userModel.updateState(User(entry.first, "", "", "offline"));
+            publishRelationChange('u', entry.first, 0);
+        }
+        _userConnMap.clear();
+    }
+    //等待队列中的状态以及批量写入器中的离线消息、好友和群成员全部落库
+    _userModel.flushState();
+    BatchInsertWriter::getInstance()->flush();
 }
 void ChatService::addFriend(const TcpConnectionPtr &conn, json &js, Timestamp time)
 {
     int userid = js["id"].get<int>();
     int friendid = js["friendid"].get<int>();
-    //存储好友信息
-    _friendModel.insert(userid, friendid);
+    //已是好友时插入会因主键冲突失败，此时关系图中原有的边不能撤销
+    bool added = SocialGraph::instance()->addFriend(userid, friendid);
+    //存储好友信息，落库后回到本连接的IO线程再通知其他节点，不占用线程等待写入
+    EventLoop *loop = conn->getLoop();
+    _friendModel.insert(userid, friendid, [this, loop, userid, friendid, added](bool inserted) {
+        loop->queueInLoop([this, userid, friendid, added, inserted]() {
+            if (inserted)
+            {
+                publishRelationChange('f', userid, friendid);
+            }
+            else if (added)
+            {
+                //写入失败，撤销本次加入关系图的新边
+                SocialGraph::instance()->removeFriend(userid, friendid);
+            }
+        });
+    });
 }
 
 //创建群组
@@ -246,8 +626,24 @@ void ChatService::createGroup(const TcpConnectionPtr &conn, json &js, Timestamp
     Group group(-1, name, desc);
     if (_groupModel.createGroup(group))
     {
-        //存储群组创建人信息
-        _groupModel.addGroup(userid, group.getId(), "creator");
+        int groupid = group.getId();
+        //新群只有创建人一个成员，直接写入缓存和关系图
+        _groupMemberCache.put(groupid, {userid}, _groupMemberCache.version(groupid));
+        SocialGraph::instance()->addGroupMember(groupid, userid);
+        //存储群组创建人信息，落库后同加入群组一样通知其他节点，它们的关系图中才有创建人
+        EventLoop *loop = conn->getLoop();
+        _groupModel.addGroup(userid, groupid, "creator", [this, loop, groupid, userid](bool inserted) {
+            loop->queueInLoop([this, groupid, userid, inserted]() {
+                if (!inserted)
+                {
+                    //写入失败，撤销本节点缓存和关系图中的创建人
+                    _groupMemberCache.invalidate(groupid);
+                    SocialGraph::instance()->removeGroupMember(groupid, userid);
+                    return;
+                }
+                publishRelationChange('g', groupid, userid);
+            });
+        });
     }
     //返回创建成功的群组信息
 }
@@ -257,48 +653,245 @@ void ChatService::addGroup(const TcpConnectionPtr &conn, json &js, Timestamp tim
 {
     int userid = js["id"].get<int>();
     int groupid = js["groupid"].get<int>();
-    _groupModel.addGroup(userid, groupid, "normal");
+    //本节点的缓存和关系图原地加入新成员
+    _groupMemberCache.addMember(groupid, userid);
+    //已在群中时插入会因主键冲突失败，此时关系图中原有的边不能撤销
+    bool added = SocialGraph::instance()->addGroupMember(groupid, userid);
+    //成员关系落库后回到本连接的IO线程再通知其他节点，避免它们在写入之前重新加载到旧的成员列表
+    EventLoop *loop = conn->getLoop();
+    _groupModel.addGroup(userid, groupid, "normal", [this, loop, groupid, userid, added](bool inserted) {
+        loop->queueInLoop([this, groupid, userid, added, inserted]() {
+            //关系图未加载时，落库前的群聊可能已从数据库读到不含新成员的列表并写入缓存，
+            //本节点收不到自己发出的通知，这里丢弃该条目（失败时同样丢弃）
+            _groupMemberCache.invalidate(groupid);
+            if (!inserted)
+            {
+                if (added)
+                {
+                    //写入失败，撤销本次加入关系图的新成员
+                    SocialGraph::instance()->removeGroupMember(groupid, userid);
+                }
+                return;
+            }
+            publishRelationChange('g', groupid, userid);
+        });
+    });
+}
+
+//查询群成员
+GroupMemberCache::Members ChatService::groupMembers(int groupid)
+{
+    GroupMemberCache::Members members = _groupMemberCache.get(groupid);
+    if (members != nullptr)
+    {
+        return members;
+    }
+    //加载前取版本号，加载期间有成员变更时不写入缓存
+    unsigned long long version = _groupMemberCache.version(groupid);
+    vector<int> ids;
+    if (SocialGraph::instance()->isLoaded())
+    {
+        //关系图已常驻内存，无需访问数据库
+        ids = SocialGraph::instance()->groupUsers().neighbors(groupid);
+    }
+    else if (!_groupModel.queryGroupMemberIds(groupid, ids))
+    {
+        return nullptr;
+    }
+    _groupMemberCache.put(groupid, ids, version);
+    return make_shared<const vector<int>>(std::move(ids));
+}
+
+//通知其他节点关系发生了变化
+void ChatService::publishRelationChange(char type, int a, int b)
+{
+    publishRelationChange(type, a, to_string(b));
+}
+
+void ChatService::publishRelationChange(char type, int a, const string &b)
+{
+    _redis.publish(kRelationChangeChannel, _nodeId + ":" + type + ":" + to_string(a) + ":" + b);
+}
+
+//用户在本节点上线或下线：通知本节点上的好友，并广播给其他节点
+void ChatService::presenceChanged(int userid, bool online)
+{
+    fanOutPresence(userid, online);
+    publishRelationChange('u', userid, online ? 1 : 0);
+}
+
+//把userid的状态变化推送给本节点上在线的、把userid加为好友的用户，不在线的直接跳过
+void ChatService::fanOutPresence(int userid, bool online)
+{
+    SocialGraph *graph = SocialGraph::instance();
+    if (!graph->isLoaded())
+    {
+        return;
+    }
+    string state = online ? "online" : "offline";
+    vector<int> recipients = graph->friendOf().neighbors(userid);
+    static HdrHistogram &fanout = MetricsRegistry::instance().histogram(
+        "chat_fanout_size", "Recipients per fan-out", MetricsRegistry::label("kind", "presence"));
+    fanout.record(recipients.size());
+    lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex));
+    for (int recipient : recipients)
+    {
+        auto it = _userConnMap.find(recipient);
+        if (it != _userConnMap.end())
+        {
+            _presenceNotifier.notify(recipient, it->second, userid, state);
+        }
+    }
+}
+
+//处理其他节点发来的关系变化通知，在redis订阅线程中执行
+void ChatService::handleRelationChange(string msg)
+{
+    //节点标识中不含':'
+    size_t pos = msg.find(':');
+    if (pos == string::npos || msg.compare(0, pos, _nodeId) == 0)
+    {
+        //本节点发出的通知，缓存和关系图已原地更新
+        return;
+    }
+    char type = 0;
+    int a = 0;
+    int b = 0;
+    int offset = 0;
+    if (sscanf(msg.c_str() + pos + 1, "%c:%d:%n", &type, &a, &offset) != 2 || offset == 0)
+    {
+        CHAT_LOG_ERROR_F("Invalid relation change message: %s", msg.c_str());
+        return;
+    }
+    //'r'的第二个参数是用户名，可能包含':'，取剩余全部内容
+    string rest = msg.substr(pos + 1 + offset);
+    if (type == 'r')
+    {
+        UserFilter::instance()->addUser(a, rest);
+        return;
+    }
+    if (sscanf(rest.c_str(), "%d", &b) != 1)
+    {
+        CHAT_LOG_ERROR_F("Invalid relation change message: %s", msg.c_str());
+        return;
+    }
+    if (type == 'g')
+    {
+        _groupMemberCache.invalidate(a);
+        SocialGraph::instance()->addGroupMember(a, b);
+    }
+    else if (type == 'f')
+    {
+        SocialGraph::instance()->addFriend(a, b);
+    }
+    else if (type == 'u')
+    {
+        //发出通知时对方的状态可能还在回写队列中，不能失效后重新读库，直接采用通知中的新状态
+        UserModel::applyRemoteState(a, b != 0 ? "online" : "offline");
+        fanOutPresence(a, b != 0);
+    }
 }
+
 //群组聊天业务
 void ChatService::groupChat(const TcpConnectionPtr &conn, json &js, Timestamp time)
 {
     int userid = js["id"].get<int>();
     int groupid = js["groupid"].get<int>();
-    vector<int> useridVec = _groupModel.queryGroupUsers(userid, groupid); 
-    for (int id : useridVec)
+    //群成员来自缓存，只有缓存未命中时才查询数据库
+    GroupMemberCache::Members members;
     {
-        lock_guard<mutex> lock(_connMutex);
-        auto it = _userConnMap.find(id);
-        if (it!= _userConnMap.end())
+        TraceSpan span("group_members", groupid);
+        members = groupMembers(groupid);
+    }
+    if (members == nullptr)
+    {
+        CHAT_LOG_ERROR_F("Failed to load members of group %d", groupid);
+        return;
+    }
+    static HdrHistogram &fanout = MetricsRegistry::instance().histogram(
+        "chat_fanout_size", "Recipients per fan-out", MetricsRegistry::label("kind", "group"));
+    fanout.record(members->size());
+    string msg = js.dump();
+
+    //本机在线的成员直接转发，其余成员留待后续处理
+    vector<int> remoteVec;
+    {
+        unique_lock<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex), defer_lock);
         {
-            //toid在线，转发消息 服务器主动推送消息给toid用户
-            it->second->send(js.dump());
-            return;
+            TraceSpan span("conn_mutex_wait");
+            lock.lock();
         }
-        else
+        TraceSpan span("send_local", static_cast<int64_t>(members->size()));
+        for (int id : *members)
         {
-            //查询toid是否在线
-            auto result = _userModel.query(id);
-            if (result.second == ErrorCode::SUCCESS && result.first.getState() == "online")
+            if (id == userid)
+            {
+                continue;
+            }
+            auto it = _userConnMap.find(id);
+            if (it != _userConnMap.end())
             {
-                _redis.publish(id, js.dump());
+                //toid在线，转发消息 服务器主动推送消息给toid用户
+                it->second->send(msg);
+                FlightRecorder::record(FlightEvent::MSG_SENT, id, static_cast<int64_t>(msg.size()));
             }
             else
             {
-                //存储离线群消息
-                _offlineMsgModel.insert(id, js.dump());
+                remoteVec.push_back(id);
             }
-            
         }
     }
+    if (remoteVec.empty())
+    {
+        return;
+    }
 
+    //一次查询所有不在本机的成员状态，在其他服务器上在线的经redis转发
+    vector<int> offlineVec;
+    vector<User> users;
+    {
+        TraceSpan span("user_query", static_cast<int64_t>(remoteVec.size()));
+        users = _userModel.queryByIds(remoteVec);
+    }
+    string remoteMsg = remotePayload(js, msg);
+    vector<int> foundVec;
+    foundVec.reserve(users.size());
+    for (User &user : users)
+    {
+        foundVec.push_back(user.getId());
+        if (user.getState() == "online")
+        {
+            TraceSpan span("redis_publish", user.getId());
+            _redis.publish(user.getId(), remoteMsg);
+        }
+        else
+        {
+            offlineVec.push_back(user.getId());
+        }
+    }
+    //所在分片查询失败等原因没有查到的成员，状态未知，按离线保存，不能丢弃消息
+    sort(foundVec.begin(), foundVec.end());
+    for (int id : remoteVec)
+    {
+        if (!binary_search(foundVec.begin(), foundVec.end(), id))
+        {
+            offlineVec.push_back(id);
+        }
+    }
+
+    //离线群消息合并为一次批量写入
+    if (!offlineVec.empty())
+    {
+        TraceSpan span("offline_insert", static_cast<int64_t>(offlineVec.size()));
+        _offlineMsgModel.insert(offlineVec, msg);
+    }
 }
 
 void ChatService::loginout(const TcpConnectionPtr &conn, json &js, Timestamp time)
 {
     int userid = js["id"].get<int>();
     {
-        lock_guard<mutex> lock(_connMutex);
+        lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex));
         auto it = _userConnMap.find(userid);
         if (it!= _userConnMap.end())
         {
@@ -307,28 +900,51 @@ void ChatService::loginout(const TcpConnectionPtr &conn, json &js, Timestamp tim
 
         }
     }
+    //未确认的离线消息留在表中，下次登录重新下发
+    {
+        lock_guard<mutex> lock(_drainMutex);
+        _offlineDrainMap.erase(userid);
+    }
     //用户注销，相当于就是下线，在redis中取消订阅通道
     _redis.unsubscribe(userid);
     //更新用户的状态信息
     if (userid!= -1)
     {
-        auto result = _userModel.query(userid);
-        if (result.second == ErrorCode::SUCCESS) {
-            User user = result.first;
-            user.setState("offline");
-            _userModel.updateState(user);
-        }
+        _userModel.updateState(User(userid, "", "", "offline"));
+        _presenceNotifier.cancel(userid);
+        presenceChanged(userid, false);
     }
 }
 void ChatService::handleRedisSubscribeMessage(int userid, string msg)//从redis消息队列中获取订阅的消息
 {
     json js = json::parse(msg);
-    lock_guard<mutex> lock(_connMutex);
+    //发送方节点采样的消息带有trace id，接着记录本节点的阶段，投递给客户端和存为离线消息前去掉
+    uint64_t traceId = 0;
+    auto field = js.find(kTraceIdField);
+    if (field != js.end())
+    {
+        if (field->is_string())
+        {
+            traceId = Tracer::idFromString(field->get<string>());
+        }
+        js.erase(field);
+    }
+    TraceScope trace(traceId);
+    TraceSpan remote("remote_deliver", userid);
+    unique_lock<InstrumentedMutex> lock(CHAT_LOCK_SITE(_connMutex), defer_lock);
+    {
+        TraceSpan span("conn_mutex_wait");
+        lock.lock();
+    }
     auto it = _userConnMap.find(userid);
     if (it!= _userConnMap.end())
     {
-        it->second->send(js.dump());
+        TraceSpan span("send_local", userid);
+        string payload = js.dump();
+        it->second->send(payload);
+        FlightRecorder::record(FlightEvent::MSG_SENT, userid, static_cast<int64_t>(payload.size()));
         return;
     }
+    TraceSpan span("offline_insert", userid);
     _offlineMsgModel.insert(userid, js.dump());
 }
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include "server/common/BinaryLogSink.hpp"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 与LogLevel::ERROR、LogLevel::FATAL一致
+static const int kErrorLevel = 3;
+static const int kFatalLevel = 4;
+
+BinaryLogSink& BinaryLogSink::getInstance() {
+    static BinaryLogSink instance;
+    return instance;
+}
+
+BinaryLogSink::~BinaryLogSink() {
+    close();
+}
+
+bool BinaryLogSink::open(const Options& options) {
+    close();
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    if (!openFile()) {
+        return false;
+    }
+    queue_.reset(new MpscRingBuffer<Event>(options_.queueCapacity));
+    stopping_ = false;
+    flushRequested_ = false;
+    writer_ = std::thread(&BinaryLogSink::writerTask, this);
+    open_.store(true, std::memory_order_release);
+    return true;
+}
+
+void BinaryLogSink::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!writer_.joinable()) {
+            return;
+        }
+        stopping_ = true;
+    }
+    open_.store(false, std::memory_order_release);
+    writerCv_.notify_one();
+    writer_.join();
+    flushedCv_.notify_all();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        file_->flush();
+        file_.reset();
+    }
+    rotator_.reset();
+}
+
+uint32_t BinaryLogSink::registerSite(int level, const char* file, int line, const char* fmt) {
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+    sites_.push_back(Site{level, line, file != nullptr ? file : "", fmt != nullptr ? fmt : ""});
+    return static_cast<uint32_t>(sites_.size() - 1);
+}
+
+void BinaryLogSink::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!writer_.joinable() || stopping_) {
+        return;
+    }
+    unsigned long long generation = flushGeneration_;
+    flushRequested_ = true;
+    writerCv_.notify_one();
+    flushedCv_.wait(lock, [this, generation]() { return flushGeneration_ > generation || stopping_; });
+}
+
+uint64_t BinaryLogSink::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint32_t BinaryLogSink::currentTid() {
+    static thread_local uint32_t tid = 0;
+    if (tid == 0) {
+        tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+    }
+    return tid;
+}
+
+void BinaryLogSink::submit(Event& event) {
+    if (!isOpen()) {
+        return;
+    }
+    int level = event.level;
+    if (!queue_->tryPush(event)) {
+        if (!options_.blockWhenFull && level < kErrorLevel) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // 阻塞模式，或错误日志不允许丢失：唤醒后台线程并等待腾出空间
+        writerCv_.notify_one();
+        while (!queue_->tryPush(event)) {
+            if (!isOpen()) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    if (level >= kFatalLevel) {
+        // 进程可能随即退出，等待写出
+        flush();
+    } else if (level >= kErrorLevel) {
+        writerCv_.notify_one();
+    }
+}
+
+void BinaryLogSink::writerTask() {
+    auto interval = std::chrono::milliseconds(options_.flushIntervalMs > 0 ? options_.flushIntervalMs : 1);
+    auto lastFlush = std::chrono::steady_clock::now();
+    bool dirty = false;
+    Event event;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        // 在锁外批量写出队列中已有的日志
+        lock.unlock();
+        size_t written = 0;
+        bool urgent = false;
+        while (written < queue_->capacity() && queue_->tryPop(event)) {
+            writeEvent(event);
+            urgent = urgent || event.level >= kErrorLevel;
+            written++;
+        }
+        unsigned long long dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            writeDropped(dropped);
+            written++;
+        }
+        dirty = dirty || written > 0;
+        auto now = std::chrono::steady_clock::now();
+        if (dirty && (urgent || now - lastFlush >= interval)) {
+            file_->flush();
+            dirty = false;
+            lastFlush = now;
+        }
+        lock.lock();
+
+        if (written > 0) {
+            continue;
+        }
+        if (flushRequested_ || stopping_) {
+            if (dirty) {
+                file_->flush();
+                dirty = false;
+                lastFlush = std::chrono::steady_clock::now();
+            }
+            flushRequested_ = false;
+            flushGeneration_++;
+            flushedCv_.notify_all();
+            if (stopping_) {
+                break;
+            }
+            continue;
+        }
+        // 生产者不加锁通知，可能错过唤醒，用超时兜底
+        writerCv_.wait_for(lock, interval);
+    }
+}
+
+void BinaryLogSink::writeEvent(const Event& event) {
+    // 先检查轮转，到达轮转时刻后的第一条事件写入新文件
+    if (rotator_) {
+        maybeRotate();
+    }
+    writeSitesUpTo(event.site);
+    uint16_t len = static_cast<uint16_t>(event.args.size() < BinaryLogFormat::kMaxString
+                                         ? event.args.size() : BinaryLogFormat::kMaxString);
+    // 定长头部拼好后一次写入
+    char header[1 + sizeof(event.site) + sizeof(event.timeUs) + sizeof(event.tid) + sizeof(len)];
+    char* p = header;
+    *p++ = BinaryLogFormat::kEventRecord;
+    memcpy(p, &event.site, sizeof(event.site));
+    p += sizeof(event.site);
+    memcpy(p, &event.timeUs, sizeof(event.timeUs));
+    p += sizeof(event.timeUs);
+    memcpy(p, &event.tid, sizeof(event.tid));
+    p += sizeof(event.tid);
+    memcpy(p, &len, sizeof(len));
+    writeBytes(header, sizeof(header));
+    writeBytes(event.args.data(), len);
+}
+
+void BinaryLogSink::writeDropped(uint64_t count) {
+    char type = BinaryLogFormat::kDroppedRecord;
+    writeBytes(&type, sizeof(type));
+    writeBytes(&count, sizeof(count));
+}
+
+void BinaryLogSink::writeSitesUpTo(uint32_t site) {
+    if (site < sitesWritten_) {
+        return;
+    }
+    // 调用点按id顺序登记，登记先于第一条事件入队，此时一定已在sites_中
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+    for (; sitesWritten_ < sites_.size(); sitesWritten_++) {
+        const Site& s = sites_[sitesWritten_];
+        char type = BinaryLogFormat::kSiteRecord;
+        uint32_t id = static_cast<uint32_t>(sitesWritten_);
+        uint8_t level = static_cast<uint8_t>(s.level);
+        uint32_t line = static_cast<uint32_t>(s.line);
+        uint16_t fileLen = static_cast<uint16_t>(std::min(s.file.size(), BinaryLogFormat::kMaxString));
+        uint16_t fmtLen = static_cast<uint16_t>(std::min(s.fmt.size(), BinaryLogFormat::kMaxString));
+        writeBytes(&type, sizeof(type));
+        writeBytes(&id, sizeof(id));
+        writeBytes(&level, sizeof(level));
+        writeBytes(&line, sizeof(line));
+        writeBytes(&fileLen, sizeof(fileLen));
+        writeBytes(s.file.data(), fileLen);
+        writeBytes(&fmtLen, sizeof(fmtLen));
+        writeBytes(s.fmt.data(), fmtLen);
+    }
+}
+
+void BinaryLogSink::writeBytes(const void* data, size_t len) {
+    file_->write(static_cast<const char*>(data), len);
+    fileSize_ += len;
+}
+
+bool BinaryLogSink::openFile() {
+    std::string header(BinaryLogFormat::kMagic, sizeof(BinaryLogFormat::kMagic));
+    if (options_.enableRotation) {
+        rotator_.reset(new LogFileRotator(options_.path, options_.maxFileCount, header));
+        file_ = rotator_->openCurrent(fileSize_);
+        scheduleTimedRotation();
+    } else {
+        file_.reset(new std::ofstream(options_.path, std::ios::binary | std::ios::app));
+        if (file_->is_open()) {
+            file_->seekp(0, std::ios::end);
+            fileSize_ = static_cast<size_t>(file_->tellp());
+            if (fileSize_ == 0) {
+                writeBytes(header.data(), header.size());
+            }
+        } else {
+            file_.reset();
+        }
+    }
+    if (!file_) {
+        std::cerr << "Failed to open binary log file: " << options_.path << std::endl;
+        rotator_.reset();
+        return false;
+    }
+    // 新文件（包括追加到上一个进程的文件）需要重新写出调用点定义
+    sitesWritten_ = 0;
+    return true;
+}
+
+void BinaryLogSink::maybeRotate() {
+    bool bySize = fileSize_ > options_.maxFileSize;
+    bool byTime = options_.rotateIntervalSeconds > 0 && std::chrono::system_clock::now() >= nextTimedRotation_;
+    if (!bySize && !byTime) {
+        return;
+    }
+    if (rotator_->trySwitch(file_, fileSize_)) {
+        // 新文件需要重新写出调用点定义
+        sitesWritten_ = 0;
+        if (byTime) {
+            scheduleTimedRotation();
+        }
+    }
+}
+
+void BinaryLogSink::scheduleTimedRotation() {
+    if (options_.rotateIntervalSeconds <= 0) {
+        return;
+    }
+    auto interval = std::chrono::seconds(options_.rotateIntervalSeconds);
+    auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    nextTimedRotation_ = std::chrono::system_clock::time_point((sinceEpoch / interval + 1) * interval);
+}
@@ -0,0 +1,358 @@
+#include "server/common/FlightRecorder.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 槽位字段都是原子变量，写入方先把序号置为奇数、写完字段后置为偶数，读取方据此丢弃正在被覆盖的槽位
+struct FlightSlot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> timeUs{0};
+    std::atomic<uint16_t> event{0};
+    std::atomic<int64_t> a{0};
+    std::atomic<int64_t> b{0};
+};
+
+// 信号处理函数使用的备用栈大小
+static const size_t kAlternateStackSize = 64 * 1024;
+
+struct alignas(64) FlightRing {
+    std::atomic<bool> inUse{false};
+    std::atomic<uint32_t> tid{0};
+    std::atomic<uint64_t> next{0};   // 已写入的事件总数，只由所属线程修改
+    FlightSlot slots[FlightRecorder::kEventsPerThread];
+    char alternateStack[kAlternateStackSize];   // 所属线程的备用信号栈，随缓冲一起交给下一个线程
+};
+
+static std::atomic<FlightRing*> g_rings[FlightRecorder::kMaxThreads];
+
+// 信号处理函数中只能读取定长数组
+static char g_dumpDirectory[256] = ".";
+
+static std::atomic<bool> g_crashing{false};
+
+static const char* const kEventNames[] = {
+    "MSG_RECEIVED", "MSG_DISPATCHED", "MSG_SENT", "DB_QUERY_START", "DB_QUERY_END", "REDIS_PUBLISH",
+};
+static_assert(sizeof(kEventNames) / sizeof(kEventNames[0]) == static_cast<size_t>(FlightEvent::EVENT_COUNT),
+              "every FlightEvent needs a name");
+
+// 为调用线程设置备用信号栈，栈溢出时处理函数仍能运行；线程已有备用栈（例如主线程在installCrashHandler中设置的）时保留
+static void installAlternateStack(char* memory, size_t size) {
+    stack_t current;
+    if (sigaltstack(nullptr, &current) == 0 && (current.ss_flags & SS_DISABLE) == 0) {
+        return;
+    }
+    stack_t stack;
+    memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = memory;
+    stack.ss_size = size;
+    sigaltstack(&stack, nullptr);
+}
+
+// 线程退出时交还缓冲，缓冲中的事件保留到被新线程覆盖
+struct FlightRingOwner {
+    FlightRing* ring = nullptr;
+    bool exhausted = false;   // 已达到kMaxThreads，本线程不再尝试
+    ~FlightRingOwner() {
+        if (ring != nullptr) {
+            // 备用栈随缓冲交给下一个线程，先停用
+            stack_t current;
+            if (sigaltstack(nullptr, &current) == 0 && current.ss_sp == ring->alternateStack) {
+                stack_t disable;
+                memset(&disable, 0, sizeof(disable));
+                disable.ss_flags = SS_DISABLE;
+                sigaltstack(&disable, nullptr);
+            }
+            ring->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local FlightRingOwner t_owner;
+
+static FlightRing* acquireRing() {
+    uint32_t tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+    for (size_t i = 0; i < FlightRecorder::kMaxThreads; i++) {
+        FlightRing* ring = g_rings[i].load(std::memory_order_acquire);
+        if (ring == nullptr) {
+            FlightRing* fresh = new FlightRing();
+            fresh->inUse.store(true, std::memory_order_relaxed);
+            fresh->tid.store(tid, std::memory_order_relaxed);
+            if (g_rings[i].compare_exchange_strong(ring, fresh, std::memory_order_acq_rel)) {
+                installAlternateStack(fresh->alternateStack, sizeof(fresh->alternateStack));
+                return fresh;
+            }
+            delete fresh;
+        }
+        bool expected = false;
+        if (ring->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            // 复用已退出线程的缓冲，旧事件不再输出，免得记在新线程名下
+            ring->tid.store(tid, std::memory_order_relaxed);
+            ring->next.store(0, std::memory_order_release);
+            installAlternateStack(ring->alternateStack, sizeof(ring->alternateStack));
+            return ring;
+        }
+    }
+    return nullptr;
+}
+
+static uint64_t nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+// 不分配内存的行缓冲，满了直接write，供信号处理函数使用
+class SignalSafeWriter {
+public:
+    explicit SignalSafeWriter(int fd) : fd_(fd) {}
+    ~SignalSafeWriter() { flush(); }
+
+    void append(const char* text) {
+        while (*text != '\0') {
+            put(*text++);
+        }
+    }
+
+    void appendUnsigned(uint64_t value, int width = 0) {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        for (int i = n; i < width; i++) {
+            put('0');
+        }
+        while (n > 0) {
+            put(digits[--n]);
+        }
+    }
+
+    void appendSigned(int64_t value) {
+        if (value < 0) {
+            put('-');
+            appendUnsigned(static_cast<uint64_t>(-(value + 1)) + 1);
+        } else {
+            appendUnsigned(static_cast<uint64_t>(value));
+        }
+    }
+
+    void flush() {
+        size_t written = 0;
+        while (written < len_) {
+            ssize_t n = ::write(fd_, buf_ + written, len_ - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            written += static_cast<size_t>(n);
+        }
+        len_ = 0;
+    }
+
+private:
+    void put(char c) {
+        if (len_ == sizeof(buf_)) {
+            flush();
+        }
+        buf_[len_++] = c;
+    }
+
+    int fd_;
+    size_t len_ = 0;
+    char buf_[4096];
+};
+
+// 一行：微秒时间戳 UTC时刻 事件 参数
+static void writeEvent(SignalSafeWriter& out, uint64_t timeUs, uint16_t event, int64_t a, int64_t b) {
+    out.appendUnsigned(timeUs);
+    out.append(" ");
+    uint64_t secondOfDay = timeUs / 1000000 % 86400;
+    out.appendUnsigned(secondOfDay / 3600, 2);
+    out.append(":");
+    out.appendUnsigned(secondOfDay / 60 % 60, 2);
+    out.append(":");
+    out.appendUnsigned(secondOfDay % 60, 2);
+    out.append(".");
+    out.appendUnsigned(timeUs % 1000000, 6);
+    out.append(" ");
+    out.append(FlightRecorder::eventName(static_cast<FlightEvent>(event)));
+    out.append(" a=");
+    out.appendSigned(a);
+    out.append(" b=");
+    out.appendSigned(b);
+    out.append("\n");
+}
+
+// 打开<目录>/flight-<pid>-<suffix>.log，不分配内存
+static int openDumpFile(const char* suffix, char* path, size_t size) {
+    char pid[20];
+    char* p = pid + sizeof(pid);
+    *--p = '\0';
+    unsigned long value = static_cast<unsigned long>(::getpid());
+    do {
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    const char* parts[] = {g_dumpDirectory, "/flight-", p, "-", suffix, ".log"};
+    size_t len = 0;
+    for (const char* part : parts) {
+        size_t partLen = strlen(part);
+        if (len + partLen + 1 > size) {
+            return -1;
+        }
+        memcpy(path + len, part, partLen);
+        len += partLen;
+    }
+    path[len] = '\0';
+    return ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static void crashHandler(int sig) {
+    // 多个线程同时崩溃时只写一次；后到的线程停在这里，等第一个线程写完后结束进程
+    if (g_crashing.exchange(true)) {
+        while (true) {
+            pause();
+        }
+    }
+    char path[320];
+    int fd = openDumpFile("crash", path, sizeof(path));
+    if (fd >= 0) {
+        {
+            SignalSafeWriter out(fd);
+            out.append("# fatal signal ");
+            out.appendUnsigned(static_cast<uint64_t>(sig));
+            out.append(" in thread ");
+            out.appendUnsigned(static_cast<uint64_t>(::syscall(SYS_gettid)));
+            out.append("\n");
+        }
+        FlightRecorder::dumpTo(fd);
+        ::close(fd);
+        SignalSafeWriter err(STDERR_FILENO);
+        err.append("flight recorder written to ");
+        err.append(path);
+        err.append("\n");
+    }
+    // 恢复默认处理后再次发出，处理函数返回时按默认方式终止并产生core
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    sigaction(sig, &action, nullptr);
+    raise(sig);
+}
+
+void FlightRecorder::record(FlightEvent event, int64_t a, int64_t b) {
+    FlightRing* ring = t_owner.ring;
+    if (ring == nullptr) {
+        if (t_owner.exhausted) {
+            return;
+        }
+        ring = acquireRing();
+        if (ring == nullptr) {
+            t_owner.exhausted = true;
+            return;
+        }
+        t_owner.ring = ring;
+    }
+    uint64_t index = ring->next.load(std::memory_order_relaxed);
+    FlightSlot& slot = ring->slots[index % kEventsPerThread];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timeUs.store(nowMicros(), std::memory_order_relaxed);
+    slot.event.store(static_cast<uint16_t>(event), std::memory_order_relaxed);
+    slot.a.store(a, std::memory_order_relaxed);
+    slot.b.store(b, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    ring->next.store(index + 1, std::memory_order_release);
+}
+
+void FlightRecorder::setDumpDirectory(const std::string& dir) {
+    size_t len = dir.size() < sizeof(g_dumpDirectory) - 1 ? dir.size() : sizeof(g_dumpDirectory) - 1;
+    memcpy(g_dumpDirectory, dir.data(), len);
+    g_dumpDirectory[len] = '\0';
+}
+
+std::string FlightRecorder::dump() {
+    char suffix[24];
+    snprintf(suffix, sizeof(suffix), "%lld", static_cast<long long>(::time(nullptr)));
+    char path[320];
+    int fd = openDumpFile(suffix, path, sizeof(path));
+    if (fd < 0) {
+        return "";
+    }
+    dumpTo(fd);
+    ::close(fd);
+    return path;
+}
+
+void FlightRecorder::dumpTo(int fd) {
+    SignalSafeWriter out(fd);
+    for (size_t i = 0; i < kMaxThreads; i++) {
+        const FlightRing* ring = g_rings[i].load(std::memory_order_acquire);
+        if (ring == nullptr) {
+            break;
+        }
+        uint64_t end = ring->next.load(std::memory_order_acquire);
+        if (end == 0) {
+            continue;
+        }
+        uint64_t begin = end > kEventsPerThread ? end - kEventsPerThread : 0;
+        out.append("# thread ");
+        out.appendUnsigned(ring->tid.load(std::memory_order_relaxed));
+        out.append(ring->inUse.load(std::memory_order_relaxed) ? "" : " (exited)");
+        out.append(" events ");
+        out.appendUnsigned(end - begin);
+        out.append("/");
+        out.appendUnsigned(end);
+        out.append("\n");
+        for (uint64_t index = begin; index < end; index++) {
+            const FlightSlot& slot = ring->slots[index % kEventsPerThread];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            uint64_t timeUs = slot.timeUs.load(std::memory_order_relaxed);
+            uint16_t event = slot.event.load(std::memory_order_relaxed);
+            int64_t a = slot.a.load(std::memory_order_relaxed);
+            int64_t b = slot.b.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // 读取期间已被所属线程覆盖为更新的事件，跳过
+            if (sequence != 2 * index + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            writeEvent(out, timeUs, event, a, b);
+        }
+    }
+}
+
+void FlightRecorder::installCrashHandler() {
+    // 栈溢出时原栈已不可用，在备用栈上运行处理函数；这里只覆盖调用线程，其他线程在第一次record时各自设置
+    static char alternateStack[kAlternateStackSize];
+    installAlternateStack(alternateStack, sizeof(alternateStack));
+
+    static const int kFatalSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = crashHandler;
+    // 不用SA_RESETHAND：它会让第二个崩溃的线程在第一个写完之前按默认方式结束进程；
+    // 处理期间屏蔽全部致命信号，写出时自身再出错由内核直接终止，而不是重入后停住
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (int sig : kFatalSignals) {
+        sigaddset(&action.sa_mask, sig);
+    }
+    for (int sig : kFatalSignals) {
+        sigaction(sig, &action, nullptr);
+    }
+}
+
+const char* FlightRecorder::eventName(FlightEvent event) {
+    size_t idx = static_cast<size_t>(event);
+    return idx < static_cast<size_t>(FlightEvent::EVENT_COUNT) ? kEventNames[idx] : "UNKNOWN";
+}
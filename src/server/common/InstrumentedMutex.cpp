@@ -0,0 +1,223 @@
+#include "server/common/InstrumentedMutex.hpp"
+#include "server/common/Metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * 一个锁名的统计，指标对象属于MetricsRegistry；
+ * 持有者调用点放在固定大小的开放寻址表中，插入用CAS，表满后的记入overflow
+ */
+class LockStats {
+public:
+    static const size_t kSiteSlots = 64;
+
+    explicit LockStats(const std::string& name)
+        : name(name),
+          acquisitions(MetricsRegistry::instance().counter("chat_lock_acquisitions_total",
+              "Lock acquisitions", MetricsRegistry::label("lock", name))),
+          contended(MetricsRegistry::instance().counter("chat_lock_contended_total",
+              "Lock acquisitions that had to wait", MetricsRegistry::label("lock", name))),
+          wait(MetricsRegistry::instance().histogram("chat_lock_wait_microseconds",
+              "Time spent blocked acquiring a lock", MetricsRegistry::label("lock", name))) {}
+
+    // 把一次等待记在holder名下
+    void blame(void* holder, int64_t waitedUs) {
+        if (holder == nullptr) {
+            add(unknown, waitedUs);
+            return;
+        }
+        size_t start = (reinterpret_cast<uintptr_t>(holder) >> 4) % kSiteSlots;
+        for (size_t i = 0; i < kSiteSlots; i++) {
+            Site& site = sites[(start + i) % kSiteSlots];
+            void* current = site.address.load(std::memory_order_acquire);
+            if (current == nullptr) {
+                if (site.address.compare_exchange_strong(current, holder, std::memory_order_acq_rel)) {
+                    current = holder;
+                }
+            }
+            if (current == holder) {
+                add(site, waitedUs);
+                return;
+            }
+        }
+        add(overflow, waitedUs);
+    }
+
+    struct Site {
+        std::atomic<void*> address{nullptr};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> waitUs{0};
+    };
+
+    static void add(Site& site, int64_t waitedUs) {
+        site.count.fetch_add(1, std::memory_order_relaxed);
+        site.waitUs.fetch_add(static_cast<uint64_t>(waitedUs), std::memory_order_relaxed);
+    }
+
+    const std::string name;
+    MetricCounter& acquisitions;
+    MetricCounter& contended;
+    HdrHistogram& wait;
+    Site sites[kSiteSlots];
+    Site overflow;   // 表已满时的其他调用点
+    Site unknown;    // 开启统计前加锁、或运行期刚打开统计时持有者未知
+};
+
+std::atomic<bool> InstrumentedMutex::enabled_{false};
+
+static std::mutex g_lockStatsMutex;
+
+// 按锁名索引的全部统计，进程内只增不减
+static std::map<std::string, std::unique_ptr<LockStats>>& allLockStats() {
+    static std::map<std::string, std::unique_ptr<LockStats>> stats;
+    return stats;
+}
+
+InstrumentedMutex::InstrumentedMutex(const char* name) : stats_(nullptr) {
+#if CHAT_LOCK_STATS
+    std::lock_guard<std::mutex> lock(g_lockStatsMutex);
+    std::unique_ptr<LockStats>& stats = allLockStats()[name];
+    if (!stats) {
+        stats.reset(new LockStats(name));
+    }
+    stats_ = stats.get();
+#else
+    (void)name;
+#endif
+}
+
+thread_local const LockSite* InstrumentedMutex::nextSite_ = nullptr;
+
+// 标记的调用点在最高位置1，与代码地址区分（用户态地址的最高位总是0）
+static const uintptr_t kMarkedSite = static_cast<uintptr_t>(1) << (sizeof(uintptr_t) * 8 - 1);
+
+// 取出CHAT_LOCK_SITE标记的调用点，未标记时退回到返回地址
+static inline void* takeSite(const LockSite*& next, void* returnAddress) {
+    const LockSite* site = next;
+    if (site == nullptr) {
+        return returnAddress;
+    }
+    next = nullptr;
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(site) | kMarkedSite);
+}
+
+void InstrumentedMutex::lockInstrumented() {
+    void* site = takeSite(nextSite_, __builtin_return_address(0));
+    stats_->acquisitions.inc();
+    if (!mutex_.try_lock()) {
+        void* holder = holder_.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        mutex_.lock();
+        int64_t waited = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        stats_->contended.inc();
+        stats_->wait.record(waited);
+        stats_->blame(holder, waited);
+    }
+    holder_.store(site, std::memory_order_relaxed);
+}
+
+bool InstrumentedMutex::tryLockInstrumented() {
+    if (!mutex_.try_lock()) {
+        // 失败时保留标记，留给随后阻塞的lock()
+        return false;
+    }
+    void* site = takeSite(nextSite_, __builtin_return_address(0));
+    stats_->acquisitions.inc();
+    holder_.store(site, std::memory_order_relaxed);
+    return true;
+}
+
+// 标记的调用点显示为 文件名:行号；未标记的显示为 模块+偏移（可用addr2line -f -C -e 模块 偏移 查看源码行），能解析到符号时附上函数名
+static std::string describeSite(void* address) {
+    if (address == nullptr) {
+        return "unknown";
+    }
+    uintptr_t value = reinterpret_cast<uintptr_t>(address);
+    if (value & kMarkedSite) {
+        // CHAT_LOCK_SITE标记的调用点，显示为 文件名:行号
+        const LockSite* site = reinterpret_cast<const LockSite*>(value & ~kMarkedSite);
+        const char* file = strrchr(site->file, '/');
+        return std::string(file != nullptr ? file + 1 : site->file) + ":" + std::to_string(site->line);
+    }
+    Dl_info info;
+    if (dladdr(address, &info) == 0 || info.dli_fname == nullptr) {
+        char text[32];
+        snprintf(text, sizeof(text), "%p", address);
+        return text;
+    }
+    const char* module = strrchr(info.dli_fname, '/');
+    module = module != nullptr ? module + 1 : info.dli_fname;
+    char text[256];
+    snprintf(text, sizeof(text), "%s+0x%lx", module,
+             static_cast<unsigned long>(static_cast<char*>(address) - static_cast<char*>(info.dli_fbase)));
+    std::string result = text;
+    if (info.dli_sname != nullptr) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        result += " (";
+        result += status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+        result += ")";
+        free(demangled);
+    }
+    return result;
+}
+
+std::string InstrumentedMutex::dumpAll() {
+    static const size_t kTopSites = 5;
+    std::string report;
+    std::lock_guard<std::mutex> lock(g_lockStatsMutex);
+    for (const auto& entry : allLockStats()) {
+        const LockStats& stats = *entry.second;
+        uint64_t acquisitions = stats.acquisitions.value();
+        uint64_t contended = stats.contended.value();
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "[lock %s] acquisitions=%llu contended=%llu (%.2f%%) wait(us) p50=%lld p99=%lld max=%lld\n",
+                 stats.name.c_str(), static_cast<unsigned long long>(acquisitions),
+                 static_cast<unsigned long long>(contended),
+                 acquisitions > 0 ? 100.0 * contended / acquisitions : 0.0,
+                 static_cast<long long>(stats.wait.percentile(50)), static_cast<long long>(stats.wait.percentile(99)),
+                 static_cast<long long>(stats.wait.max()));
+        report += line;
+
+        // 造成等待总时长最多的持有者调用点
+        std::vector<const LockStats::Site*> sites;
+        for (const LockStats::Site& site : stats.sites) {
+            if (site.address.load(std::memory_order_acquire) != nullptr) {
+                sites.push_back(&site);
+            }
+        }
+        std::sort(sites.begin(), sites.end(), [](const LockStats::Site* a, const LockStats::Site* b) {
+            return a->waitUs.load(std::memory_order_relaxed) > b->waitUs.load(std::memory_order_relaxed);
+        });
+        for (size_t i = 0; i < sites.size() && i < kTopSites; i++) {
+            snprintf(line, sizeof(line), "  holder contended=%llu wait=%lluus at ",
+                     static_cast<unsigned long long>(sites[i]->count.load(std::memory_order_relaxed)),
+                     static_cast<unsigned long long>(sites[i]->waitUs.load(std::memory_order_relaxed)));
+            report += line;
+            report += describeSite(sites[i]->address.load(std::memory_order_relaxed)) + "\n";
+        }
+        const std::pair<const LockStats::Site*, const char*> extras[] = {
+            {&stats.overflow, "<other sites>"}, {&stats.unknown, "<unknown>"}};
+        for (const auto& extra : extras) {
+            uint64_t count = extra.first->count.load(std::memory_order_relaxed);
+            if (count > 0) {
+                snprintf(line, sizeof(line), "  holder contended=%llu wait=%lluus at %s\n",
+                         static_cast<unsigned long long>(count),
+                         static_cast<unsigned long long>(extra.first->waitUs.load(std::memory_order_relaxed)),
+                         extra.second);
+                report += line;
+            }
+        }
+    }
+    return report;
+}
@@ -0,0 +1,130 @@
+#include "server/common/LogFileRotator.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+
+// 备用文件打开失败后的重试间隔
+static const int kStandbyRetryMs = 1000;
+
+LogFileRotator::LogFileRotator(const string& basePath, int maxFileCount, const string& header)
+    : basePath_(basePath),
+      nextPath_(basePath + ".next"),
+      maxFileCount_(maxFileCount > 0 ? maxFileCount : 1),
+      header_(header) {
+    worker_ = thread(&LogFileRotator::workerTask, this);
+}
+
+LogFileRotator::~LogFileRotator() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+
+    if (standby_) {
+        standby_->close();
+        standby_.reset();
+        // 只删除本进程新建、从未写入的备用文件，上次崩溃遗留的内容保留
+        if (standbySize_ == header_.size()) {
+            remove(nextPath_.c_str());
+        }
+    }
+}
+
+unique_ptr<ofstream> LogFileRotator::openCurrent(size_t& size) {
+    return openFile(basePath_, size);
+}
+
+bool LogFileRotator::trySwitch(unique_ptr<ofstream>& current, size_t& size) {
+    lock_guard<mutex> lock(mutex_);
+    if (!standby_ || retired_) {
+        return false;
+    }
+    retired_ = std::move(current);
+    current = std::move(standby_);
+    size = standbySize_;
+    cv_.notify_one();
+    return true;
+}
+
+bool LogFileRotator::idle() {
+    lock_guard<mutex> lock(mutex_);
+    return !retired_ && standby_ != nullptr;
+}
+
+void LogFileRotator::workerTask() {
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        if (retired_) {
+            unique_ptr<ofstream> retired = std::move(retired_);
+            lock.unlock();
+            // 关闭时写出残留缓冲，然后把base.next改名为base
+            retired->close();
+            retired.reset();
+            renameFiles();
+            lock.lock();
+            continue;
+        }
+        if (!standby_ && !stopping_) {
+            lock.unlock();
+            prepareStandby();
+            lock.lock();
+            if (!standby_) {
+                cv_.wait_for(lock, chrono::milliseconds(kStandbyRetryMs));
+            }
+            continue;
+        }
+        if (stopping_) {
+            break;
+        }
+        cv_.wait(lock);
+    }
+}
+
+void LogFileRotator::renameFiles() {
+    struct stat st;
+    if (maxFileCount_ <= 1) {
+        remove(basePath_.c_str());
+    } else {
+        remove((basePath_ + "." + to_string(maxFileCount_ - 1)).c_str());
+        for (int i = maxFileCount_ - 2; i >= 0; i--) {
+            string current = (i == 0) ? basePath_ : basePath_ + "." + to_string(i);
+            string next = basePath_ + "." + to_string(i + 1);
+            if (stat(current.c_str(), &st) == 0) {
+                rename(current.c_str(), next.c_str());
+            }
+        }
+    }
+    // 写线程已经在写base.next，改名后打开的文件流不受影响
+    if (rename(nextPath_.c_str(), basePath_.c_str()) != 0) {
+        cerr << "Failed to rename " << nextPath_ << " to " << basePath_ << endl;
+    }
+}
+
+void LogFileRotator::prepareStandby() {
+    size_t size = 0;
+    unique_ptr<ofstream> file = openFile(nextPath_, size);
+    if (!file) {
+        return;
+    }
+    lock_guard<mutex> lock(mutex_);
+    standby_ = std::move(file);
+    standbySize_ = size;
+}
+
+unique_ptr<ofstream> LogFileRotator::openFile(const string& path, size_t& size) {
+    unique_ptr<ofstream> file(new ofstream(path, ios::binary | ios::app));
+    if (!file->is_open()) {
+        cerr << "Failed to open log file: " << path << endl;
+        return nullptr;
+    }
+    file->seekp(0, ios::end);
+    size = static_cast<size_t>(file->tellp());
+    if (size == 0 && !header_.empty()) {
+        file->write(header_.data(), header_.size());
+        size = header_.size();
+    }
+    return file;
+}
@@ -2,11 +2,14 @@
 #include <iostream>
 #include <cstdio>
 #include <cstring>
+#include <cstdarg>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <thread>
 
 Logger& Logger::getInstance() {
+    // 先构造二进制日志单例，保证它晚于Logger析构，Logger析构时仍可关闭它
+    BinaryLogSink::getInstance();
     static Logger instance;
     return instance;
 }
@@ -16,156 +19,380 @@ Logger::~Logger() {
 }
 
 void Logger::init(const LogConfig& config) {
-    lock_guard<mutex> lock(logMutex_);
-    
-    config_ = config;
-    
-    if (config_.enableFile) {
-        ensureLogDirectory();
-        
-        string fullPath = config_.logDir + "/" + config_.logFileName;
-        fileStream_.reset(new ofstream(fullPath, ios::app));
-        
-        if (!fileStream_->is_open()) {
-            cerr << "Failed to open log file: " << fullPath << endl;
-            config_.enableFile = false;
-        } else {
-            // 获取当前文件大小
-            fileStream_->seekp(0, ios::end);
-            currentFileSize_ = fileStream_->tellp();
+    // 重复初始化时先停止之前的后台线程
+    shutdown();
+    {
+        lock_guard<mutex> lock(logMutex_);
+
+        config_ = config;
+        level_.store(static_cast<int>(config_.level), memory_order_relaxed);
+
+        if (config_.enableFile || config_.enableBinary) {
+            ensureLogDirectory();
+        }
+        if (config_.enableFile) {
+            string fullPath = config_.logDir + "/" + config_.logFileName;
+            if (config_.enableRotation) {
+                rotator_.reset(new LogFileRotator(fullPath, config_.maxFileCount));
+                fileStream_ = rotator_->openCurrent(currentFileSize_);
+                scheduleTimedRotation();
+            } else {
+                fileStream_.reset(new ofstream(fullPath, ios::app));
+                if (fileStream_->is_open()) {
+                    // 获取当前文件大小
+                    fileStream_->seekp(0, ios::end);
+                    currentFileSize_ = fileStream_->tellp();
+                } else {
+                    fileStream_.reset();
+                }
+            }
+
+            if (!fileStream_) {
+                cerr << "Failed to open log file: " << fullPath << endl;
+                config_.enableFile = false;
+                rotator_.reset();
+            }
+        }
+
+        queue_.reset(new MpscRingBuffer<LogRecord>(config_.queueCapacity));
+        stopping_ = false;
+        flushRequested_ = false;
+        writer_ = thread(&Logger::writerTask, this);
+
+        if (config_.enableBinary) {
+            BinaryLogSink::Options options;
+            options.path = config_.logDir + "/" + config_.binaryFileName;
+            options.queueCapacity = config_.queueCapacity;
+            options.blockWhenFull = config_.blockWhenFull;
+            options.flushIntervalMs = config_.flushIntervalMs;
+            options.enableRotation = config_.enableRotation;
+            options.maxFileSize = config_.maxFileSize;
+            options.maxFileCount = config_.maxFileCount;
+            options.rotateIntervalSeconds = config_.rotateIntervalSeconds;
+            if (!BinaryLogSink::getInstance().open(options)) {
+                config_.enableBinary = false;
+            }
         }
     }
-    
-    initialized_ = true;
-    
+    initialized_.store(true, memory_order_release);
+
     // 记录初始化信息
     info("Logger initialized successfully");
-    info("Log level: " + levelToString(config_.level));
+    info(string("Log level: ") + levelToString(config_.level));
     info("Console output: " + string(config_.enableConsole ? "enabled" : "disabled"));
     info("File output: " + string(config_.enableFile ? "enabled" : "disabled"));
+    info("Binary output: " + string(config_.enableBinary ? "enabled" : "disabled"));
 }
 
-void Logger::log(LogLevel level, const string& message, const string& file, int line) {
+void Logger::log(LogLevel level, const string& message, const char* file, int line) {
     if (!shouldLog(level)) {
         return;
     }
-    
-    lock_guard<mutex> lock(logMutex_);
-    
-    string formattedMessage = formatMessage(level, message, file, line);
-    
-    if (config_.enableConsole) {
-        writeToConsole(formattedMessage, level);
+
+    LogRecord record;
+    record.level = level;
+    record.text = formatMessage(level, message, file, line);
+    enqueue(record);
+}
+
+void Logger::logFormatted(LogLevel level, const char* text, size_t len) {
+    if (!shouldLog(level)) {
+        return;
     }
-    
-    if (config_.enableFile && fileStream_ && fileStream_->is_open()) {
-        writeToFile(formattedMessage);
-        
-        // 检查是否需要轮转日志
-        if (config_.enableRotation && currentFileSize_ > config_.maxFileSize) {
-            rotateLogFile();
+
+    LogRecord record;
+    record.level = level;
+    record.text.assign(text, len);
+    enqueue(record);
+}
+
+void Logger::enqueue(LogRecord& record) {
+    LogLevel level = record.level;
+    if (!queue_->tryPush(record)) {
+        if (!config_.blockWhenFull && level < LogLevel::ERROR) {
+            dropped_.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        // 阻塞模式，或错误日志不允许丢失：唤醒后台线程并等待腾出空间
+        writerCv_.notify_one();
+        while (!queue_->tryPush(record)) {
+            if (!initialized_.load(memory_order_acquire)) {
+                return;
+            }
+            this_thread::sleep_for(chrono::microseconds(50));
         }
     }
+
+    if (level == LogLevel::FATAL) {
+        // 进程可能随即退出，等待写出
+        flush();
+    } else if (level >= LogLevel::ERROR) {
+        // 错误日志尽快落盘
+        writerCv_.notify_one();
+    }
 }
 
-void Logger::debug(const string& message, const string& file, int line) {
+void Logger::debug(const string& message, const char* file, int line) {
     log(LogLevel::DEBUG, message, file, line);
 }
 
-void Logger::info(const string& message, const string& file, int line) {
+void Logger::info(const string& message, const char* file, int line) {
     log(LogLevel::INFO, message, file, line);
 }
 
-void Logger::warn(const string& message, const string& file, int line) {
+void Logger::warn(const string& message, const char* file, int line) {
     log(LogLevel::WARN, message, file, line);
 }
 
-void Logger::error(const string& message, const string& file, int line) {
+void Logger::error(const string& message, const char* file, int line) {
     log(LogLevel::ERROR, message, file, line);
 }
 
-void Logger::fatal(const string& message, const string& file, int line) {
+void Logger::fatal(const string& message, const char* file, int line) {
     log(LogLevel::FATAL, message, file, line);
-    flush();
 }
 
 void Logger::setLogLevel(LogLevel level) {
     lock_guard<mutex> lock(logMutex_);
     config_.level = level;
+    level_.store(static_cast<int>(level), memory_order_relaxed);
 }
 
 LogLevel Logger::getLogLevel() const {
-    return config_.level;
+    return static_cast<LogLevel>(level_.load(memory_order_relaxed));
+}
+
+size_t Logger::queueDepth() const {
+    // 队列只在init/shutdown时替换，未初始化时没有待写日志
+    if (!initialized_.load(memory_order_acquire)) {
+        return 0;
+    }
+    return queue_->sizeApprox();
 }
 
 void Logger::flush() {
+    BinaryLogSink::getInstance().flush();
+    unique_lock<mutex> lock(logMutex_);
+    if (!writer_.joinable() || stopping_) {
+        return;
+    }
+    unsigned long long generation = flushGeneration_;
+    flushRequested_ = true;
+    writerCv_.notify_one();
+    flushedCv_.wait(lock, [this, generation]() { return flushGeneration_ > generation || stopping_; });
+}
+
+void Logger::shutdown() {
+    if (!initialized_.load(memory_order_acquire)) {
+        return;
+    }
+    info("Logger shutting down");
+    BinaryLogSink::getInstance().close();
+    {
+        lock_guard<mutex> lock(logMutex_);
+        stopping_ = true;
+    }
+    initialized_.store(false, memory_order_release);
+    writerCv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    flushedCv_.notify_all();
+
     lock_guard<mutex> lock(logMutex_);
-    
+    if (fileStream_) {
+        fileStream_->flush();
+        fileStream_->close();
+        fileStream_.reset();
+    }
+    // 等待后台完成最后一次轮转的改名
+    rotator_.reset();
+}
+
+string Logger::format(const char* fmt, ...) {
+    // 大多数日志行不超过这个长度，一次vsnprintf完成；更长时按实际长度重新格式化，不截断
+    char buffer[512];
+    va_list args;
+    va_start(args, fmt);
+    va_list retry;
+    va_copy(retry, args);
+    int len = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    string out;
+    if (len < 0) {
+        out = fmt;
+    } else if (static_cast<size_t>(len) < sizeof(buffer)) {
+        out.assign(buffer, len);
+    } else {
+        out.resize(len);
+        vsnprintf(&out[0], len + 1, fmt, retry);
+    }
+    va_end(retry);
+    return out;
+}
+
+void Logger::writerTask() {
+    auto interval = chrono::milliseconds(config_.flushIntervalMs > 0 ? config_.flushIntervalMs : 1);
+    auto lastFlush = chrono::steady_clock::now();
+    bool dirty = false;
+    LogRecord record;
+
+    unique_lock<mutex> lock(logMutex_);
+    while (true) {
+        // 在锁外批量写出队列中已有的日志
+        lock.unlock();
+        size_t written = 0;
+        bool urgent = false;
+        while (written < queue_->capacity() && queue_->tryPop(record)) {
+            urgent = writeRecord(record) || urgent;
+            written++;
+        }
+        unsigned long long dropped = dropped_.exchange(0, memory_order_relaxed);
+        if (dropped > 0) {
+            LogRecord notice;
+            notice.level = LogLevel::WARN;
+            notice.text = formatMessage(LogLevel::WARN, "Log queue full, dropped " + to_string(dropped) + " lines", "", 0);
+            writeRecord(notice);
+            written++;
+        }
+        dirty = dirty || written > 0;
+        auto now = chrono::steady_clock::now();
+        if (dirty && (urgent || now - lastFlush >= interval)) {
+            flushStreams();
+            dirty = false;
+            lastFlush = now;
+        }
+        lock.lock();
+
+        if (written > 0) {
+            // 可能还有未写完的日志，继续写，不等待
+            continue;
+        }
+        // 队列已空：此前提交的日志都已写出
+        if (flushRequested_ || stopping_) {
+            if (dirty) {
+                lock.unlock();
+                flushStreams();
+                lock.lock();
+                dirty = false;
+                lastFlush = chrono::steady_clock::now();
+            }
+            flushRequested_ = false;
+            flushGeneration_++;
+            flushedCv_.notify_all();
+            if (stopping_) {
+                break;
+            }
+            continue;
+        }
+        // 生产者不加锁通知，可能错过唤醒，用超时兜底
+        writerCv_.wait_for(lock, interval);
+    }
+}
+
+bool Logger::writeRecord(const LogRecord& record) {
+    if (config_.enableConsole) {
+        writeToConsole(record.text, record.level);
+    }
+
+    if (config_.enableFile && fileStream_ && fileStream_->is_open()) {
+        // 先检查轮转，到达轮转时刻后的第一行写入新文件
+        if (rotator_) {
+            maybeRotate();
+        }
+        writeToFile(record.text);
+    }
+    return record.level >= LogLevel::ERROR;
+}
+
+void Logger::flushStreams() {
     if (config_.enableConsole) {
         cout.flush();
         cerr.flush();
     }
-    
+
     if (config_.enableFile && fileStream_) {
         fileStream_->flush();
     }
 }
 
-void Logger::shutdown() {
-    lock_guard<mutex> lock(logMutex_);
-    
-    if (initialized_) {
-        info("Logger shutting down");
-        
-        if (fileStream_) {
-            fileStream_->flush();
-            fileStream_->close();
-            fileStream_.reset();
-        }
-        
-        initialized_ = false;
+// 每个线程缓存本秒的 "YYYY-mm-dd HH:MM:SS." 前缀，秒数变化时才调用localtime_r重新格式化，其余时候只补上毫秒
+struct TimestampCache {
+    time_t second = -1;
+    char prefix[32];
+    size_t length = 0;
+};
+static thread_local TimestampCache t_timestampCache;
+// 每个线程的线程id字符串只格式化一次
+static thread_local string t_threadIdString;
+
+static const string& currentThreadIdString() {
+    if (t_threadIdString.empty()) {
+        ostringstream oss;
+        oss << std::this_thread::get_id();
+        t_threadIdString = oss.str();
     }
+    return t_threadIdString;
 }
 
-string Logger::formatMessage(LogLevel level, const string& message, const string& file, int line) {
-    ostringstream oss;
-    
+string Logger::formatMessage(LogLevel level, const string& message, const char* file, int line) {
+    string out;
+    out.reserve(80 + message.size());
+
     // 时间戳
-    oss << "[" << getCurrentTime() << "]";
-    
+    out += '[';
+    appendCurrentTime(out);
+    out += "] [";
+
     // 日志级别
-    oss << " [" << levelToString(level) << "]";
-    
+    out += levelToString(level);
+    out += "] [";
+
     // 线程ID
-    oss << " [" << std::this_thread::get_id() << "]";
-    
+    out += currentThreadIdString();
+    out += ']';
+
     // 文件和行号（如果提供）
-    if (!file.empty() && line > 0) {
+    if (file != nullptr && file[0] != '\0' && line > 0) {
         // 只显示文件名，不显示完整路径
-        size_t pos = file.find_last_of("/\\");
-        string filename = (pos != string::npos) ? file.substr(pos + 1) : file;
-        oss << " [" << filename << ":" << line << "]";
+        const char* filename = strrchr(file, '/');
+        out += " [";
+        out += filename != nullptr ? filename + 1 : file;
+        out += ':';
+        out += to_string(line);
+        out += ']';
     }
-    
+
     // 消息内容
-    oss << " " << message;
-    
-    return oss.str();
+    out += ' ';
+    out += message;
+    return out;
 }
 
-string Logger::getCurrentTime() {
+void Logger::appendCurrentTime(string& out) {
     auto now = chrono::system_clock::now();
-    auto time_t = chrono::system_clock::to_time_t(now);
-    auto ms = chrono::duration_cast<chrono::milliseconds>(now.time_since_epoch()) % 1000;
-    
-    ostringstream oss;
-    oss << put_time(localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    oss << "." << setfill('0') << setw(3) << ms.count();
-    
-    return oss.str();
+    auto us = chrono::duration_cast<chrono::microseconds>(now.time_since_epoch()).count();
+    time_t seconds = static_cast<time_t>(us / 1000000);
+    int ms = static_cast<int>(us / 1000 % 1000);
+
+    TimestampCache& cache = t_timestampCache;
+    if (seconds != cache.second) {
+        // 多个线程并发格式化，使用可重入的localtime_r
+        struct tm tmBuf;
+        localtime_r(&seconds, &tmBuf);
+        cache.length = strftime(cache.prefix, sizeof(cache.prefix), "%Y-%m-%d %H:%M:%S.", &tmBuf);
+        cache.second = seconds;
+    }
+    out.append(cache.prefix, cache.length);
+    char msBuf[3] = {
+        static_cast<char>('0' + ms / 100),
+        static_cast<char>('0' + ms / 10 % 10),
+        static_cast<char>('0' + ms % 10)
+    };
+    out.append(msBuf, sizeof(msBuf));
 }
 
-string Logger::levelToString(LogLevel level) {
+const char* Logger::levelToString(LogLevel level) {
     switch (level) {
         case LogLevel::DEBUG: return "DEBUG";
         case LogLevel::INFO:  return "INFO ";
@@ -178,7 +405,8 @@ string Logger::levelToString(LogLevel level) {
 
 void Logger::writeToFile(const string& message) {
     if (fileStream_ && fileStream_->is_open()) {
-        *fileStream_ << message << endl;
+        // 不逐行刷盘，由后台线程按刷盘策略统一flush
+        *fileStream_ << message << '\n';
         currentFileSize_ += message.length() + 1; // +1 for newline
     }
 }
@@ -186,52 +414,31 @@ void Logger::writeToFile(const string& message) {
 void Logger::writeToConsole(const string& message, LogLevel level) {
     // 根据日志级别选择输出流
     if (level >= LogLevel::ERROR) {
-        cerr << message << endl;
+        cerr << message << '\n';
     } else {
-        cout << message << endl;
+        cout << message << '\n';
     }
 }
 
-void Logger::rotateLogFile() {
-    if (!fileStream_) return;
-    
-    fileStream_->close();
-    
-    // 轮转现有日志文件
-    string basePath = config_.logDir + "/" + config_.logFileName;
-    
-    // 删除最老的日志文件
-    string oldestFile = basePath + "." + to_string(config_.maxFileCount - 1);
-    struct stat st;
-        if (stat(oldestFile.c_str(), &st) == 0) {
-            remove(oldestFile.c_str());
-    }
-    
-    // 重命名现有文件
-    for (int i = config_.maxFileCount - 2; i >= 0; i--) {
-        string currentFile = (i == 0) ? basePath : basePath + "." + to_string(i);
-        string nextFile = basePath + "." + to_string(i + 1);
-        
-        struct stat st;
-        if (stat(currentFile.c_str(), &st) == 0) {
-            rename(currentFile.c_str(), nextFile.c_str());
-        }
+void Logger::maybeRotate() {
+    bool bySize = currentFileSize_ > config_.maxFileSize;
+    bool byTime = config_.rotateIntervalSeconds > 0 && chrono::system_clock::now() >= nextTimedRotation_;
+    if (!bySize && !byTime) {
+        return;
     }
-    
-    // 创建新的日志文件
-    fileStream_.reset(new ofstream(basePath, ios::app));
-    currentFileSize_ = 0;
-    
-    if (fileStream_->is_open()) {
-        info("Log file rotated successfully");
-    } else {
-        cerr << "Failed to create new log file after rotation" << endl;
-        config_.enableFile = false;
+    // 只交换文件流，不做任何文件系统操作；下一个文件还没准备好时继续写当前文件，稍后再试
+    if (rotator_->trySwitch(fileStream_, currentFileSize_) && byTime) {
+        scheduleTimedRotation();
     }
 }
 
-bool Logger::shouldLog(LogLevel level) const {
-    return initialized_ && level >= config_.level;
+void Logger::scheduleTimedRotation() {
+    if (config_.rotateIntervalSeconds <= 0) {
+        return;
+    }
+    auto interval = chrono::seconds(config_.rotateIntervalSeconds);
+    auto sinceEpoch = chrono::system_clock::now().time_since_epoch();
+    nextTimedRotation_ = chrono::system_clock::time_point((sinceEpoch / interval + 1) * interval);
 }
 
 void Logger::ensureLogDirectory() {
@@ -254,9 +461,5 @@ PerformanceLogger::PerformanceLogger(const string& operation)
 PerformanceLogger::~PerformanceLogger() {
     auto endTime = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::microseconds>(endTime - startTime_);
-    
-    ostringstream oss;
-    oss << "Performance: " << operation_ << " took " << duration.count() << " microseconds";
-    
-    Logger::getInstance().info(oss.str());
-}
\ No newline at end of file
+    CHAT_LOG_INFO("Performance: " + operation_ + " took " + to_string(duration.count()) + " microseconds");
+}
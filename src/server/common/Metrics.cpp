@@ -0,0 +1,207 @@
+#include "server/common/Metrics.hpp"
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+HdrHistogram::HdrHistogram() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t HdrHistogram::bucketIndex(uint64_t value) {
+    if (value < kSubBucketCount) {
+        return static_cast<size_t>(value);
+    }
+    // 最高位决定所在的2的幂区间，其下的kSubBucketBits-1位决定区间内的线性桶
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (kSubBucketBits - 1);
+    size_t idx = kSubBucketCount + (shift - 1) * kSubBucketHalf + ((value >> shift) - kSubBucketHalf);
+    return idx < kBucketCount ? idx : kBucketCount - 1;
+}
+
+uint64_t HdrHistogram::bucketUpperBound(size_t idx) {
+    if (idx < kSubBucketCount) {
+        return idx;
+    }
+    size_t shift = (idx - kSubBucketCount) / kSubBucketHalf + 1;
+    uint64_t sub = (idx - kSubBucketCount) % kSubBucketHalf + kSubBucketHalf;
+    return ((sub + 1) << shift) - 1;
+}
+
+void HdrHistogram::record(int64_t value) {
+    if (value < 0) {
+        value = 0;
+    }
+    buckets_[bucketIndex(static_cast<uint64_t>(value))].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(static_cast<uint64_t>(value), std::memory_order_relaxed);
+    int64_t current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+int64_t HdrHistogram::percentile(double p) const {
+    // 以各桶计数之和为准，避免与count_之间的并发偏差
+    uint64_t total = 0;
+    for (const auto& bucket : buckets_) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    if (p < 0) {
+        p = 0;
+    }
+    if (p > 100) {
+        p = 100;
+    }
+    uint64_t target = static_cast<uint64_t>(std::ceil(p / 100.0 * total));
+    if (target == 0) {
+        target = 1;
+    }
+    int64_t maxValue = max();
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            int64_t bound = static_cast<int64_t>(bucketUpperBound(i));
+            return bound < maxValue ? bound : maxValue;
+        }
+    }
+    return maxValue;
+}
+
+void HdrHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::findOrCreate(const std::string& name, const std::string& help,
+                                                       Type type, const std::string& labels) {
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.emplace(name, Family{type, help, {}}).first;
+    } else if (it->second.type != type) {
+        throw std::logic_error("metric " + name + " registered with a different type");
+    }
+    return it->second.series[labels];
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = findOrCreate(name, help, Type::COUNTER, labels);
+    if (!series.counter) {
+        series.counter.reset(new MetricCounter());
+    }
+    return *series.counter;
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = findOrCreate(name, help, Type::GAUGE, labels);
+    if (!series.gauge && !series.callback) {
+        series.gauge.reset(new MetricGauge());
+    } else if (!series.gauge) {
+        throw std::logic_error("metric " + name + " is already a callback gauge");
+    }
+    return *series.gauge;
+}
+
+HdrHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = findOrCreate(name, help, Type::SUMMARY, labels);
+    if (!series.histogram) {
+        series.histogram.reset(new HdrHistogram());
+    }
+    return *series.histogram;
+}
+
+void MetricsRegistry::gaugeCallback(const std::string& name, const std::string& help,
+                                    std::function<int64_t()> callback, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = findOrCreate(name, help, Type::GAUGE, labels);
+    if (series.gauge) {
+        throw std::logic_error("metric " + name + " is already a plain gauge");
+    }
+    series.callback = std::move(callback);
+}
+
+// 在已有标签后追加一个标签
+static std::string withLabel(const std::string& labels, const std::string& extra) {
+    std::string all = labels.empty() ? extra : labels + "," + extra;
+    return "{" + all + "}";
+}
+
+static std::string braced(const std::string& labels) {
+    return labels.empty() ? "" : "{" + labels + "}";
+}
+
+std::string MetricsRegistry::renderPrometheus() {
+    static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+    std::string out;
+    out.reserve(4096);
+    // 回调在锁内求值，回调中不能再访问注册表
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : families_) {
+        const std::string& name = entry.first;
+        const Family& family = entry.second;
+        const char* type = family.type == Type::COUNTER ? "counter" : family.type == Type::GAUGE ? "gauge" : "summary";
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + type + "\n";
+        // 最大值不属于summary的标准序列，单独作为name_max仪表输出
+        std::string maxLines;
+        for (const auto& item : family.series) {
+            const std::string& labels = item.first;
+            const Series& series = item.second;
+            if (series.counter) {
+                out += name + braced(labels) + " " + std::to_string(series.counter->value()) + "\n";
+            } else if (series.gauge) {
+                out += name + braced(labels) + " " + std::to_string(series.gauge->value()) + "\n";
+            } else if (series.callback) {
+                out += name + braced(labels) + " " + std::to_string(series.callback()) + "\n";
+            } else if (series.histogram) {
+                const HdrHistogram& h = *series.histogram;
+                for (double q : kQuantiles) {
+                    char quantile[32];
+                    snprintf(quantile, sizeof(quantile), "quantile=\"%g\"", q);
+                    out += name + withLabel(labels, quantile) + " " + std::to_string(h.percentile(q * 100)) + "\n";
+                }
+                out += name + "_sum" + braced(labels) + " " + std::to_string(h.sum()) + "\n";
+                out += name + "_count" + braced(labels) + " " + std::to_string(h.count()) + "\n";
+                maxLines += name + "_max" + braced(labels) + " " + std::to_string(h.max()) + "\n";
+            }
+        }
+        if (!maxLines.empty()) {
+            out += "# HELP " + name + "_max Largest value recorded in " + name + "\n";
+            out += "# TYPE " + name + "_max gauge\n";
+            out += maxLines;
+        }
+    }
+    return out;
+}
+
+std::string MetricsRegistry::label(const std::string& key, const std::string& value) {
+    std::string out = key + "=\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
@@ -0,0 +1,50 @@
+#include "server/common/MuduoLogBridge.hpp"
+#include <muduo/base/Logging.h>
+#include <cstdio>
+
+static muduo::Logger::LogLevel toMuduoLevel(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG: return muduo::Logger::DEBUG;
+        case LogLevel::INFO:  return muduo::Logger::INFO;
+        case LogLevel::WARN:  return muduo::Logger::WARN;
+        case LogLevel::ERROR: return muduo::Logger::ERROR;
+        default:              return muduo::Logger::FATAL;
+    }
+}
+
+void MuduoLogBridge::install() {
+    muduo::Logger::setLogLevel(toMuduoLevel(::Logger::getInstance().getLogLevel()));
+    muduo::Logger::setOutput(&MuduoLogBridge::output);
+    muduo::Logger::setFlush(&MuduoLogBridge::flush);
+}
+
+void MuduoLogBridge::setLogLevel(LogLevel level) {
+    ::Logger::getInstance().setLogLevel(level);
+    muduo::Logger::setLogLevel(toMuduoLevel(level));
+}
+
+void MuduoLogBridge::output(const char* msg, int len) {
+    ::Logger& logger = ::Logger::getInstance();
+    // Logger未初始化或已关闭（FATAL级别总能通过级别检查）时退回到stdout，不丢日志
+    if (!logger.shouldLog(LogLevel::FATAL)) {
+        fwrite(msg, 1, len, stdout);
+        return;
+    }
+    // 无法识别级别的行按INFO写出
+    LogLevel level = LogLevel::INFO;
+    levelOf(msg, len, level);
+    // muduo的行以换行结尾，Logger写出时自己补换行
+    while (len > 0 && (msg[len - 1] == '\n' || msg[len - 1] == '\r')) {
+        len--;
+    }
+    logger.logFormatted(level, msg, len);
+}
+
+void MuduoLogBridge::flush() {
+    // muduo在FATAL之后调用，随后abort
+    if (::Logger::getInstance().shouldLog(LogLevel::FATAL)) {
+        ::Logger::getInstance().flush();
+    } else {
+        fflush(stdout);
+    }
+}
@@ -0,0 +1,158 @@
+#include "server/common/Tracer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static thread_local uint64_t t_currentTrace = 0;
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+    std::random_device random;
+    idPrefix_ = (static_cast<uint64_t>(random()) << 32) ^ (static_cast<uint64_t>(::getpid()) << 40);
+}
+
+uint64_t Tracer::sample() {
+    uint32_t every = sampleEvery();
+    if (every == 0 || sampleCounter_.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+        return 0;
+    }
+    // 低32位为进程内序号，高位为进程随机前缀；0保留为"不追踪"
+    uint64_t id = idPrefix_ ^ (idCounter_.fetch_add(1, std::memory_order_relaxed) + 1);
+    return id != 0 ? id : 1;
+}
+
+void Tracer::record(uint64_t traceId, const char* name, int64_t arg, uint64_t startUs, uint64_t durationUs) {
+    uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[index & mask_];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.traceId.store(traceId, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    slot.startUs.store(startUs, std::memory_order_relaxed);
+    slot.durationUs.store(durationUs, std::memory_order_relaxed);
+    slot.tid.store(currentTid(), std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+size_t Tracer::size() const {
+    uint64_t written = next_.load(std::memory_order_relaxed);
+    return static_cast<size_t>(std::min<uint64_t>(written, mask_ + 1));
+}
+
+std::string Tracer::exportChromeJson() const {
+    struct Span {
+        uint64_t traceId;
+        const char* name;
+        int64_t arg;
+        uint64_t startUs;
+        uint64_t durationUs;
+        uint32_t tid;
+    };
+    std::vector<Span> spans;
+    spans.reserve(size());
+    for (size_t i = 0; i <= mask_; i++) {
+        const Slot& slot = slots_[i];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before == 0 || before % 2 != 0) {
+            continue;
+        }
+        Span span;
+        span.traceId = slot.traceId.load(std::memory_order_relaxed);
+        span.name = slot.name.load(std::memory_order_relaxed);
+        span.arg = slot.arg.load(std::memory_order_relaxed);
+        span.startUs = slot.startUs.load(std::memory_order_relaxed);
+        span.durationUs = slot.durationUs.load(std::memory_order_relaxed);
+        span.tid = slot.tid.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // 读取期间被覆盖的槽位丢弃
+        if (slot.sequence.load(std::memory_order_relaxed) != before || span.name == nullptr) {
+            continue;
+        }
+        spans.push_back(span);
+    }
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.startUs < b.startUs; });
+
+    // 阶段名都是代码中的字面量，不需要转义
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    int pid = static_cast<int>(::getpid());
+    char line[256];
+    for (size_t i = 0; i < spans.size(); i++) {
+        const Span& s = spans[i];
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\":\"%s\",\"cat\":\"chat\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%u,"
+                 "\"args\":{\"trace\":\"%s\",\"arg\":%lld}}",
+                 i == 0 ? "" : ",", s.name, static_cast<unsigned long long>(s.startUs),
+                 static_cast<unsigned long long>(s.durationUs), pid, s.tid,
+                 idToString(s.traceId).c_str(), static_cast<long long>(s.arg));
+        out += line;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+uint64_t Tracer::current() {
+    return t_currentTrace;
+}
+
+uint64_t Tracer::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string Tracer::idToString(uint64_t id) {
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(id));
+    return text;
+}
+
+uint64_t Tracer::idFromString(const std::string& text) {
+    if (text.empty() || text.size() > 16) {
+        return 0;
+    }
+    uint64_t id = 0;
+    for (char c : text) {
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return 0;
+        }
+        id = (id << 4) | static_cast<uint64_t>(digit);
+    }
+    return id;
+}
+
+uint32_t Tracer::currentTid() {
+    static thread_local uint32_t tid = 0;
+    if (tid == 0) {
+        tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+    }
+    return tid;
+}
+
+TraceScope::TraceScope(uint64_t traceId) : previous_(t_currentTrace) {
+    t_currentTrace = traceId;
+}
+
+TraceScope::~TraceScope() {
+    t_currentTrace = previous_;
+}
@@ -0,0 +1,265 @@
+#include "BatchInsertWriter.h"
+#include "ConnectionPoolManager.h"
+#include "common/Logger.hpp"
+#include <memory>
+
+// 单条多行insert语句的最大长度，需小于服务端max_allowed_packet
+static const size_t kMaxStatementBytes = 1024 * 1024;
+
+BatchInsertWriter* BatchInsertWriter::getInstance()
+{
+    static BatchInsertWriter writer;
+    return &writer;
+}
+
+BatchInsertWriter::BatchInsertWriter()
+{
+    // 先构造连接池管理器，保证进程退出时它晚于本对象析构，析构中的最后一次刷出仍可用
+    ConnectionPoolManager::getInstance();
+    worker = thread(std::bind(&BatchInsertWriter::flushTask, this));
+}
+
+BatchInsertWriter::~BatchInsertWriter()
+{
+    shutdown();
+}
+
+future<bool> BatchInsertWriter::append(int shard, const string& table, const string& columns, string row)
+{
+    vector<string> rows;
+    rows.push_back(std::move(row));
+    return std::move(append(shard, table, columns, std::move(rows))[0]);
+}
+
+void BatchInsertWriter::append(int shard, const string& table, const string& columns, string row, Ack done)
+{
+    vector<string> rows;
+    rows.push_back(std::move(row));
+    vector<Ack> acks;
+    acks.push_back(std::move(done));
+    appendRows(shard, table, columns, std::move(rows), std::move(acks));
+}
+
+vector<future<bool>> BatchInsertWriter::append(int shard, const string& table, const string& columns, vector<string> rows)
+{
+    vector<future<bool>> futures;
+    vector<Ack> acks;
+    futures.reserve(rows.size());
+    acks.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        auto ack = make_shared<promise<bool>>();
+        futures.push_back(ack->get_future());
+        acks.push_back([ack](bool ok) { ack->set_value(ok); });
+    }
+    appendRows(shard, table, columns, std::move(rows), std::move(acks));
+    return futures;
+}
+
+void BatchInsertWriter::appendRows(int shard, const string& table, const string& columns, vector<string> rows, vector<Ack> acks)
+{
+    unique_lock<mutex> lock(batchMutex);
+    if (stopped)
+    {
+        // 后台线程已停止（进程退出阶段），直接同步写入
+        lock.unlock();
+        Batch batch;
+        batch.shard = shard;
+        batch.table = table;
+        batch.columns = columns;
+        batch.rows = std::move(rows);
+        batch.acks = std::move(acks);
+        writeBatch(batch);
+        return;
+    }
+
+    string key = to_string(shard) + "|" + table + "|" + columns;
+    Batch& batch = batches[key];
+    if (batch.rows.empty())
+    {
+        batch.shard = shard;
+        batch.table = table;
+        batch.columns = columns;
+        batch.firstAt = chrono::steady_clock::now();
+    }
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        batch.rows.push_back(std::move(rows[i]));
+        batch.acks.push_back(std::move(acks[i]));
+    }
+    bool full = batch.rows.size() >= maxRows;
+    lock.unlock();
+
+    if (full)
+    {
+        cv.notify_one();
+    }
+}
+
+void BatchInsertWriter::flush()
+{
+    unique_lock<mutex> lock(batchMutex);
+    if (stopped)
+    {
+        return;
+    }
+    unsigned long long generation = flushGeneration;
+    flushRequested = true;
+    cv.notify_one();
+    flushedCv.wait(lock, [this, generation]() { return flushGeneration > generation || stopped; });
+}
+
+void BatchInsertWriter::setFlushPolicy(size_t maxRows, int maxDelayMs)
+{
+    lock_guard<mutex> lock(batchMutex);
+    this->maxRows = maxRows > 0 ? maxRows : 1;
+    this->maxDelay = chrono::milliseconds(maxDelayMs > 0 ? maxDelayMs : 0);
+    cv.notify_one();
+}
+
+void BatchInsertWriter::shutdown()
+{
+    {
+        lock_guard<mutex> lock(batchMutex);
+        if (stopped)
+        {
+            return;
+        }
+        stopped = true;
+    }
+    cv.notify_one();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void BatchInsertWriter::flushTask()
+{
+    unique_lock<mutex> lock(batchMutex);
+    while (true)
+    {
+        bool force = flushRequested || stopped;
+        vector<Batch> ready = takeReadyLocked(force);
+        if (ready.empty() && !force)
+        {
+            if (batches.empty())
+            {
+                cv.wait(lock);
+            }
+            else
+            {
+                cv.wait_until(lock, nextDeadlineLocked());
+            }
+            continue;
+        }
+        flushRequested = false;
+
+        // 在锁外执行SQL，写入期间新的行继续进入缓冲
+        lock.unlock();
+        for (Batch& batch : ready)
+        {
+            writeBatch(batch);
+        }
+        lock.lock();
+
+        if (force)
+        {
+            flushGeneration++;
+            flushedCv.notify_all();
+            if (stopped && batches.empty())
+            {
+                break;
+            }
+        }
+    }
+}
+
+vector<BatchInsertWriter::Batch> BatchInsertWriter::takeReadyLocked(bool force)
+{
+    vector<Batch> ready;
+    auto now = chrono::steady_clock::now();
+    for (auto it = batches.begin(); it != batches.end();)
+    {
+        Batch& batch = it->second;
+        if (force || batch.rows.size() >= maxRows || now - batch.firstAt >= maxDelay)
+        {
+            ready.push_back(std::move(batch));
+            it = batches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return ready;
+}
+
+chrono::steady_clock::time_point BatchInsertWriter::nextDeadlineLocked() const
+{
+    auto deadline = chrono::steady_clock::time_point::max();
+    for (const auto& entry : batches)
+    {
+        auto due = entry.second.firstAt + maxDelay;
+        if (due < deadline)
+        {
+            deadline = due;
+        }
+    }
+    return deadline;
+}
+
+// 确认一行的写入结果，未设置回调的行不需要确认
+static void complete(BatchInsertWriter::Ack& ack, bool ok)
+{
+    if (ack)
+    {
+        ack(ok);
+    }
+}
+
+void BatchInsertWriter::writeBatch(Batch& batch)
+{
+    auto poolManager = ConnectionPoolManager::getInstance();
+    string prefix = "insert into " + batch.table + "(" + batch.columns + ") values ";
+
+    size_t begin = 0;
+    while (begin < batch.rows.size())
+    {
+        // 按语句长度切分
+        string sql = prefix;
+        size_t end = begin;
+        while (end < batch.rows.size()
+               && (end == begin || sql.size() + batch.rows[end].size() + 3 <= kMaxStatementBytes))
+        {
+            if (end > begin)
+            {
+                sql += ",";
+            }
+            sql += "(" + batch.rows[end] + ")";
+            end++;
+        }
+
+        if (poolManager->updateOn(batch.shard, sql))
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                complete(batch.acks[i], true);
+            }
+        }
+        else if (end - begin == 1)
+        {
+            complete(batch.acks[begin], false);
+        }
+        else
+        {
+            // 多行语句失败（例如其中一行主键冲突），逐行重试以免牵连其他行
+            CHAT_LOG_ERROR_F("Batch insert into %s failed, retrying %zu rows one by one", batch.table.c_str(), end - begin);
+            for (size_t i = begin; i < end; i++)
+            {
+                complete(batch.acks[i], poolManager->updateOn(batch.shard, prefix + "(" + batch.rows[i] + ")"));
+            }
+        }
+        begin = end;
+    }
+}
@@ -7,35 +7,46 @@
 #include <thread>
 #include "pch.h"
 #include "CommonconnectionPool.h"
+#include <muduo/base/Logging.h>
+#include "common/Logger.hpp"
 using namespace std;
 
-// 添加 LOG 宏定义（如果没有在其他地方定义）
-#ifndef LOG
-#define LOG(msg) std::cout << msg << std::endl
-#endif
-
 /*
 实现连接池功能
 */
-//线程安全的懒汉模式
-ConnectionPool* ConnectionPool::getConnectionPool()
-{
-    static ConnectionPool connPool; //lock
-    return &connPool;
-}
-bool ConnectionPool::LoadConfigFile()
+bool ConnectionPool::LoadConfigFile(const string& file, vector<PoolConfig>& configs)
 {
-    FILE* pf = fopen("mysql.ini", "r");
+    FILE* pf = fopen(file.c_str(), "r");
     if(pf == nullptr)
     {
-        LOG("mysql.ini file is not exist!");
+        LOG_ERROR << file + " file is not exist!";
         return false;
     }
+    // 全局配置（无段名部分）即为主库配置，后续各段以它为模板覆盖
+    configs.clear();
+    configs.push_back(PoolConfig());
+    PoolConfig* current = &configs[0];
     while(!feof(pf))
     {
         char line[1024] = {0};
         fgets(line, 1024, pf);
         string str = line;
+        // [name] 开始一个新的连接池段
+        size_t lb = str.find_first_not_of(" \t");
+        if(lb != string::npos && str[lb] == '[')
+        {
+            size_t rb = str.find("]", lb);
+            if(rb == string::npos)
+            {
+                continue;
+            }
+            PoolConfig section = configs[0];
+            section.name = str.substr(lb + 1, rb - lb - 1);
+            section.role = "replica";
+            configs.push_back(section);
+            current = &configs.back();
+            continue;
+        }
         int idx = str.find("=", 0);
         if(idx == -1)
         {
@@ -49,78 +60,100 @@ bool ConnectionPool::LoadConfigFile()
         key.erase(0, key.find_first_not_of(" \t"));
         key.erase(key.find_last_not_of(" \t") + 1);
         val.erase(0, val.find_first_not_of(" \t"));
-        val.erase(val.find_last_not_of(" \t") + 1);
+        val.erase(val.find_last_not_of(" \t\r") + 1);
         if(key == "ip")
         {
-            ip = val;
+            current->ip = val;
         }
         else if(key == "port")
         {
-            port = atoi(val.c_str());
+            current->port = atoi(val.c_str());
         }
         else if(key == "user")
         {
-            username = val;
+            current->username = val;
         }
         else if(key == "password")
         {
-            password = val;
+            current->password = val;
         }
         else if(key == "dbname")
         {
-            dbname = val;
+            current->dbname = val;
         }
         else if(key == "initsize")
         {
-            initSize = atoi(val.c_str());
+            current->initSize = atoi(val.c_str());
         }
         else if(key == "maxsize")
         {
-            maxSize = atoi(val.c_str());
+            current->maxSize = atoi(val.c_str());
         }
         else if(key == "maxIdletime")
         {
-            maxIdleTime = atoi(val.c_str());
+            current->maxIdleTime = atoi(val.c_str());
         }
         else if(key == "connectiontimeout")
         {
-            connectionTimeout = atoi(val.c_str());
-        }   
+            current->connectionTimeout = atoi(val.c_str());
+        }
+        else if(key == "role")
+        {
+            current->role = val;
+        }
+        else if(key == "maxreplicalag")
+        {
+            current->maxReplicaLag = atoi(val.c_str());
+        }
+        else if(key == "shard")
+        {
+            current->shard = atoi(val.c_str());
+        }
     }
     fclose(pf);
     return true;
 }
-ConnectionPool::ConnectionPool()//线程池构造
+ConnectionPool::ConnectionPool(const PoolConfig& config)//线程池构造
+    : name(config.name)
+    , role(config.role)
+    , ip(config.ip)
+    , port(config.port)
+    , username(config.username)
+    , password(config.password)
+    , dbname(config.dbname)
+    , initSize(config.initSize)
+    , maxSize(config.maxSize)
+    , maxIdleTime(config.maxIdleTime)
+    , connectionTimeout(config.connectionTimeout)
+    , maxReplicaLag(config.maxReplicaLag)
+    , shard(config.shard)
 {
-    LOG("ConnectionPool constructor started");
-    //加载配置文件
-    if(!LoadConfigFile())
-    {
-        LOG("LoadConfigFile() fail!");
-        return;
-    }
-    LOG("Config loaded successfully. initSize=" + to_string(initSize) + ", maxSize=" + to_string(maxSize));
+    LOG_INFO << "ConnectionPool [" + name + "] " + ip + ":" + to_string(port) + " shard=" + to_string(shard) + " role=" + role
+        + " initSize=" + to_string(initSize) + ", maxSize=" + to_string(maxSize);
     //创建初始数量的连接
     int successfulConnections = 0;
     for(int i = 0; i < initSize; i++)
     {
         Connection* p = new Connection();
         if (p->connect(ip, port, username, password, dbname)) {
+            p->setStats(&stats);
             p->refreshAliveTime();//刷新一下开始空闲的起始时间
             connectionQue.push(p);
             connectionCnt++;
             successfulConnections++;
+            stats.creates++;
         } else {
-            LOG("Failed to create initial connection " + to_string(i) + ": " + mysql_error(p->getConnection()));
+            LOG_ERROR << "Failed to create initial connection " + to_string(i) + ": " + mysql_error(p->getConnection());
+            stats.createFailures++;
             delete p;
         }
     }
     
-    LOG("Successfully created " + to_string(successfulConnections) + "/" + to_string(initSize) + " initial connections");
+    LOG_INFO << "Successfully created " + to_string(successfulConnections) + "/" + to_string(initSize) + " initial connections";
     
     // 如果没有成功创建任何连接，这是一个严重问题
     if (successfulConnections == 0) {
-        LOG("CRITICAL: No initial connections could be created! Check database configuration.");
+        LOG_ERROR << "CRITICAL: No initial connections could be created! Check database configuration.";
     }
     //启动一个新的线程，作为连接的生产者
     thread produce(std::bind(&ConnectionPool::produceConnectionTask, this));
@@ -135,7 +168,7 @@ void ConnectionPool::produceConnectionTask()
 {
     while(true)
     {
-        unique_lock<mutex> lock(queMutex);
+        unique_lock<InstrumentedMutex> lock(CHAT_LOCK_SITE(queMutex));
         
         // 等待条件：队列为空且连接数未达到上限
         cv.wait(lock, [this]() {
@@ -150,15 +183,19 @@ void ConnectionPool::produceConnectionTask()
             Connection* p = new Connection();
             bool connected = p->connect(ip, port, username, password, dbname);
             
+            CHAT_LOCK_SITE(queMutex);
             lock.lock();
             if (connected && connectionCnt < maxSize) {
+                p->setStats(&stats);
                 p->refreshAliveTime();//刷新一下开始空闲的起始时间
                 connectionQue.push(p);
                 connectionCnt++;
+                stats.creates++;
                 cv.notify_all();//通知消费者线程，可以消费连接了
             } else {
                 if (!connected) {
-                    LOG("Failed to create new connection in producer");
+                    CHAT_LOG_ERROR("Failed to create new connection in producer");
+                    stats.createFailures++;
                 }
                 delete p;
             }
@@ -167,8 +204,8 @@ void ConnectionPool::produceConnectionTask()
 }
 shared_ptr<Connection> ConnectionPool::getConnection()
 {
-    unique_lock<mutex> lock(queMutex);
-    static int timeout_count = 0;  // 添加静态计数器
+    auto waitStart = PoolStats::Clock::now();
+    unique_lock<InstrumentedMutex> lock(CHAT_LOCK_SITE(queMutex));
     
     while(connectionQue.empty())
     {
@@ -176,10 +213,11 @@ shared_ptr<Connection> ConnectionPool::getConnection()
         {
             if(connectionQue.empty())
             {
-                timeout_count++;
-                // 只在每100次超时时输出一次日志，或者完全注释掉
-                if (timeout_count % 100 == 0) {
-                    LOG("连接超时次数: " + to_string(timeout_count));
+                uint64_t timeoutCount = ++stats.timeouts;
+                stats.waitTime.record(PoolStats::elapsedMicros(waitStart));
+                // 只在每100次超时时输出一次日志，详细数据见统计信息
+                if (timeoutCount % 100 == 0) {
+                    CHAT_LOG_WARN_F("连接超时次数: %d", static_cast<int>(timeoutCount));
                 }
                 return nullptr;
             }
@@ -191,22 +229,33 @@ shared_ptr<Connection> ConnectionPool::getConnection()
     
     // 检查连接有效性，如果无效则重新创建
     if (!conn->isValid()) {
-        LOG("Connection is invalid, recreating...");
+        CHAT_LOG_WARN("Connection is invalid, recreating...");
+        stats.validationFailures++;
+        stats.destroys++;
         delete conn;
         conn = new Connection();
         if (!conn->connect(ip, port, username, password, dbname)) {
-            LOG("Failed to recreate connection");
+            CHAT_LOG_ERROR("Failed to recreate connection");
+            stats.createFailures++;
             delete conn;
+            connectionCnt--;
             cv.notify_all();
             return nullptr;
         }
+        conn->setStats(&stats);
+        stats.creates++;
     }
     
+    stats.waitTime.record(PoolStats::elapsedMicros(waitStart));
+    stats.checkouts++;
+    conn->markCheckout();
+    
     shared_ptr<Connection> sp(conn,
         [this](Connection* pcon)
         {
             // 这里是连接的归还逻辑
-            lock_guard<mutex> lock(queMutex);
+            stats.holdTime.record(PoolStats::elapsedMicros(pcon->getCheckoutTime()));
+            lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(queMutex));
             pcon->refreshAliveTime();//刷新一下开始空闲的起始时间
             connectionQue.push(pcon);
             cv.notify_all(); // 通知等待连接的线程
@@ -216,6 +265,15 @@ shared_ptr<Connection> ConnectionPool::getConnection()
     cv.notify_all();//消费完连接后，通知生产者线程，可以生产连接了
     return sp;
 }
+string ConnectionPool::dumpStats()
+{
+    size_t idle;
+    {
+        lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(queMutex));
+        idle = connectionQue.size();
+    }
+    return stats.dump(name + " " + ip + ":" + to_string(port), idle, connectionCnt);
+}
 void ConnectionPool::scannerConnectionTask()
 {
     while(true)
@@ -228,7 +286,7 @@ void ConnectionPool::scannerConnectionTask()
         
         {
             //扫描整个队列，收集多余的连接
-            lock_guard<mutex> lock(queMutex);
+            lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(queMutex));
             while(connectionCnt > initSize && !connectionQue.empty())
             {
                 Connection* p = connectionQue.front();
@@ -249,5 +307,6 @@ void ConnectionPool::scannerConnectionTask()
         for(Connection* conn : connectionsToDelete) {
             delete conn;
         }
+        stats.destroys += connectionsToDelete.size();
     }   
 }
\ No newline at end of file
@@ -1,19 +1,28 @@
 
 #include "pch.h"
 #include "Connection.h"
+#include "common/Metrics.hpp"
+#include "common/FlightRecorder.hpp"
+#include "common/Logger.hpp"
+
+//所有连接（直连和连接池）共用的SQL耗时直方图，按update/query区分
+static HdrHistogram &dbLatency(const char *op)
+{
+    return MetricsRegistry::instance().histogram("chat_db_latency_microseconds",
+        "MySQL statement latency including result transfer", MetricsRegistry::label("op", op));
+}
 
 Connection::Connection()
 {
     this->conn = mysql_init(nullptr);
     if (this->conn == nullptr) {
-        cout << "mysql_init failed!" << endl;
+        CHAT_LOG_ERROR("mysql_init failed!");
     }
-    cout << "Connection()" << endl;
 }
 
 Connection::~Connection()
 {
-    lock_guard<mutex> lock(conn_mutex);
+    lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(conn_mutex));
     if(this->conn != nullptr)
     {
         // 清理任何未处理的结果
@@ -24,7 +33,6 @@ Connection::~Connection()
         mysql_close(this->conn);
         this->conn = nullptr;
     }
-    cout << "~Connection()" << endl;
 }
 
 bool Connection::connect(string ip,unsigned short port,string user,string password,string dbname)
@@ -44,8 +52,8 @@ bool Connection::connect(string ip,unsigned short port,string user,string passwo
     
     MYSQL *p = mysql_real_connect(this->conn,ip.c_str(),user.c_str(),password.c_str(),dbname.c_str(),port,nullptr,0);
     if (p == nullptr) {
-        cout << "MySQL connection failed: " << mysql_error(this->conn) << endl;
-        cout << "Connection params: ip=" << ip << ", port=" << port << ", user=" << user << ", dbname=" << dbname << endl;
+        CHAT_LOG_ERROR_F("MySQL connection failed: %s, ip=%s, port=%u, user=%s, dbname=%s", mysql_error(this->conn),
+                         ip.c_str(), static_cast<unsigned>(port), user.c_str(), dbname.c_str());
         return false;
     }
     
@@ -57,11 +65,11 @@ bool Connection::connect(string ip,unsigned short port,string user,string passwo
 
 bool Connection::update(string sql)
 {
-    std::lock_guard<std::mutex> lock(conn_mutex);
+    std::lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(conn_mutex));
     
-    // 检查连接是否有效
-    if (!isValid()) {
-        cout << "Connection is invalid" << endl;
+    // 检查连接是否有效（此处已持有conn_mutex，不能再调用isValid）
+    if (!pingLocked()) {
+        CHAT_LOG_ERROR("Connection is invalid");
         return false;
     }
     
@@ -71,21 +79,30 @@ bool Connection::update(string sql)
         if (result) mysql_free_result(result);
     }
     
+    auto start = PoolStats::Clock::now();
+    FlightRecorder::record(FlightEvent::DB_QUERY_START, 0);
     if(mysql_query(this->conn,sql.c_str())!=0)
     {
-        cout<<"update error:"<<mysql_error(this->conn)<<endl;
+        FlightRecorder::record(FlightEvent::DB_QUERY_END, 0, 0);
+        if (stats) stats->queryFailures++;
+        CHAT_LOG_ERROR_F("update error:%s", mysql_error(this->conn));
         return false;
     }
+    FlightRecorder::record(FlightEvent::DB_QUERY_END, 0, 1);
+    static HdrHistogram &latency = dbLatency("update");
+    int64_t elapsed = PoolStats::elapsedMicros(start);
+    latency.record(elapsed);
+    if (stats) stats->queryTime.record(elapsed);
     return true;
 }
 
 MYSQL_RES* Connection::query(string sql)
 {
-    std::lock_guard<std::mutex> lock(conn_mutex);
+    std::lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(conn_mutex));
     
-    // 检查连接是否有效
-    if (!isValid()) {
-        cout << "Connection is invalid" << endl;
+    // 检查连接是否有效（此处已持有conn_mutex，不能再调用isValid）
+    if (!pingLocked()) {
+        CHAT_LOG_ERROR("Connection is invalid");
         return nullptr;
     }
     
@@ -95,18 +112,33 @@ MYSQL_RES* Connection::query(string sql)
         if (result) mysql_free_result(result);
     }
     
+    auto start = PoolStats::Clock::now();
+    FlightRecorder::record(FlightEvent::DB_QUERY_START, 1);
     if(mysql_query(this->conn,sql.c_str())!=0)
     {
-        cout<<"query error:"<<mysql_error(this->conn)<<endl;
+        FlightRecorder::record(FlightEvent::DB_QUERY_END, 1, 0);
+        if (stats) stats->queryFailures++;
+        CHAT_LOG_ERROR_F("query error:%s", mysql_error(this->conn));
         return nullptr;
     }
     // 使用mysql_store_result而不是mysql_use_result来避免"Commands out of sync"错误
     // mysql_store_result会立即获取所有结果，而mysql_use_result需要逐行读取
-    return mysql_store_result(this->conn);
+    MYSQL_RES* res = mysql_store_result(this->conn);
+    FlightRecorder::record(FlightEvent::DB_QUERY_END, 1, 1);
+    // 查询耗时包含结果集的传输
+    static HdrHistogram &latency = dbLatency("query");
+    int64_t elapsed = PoolStats::elapsedMicros(start);
+    latency.record(elapsed);
+    if (stats) stats->queryTime.record(elapsed);
+    return res;
 }
 
 bool Connection::isValid() {
-    lock_guard<mutex> lock(conn_mutex);
+    lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(conn_mutex));
+    return pingLocked();
+}
+
+bool Connection::pingLocked() {
     if (conn == nullptr) {
         return false;
     }
@@ -114,7 +146,7 @@ bool Connection::isValid() {
     // 使用mysql_ping检查连接是否有效
     int ping_result = mysql_ping(conn);
     if (ping_result != 0) {
-        cout << "Connection ping failed: " << mysql_error(conn) << endl;
+        CHAT_LOG_WARN_F("Connection ping failed: %s", mysql_error(conn));
         return false;
     }
     return true;
@@ -123,3 +155,8 @@ bool Connection::isValid() {
 MYSQL* Connection::getConnection() {
     return conn;
 }
+
+unsigned long long Connection::getInsertId() {
+    lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(conn_mutex));
+    return conn == nullptr ? 0 : mysql_insert_id(conn);
+}
@@ -1,67 +1,365 @@
 #include "ConnectionPoolManager.h"
 #include "CommonconnectionPool.h"
+#include "db.h"
 #include <muduo/base/Logging.h>
+#include "common/Logger.hpp"
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <algorithm>
+
+// 从库复制延迟的探测周期(秒)
+static const int kReplicaLagCheckInterval = 1;
 
 ConnectionPoolManager* ConnectionPoolManager::getInstance() {
     static ConnectionPoolManager instance;
     return &instance;
 }
 
+ConnectionPoolManager::~ConnectionPoolManager() = default;
+
 bool ConnectionPoolManager::init(const std::string& configFile) {
     if (initialized) {
         return true;
     }
-    
+
     try {
-        pool = ConnectionPool::getConnectionPool();
-        if (pool != nullptr) {
-            initialized = true;
-            LOG_INFO << "ConnectionPool initialized successfully!";
-            return true;
+        std::vector<PoolConfig> configs;
+        if (!ConnectionPool::LoadConfigFile(configFile, configs)) {
+            LOG_ERROR << "Failed to load " << configFile << ", falling back to direct connections";
+            return false;
+        }
+        int shardTotal = 1;
+        for (const PoolConfig& config : configs) {
+            if (config.shard < 0) {
+                LOG_ERROR << "Invalid shard " << config.shard << " for pool [" << config.name << "]";
+                return false;
+            }
+            shardTotal = std::max(shardTotal, config.shard + 1);
+        }
+        for (int i = 0; i < shardTotal; i++) {
+            shards.emplace_back(new Shard());
+        }
+        for (const PoolConfig& config : configs) {
+            pools.emplace_back(new ConnectionPool(config));
+            ConnectionPool* p = pools.back().get();
+            Shard& shard = *shards[config.shard];
+            if (p->isReplica()) {
+                std::unique_ptr<Replica> replica(new Replica());
+                replica->pool = p;
+                shard.replicas.push_back(std::move(replica));
+            } else if (shard.primary == nullptr) {
+                shard.primary = p;
+            } else {
+                LOG_ERROR << "Duplicate primary pool [" << config.name << "] ignored for routing";
+            }
+        }
+        for (int i = 0; i < shardTotal; i++) {
+            if (shards[i]->primary == nullptr) {
+                LOG_ERROR << "No primary pool configured for shard " << i << " in " << configFile;
+                shards.clear();
+                return false;
+            }
         }
+        shardMap.setShardCount(shardTotal);
+        initialized = true;
+        LOG_INFO << "ConnectionPool initialized successfully! shards=" << shardTotal
+                 << " pools=" << pools.size();
+
+        bool hasReplica = false;
+        for (auto& shard : shards) {
+            hasReplica = hasReplica || !shard->replicas.empty();
+        }
+        if (hasReplica) {
+            std::thread monitor(std::bind(&ConnectionPoolManager::replicaLagMonitorTask, this));
+            monitor.detach();
+        }
+        return true;
     } catch (const std::exception& e) {
         LOG_ERROR << "Failed to initialize ConnectionPool: " << e.what();
     }
-    
+
     return false;
 }
 
-bool ConnectionPoolManager::update(const std::string& sql) {
+bool ConnectionPoolManager::update(const std::string& sql, unsigned long long* insertId) {
+    return updateOn(0, sql, insertId);
+}
+
+MYSQL_RES* ConnectionPoolManager::query(const std::string& sql) {
+    return queryOn(0, sql);
+}
+
+MYSQL_RES* ConnectionPoolManager::queryReplica(const std::string& sql) {
+    return queryReplicaOn(0, sql);
+}
+
+bool ConnectionPoolManager::updateOn(int shard, const std::string& sql, unsigned long long* insertId) {
     if (!initialized) {
-        LOG_ERROR << "ConnectionPool not initialized!";
-        return false;
+        return updateDirect(sql, insertId);
     }
-    
-    auto conn = pool->getConnection();
+
+    auto conn = shards[shard]->primary->getConnection();
     if (conn == nullptr) {
         // 注释掉或减少日志输出
         // LOG_ERROR << "Failed to get connection from pool!";
         return false;
     }
-    
+
     bool result = conn->update(sql);
     if (!result) {
-        LOG_ERROR << "SQL update failed: " << sql;
+        CHAT_LOG_ERROR_F("SQL update failed: %s", sql.c_str());
+    } else if (insertId != nullptr) {
+        // 必须在连接归还之前读取，否则可能被其他线程的insert覆盖
+        *insertId = conn->getInsertId();
     }
-    
+
     return result;
 }
 
-MYSQL_RES* ConnectionPoolManager::query(const std::string& sql) {
+MYSQL_RES* ConnectionPoolManager::queryOn(int shard, const std::string& sql) {
     if (!initialized) {
-        LOG_ERROR << "ConnectionPool not initialized!";
-        return nullptr;
+        return queryDirect(sql);
+    }
+    return queryPool(shards[shard]->primary, sql);
+}
+
+MYSQL_RES* ConnectionPoolManager::queryReplicaOn(int shard, const std::string& sql) {
+    if (!initialized) {
+        return queryDirect(sql);
+    }
+
+    Shard& target = *shards[shard];
+    size_t n = target.replicas.size();
+    unsigned int start = target.replicaCursor.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+        Replica& replica = *target.replicas[(start + i) % n];
+        int lag = replica.lagSeconds.load(std::memory_order_relaxed);
+        if (lag < 0 || lag > replica.pool->getMaxReplicaLag()) {
+            continue;
+        }
+        auto conn = replica.pool->getConnection();
+        if (conn == nullptr) {
+            continue;
+        }
+        MYSQL_RES* result = conn->query(sql);
+        if (result != nullptr) {
+            return result;
+        }
+        CHAT_LOG_ERROR_F("SQL query failed on replica [%s]: %s", replica.pool->getName().c_str(), sql.c_str());
+    }
+
+    // 没有健康的从库，回落到主库
+    return queryPool(target.primary, sql);
+}
+
+std::vector<MYSQL_RES*> ConnectionPoolManager::scatterQuery(const std::vector<std::string>& sqls, bool useReplica) {
+    std::vector<MYSQL_RES*> results(sqls.size(), nullptr);
+    auto runOne = [this, &sqls, useReplica](size_t shard) -> MYSQL_RES* {
+        return useReplica ? queryReplicaOn(shard, sqls[shard]) : queryOn(shard, sqls[shard]);
+    };
+
+    // 只涉及一个分片时直接在当前线程执行
+    std::vector<size_t> targets;
+    for (size_t i = 0; i < sqls.size() && i < static_cast<size_t>(shardCount()); i++) {
+        if (!sqls[i].empty()) {
+            targets.push_back(i);
+        }
+    }
+    if (targets.size() == 1) {
+        results[targets[0]] = runOne(targets[0]);
+        return results;
+    }
+
+    std::vector<std::future<MYSQL_RES*>> futures;
+    for (size_t shard : targets) {
+        futures.push_back(std::async(std::launch::async, runOne, shard));
+    }
+    for (size_t i = 0; i < targets.size(); i++) {
+        results[targets[i]] = futures[i].get();
+    }
+    return results;
+}
+
+bool ConnectionPoolManager::updateAll(const std::string& sql) {
+    bool ok = true;
+    for (int i = 0; i < shardCount(); i++) {
+        ok = updateOn(i, sql) && ok;
+    }
+    return ok;
+}
+
+bool ConnectionPoolManager::transactionOn(int shard, const std::function<bool(Transaction&)>& body) {
+    if (!initialized) {
+        MySQL mysql;
+        if (!mysql.connect()) {
+            return false;
+        }
+        return runTransaction(mysql.getConnection(), body);
     }
-    
-    auto conn = pool->getConnection();
+
+    // 连接借出期间只归当前线程使用，isValid顺带完成借出前的ping
+    auto conn = shards[shard]->primary->getConnection();
+    if (conn == nullptr || !conn->isValid()) {
+        return false;
+    }
+    return runTransaction(conn->getConnection(), body);
+}
+
+std::string ConnectionPoolManager::escape(const std::string& input) {
+    std::string out;
+    out.reserve(input.size() + 8);
+    for (char c : input) {
+        switch (c) {
+            case '\0':   out += "\\0"; break;
+            case '\n':   out += "\\n"; break;
+            case '\r':   out += "\\r"; break;
+            case '\\':  out += "\\\\"; break;
+            case '\'':   out += "\\'"; break;
+            case '"':    out += "\\\""; break;
+            case '\x1a': out += "\\Z"; break;
+            default:     out += c; break;
+        }
+    }
+    return out;
+}
+
+MYSQL_RES* ConnectionPoolManager::queryPool(ConnectionPool* target, const std::string& sql) {
+    auto conn = target->getConnection();
     if (conn == nullptr) {
         return nullptr;
     }
-    
+
     MYSQL_RES* result = conn->query(sql);
     if (result == nullptr) {
-        LOG_ERROR << "SQL query failed: " << sql;
+        CHAT_LOG_ERROR_F("SQL query failed: %s", sql.c_str());
     }
-    
+
     return result;
-}
\ No newline at end of file
+}
+
+bool ConnectionPoolManager::updateDirect(const std::string& sql, unsigned long long* insertId) {
+    MySQL mysql;
+    if (!mysql.connect() || !mysql.update(sql)) {
+        return false;
+    }
+    if (insertId != nullptr) {
+        *insertId = mysql_insert_id(mysql.getConnection());
+    }
+    return true;
+}
+
+MYSQL_RES* ConnectionPoolManager::queryDirect(const std::string& sql) {
+    MySQL mysql;
+    if (!mysql.connect()) {
+        return nullptr;
+    }
+    // 连接随函数返回而关闭，因此必须用store_result把结果一次性取回
+    if (mysql_query(mysql.getConnection(), sql.c_str()) != 0) {
+        CHAT_LOG_ERROR_F("SQL query failed: %s", sql.c_str());
+        return nullptr;
+    }
+    return mysql_store_result(mysql.getConnection());
+}
+
+bool ConnectionPoolManager::runTransaction(MYSQL* mysql, const std::function<bool(Transaction&)>& body) {
+    // 事务中途断线时自动重连会让后续语句落在新会话里以autocommit执行，因此事务期间关闭重连
+    bool noReconnect = false;
+    bool reconnect = true;
+    mysql_options(mysql, MYSQL_OPT_RECONNECT, &noReconnect);
+
+    Transaction txn;
+    txn.update = [mysql](const std::string& sql, unsigned long long* insertId) {
+        if (mysql_query(mysql, sql.c_str()) != 0) {
+            CHAT_LOG_ERROR_F("SQL update failed in transaction: %s %s", sql.c_str(), mysql_error(mysql));
+            return false;
+        }
+        if (insertId != nullptr) {
+            *insertId = mysql_insert_id(mysql);
+        }
+        return true;
+    };
+    txn.query = [mysql](const std::string& sql) -> MYSQL_RES* {
+        if (mysql_query(mysql, sql.c_str()) != 0) {
+            CHAT_LOG_ERROR_F("SQL query failed in transaction: %s %s", sql.c_str(), mysql_error(mysql));
+            return nullptr;
+        }
+        return mysql_store_result(mysql);
+    };
+
+    bool ok = mysql_query(mysql, "START TRANSACTION") == 0 && body(txn) &&
+              mysql_query(mysql, "COMMIT") == 0;
+    if (!ok) {
+        mysql_query(mysql, "ROLLBACK");
+    }
+    mysql_options(mysql, MYSQL_OPT_RECONNECT, &reconnect);
+    return ok;
+}
+
+void ConnectionPoolManager::replicaLagMonitorTask() {
+    while (true) {
+        for (auto& shard : shards) {
+            for (auto& replica : shard->replicas) {
+                int lag = probeReplicaLag(replica->pool);
+                int previous = replica->lagSeconds.exchange(lag);
+                bool healthy = lag >= 0 && lag <= replica->pool->getMaxReplicaLag();
+                bool wasHealthy = previous >= 0 && previous <= replica->pool->getMaxReplicaLag();
+                if (healthy != wasHealthy) {
+                    CHAT_LOG_INFO_F("Replica [%s] %s, lag=%d", replica->pool->getName().c_str(),
+                                    healthy ? "back in rotation" : "removed from rotation", lag);
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(kReplicaLagCheckInterval));
+    }
+}
+
+int ConnectionPoolManager::probeReplicaLag(ConnectionPool* replica) {
+    auto conn = replica->getConnection();
+    if (conn == nullptr) {
+        return -1;
+    }
+    MYSQL_RES* res = conn->query("SHOW SLAVE STATUS");
+    if (res == nullptr) {
+        return -1;
+    }
+    // 没有复制状态（例如指向的是独立实例），视为没有延迟
+    int lag = 0;
+    MYSQL_ROW row = mysql_fetch_row(res);
+    if (row != nullptr) {
+        lag = -1;
+        unsigned int fieldCount = mysql_num_fields(res);
+        MYSQL_FIELD* fields = mysql_fetch_fields(res);
+        for (unsigned int i = 0; i < fieldCount; i++) {
+            if (strcmp(fields[i].name, "Seconds_Behind_Master") == 0
+                || strcmp(fields[i].name, "Seconds_Behind_Source") == 0) {
+                // NULL表示复制线程未运行
+                lag = row[i] != nullptr ? atoi(row[i]) : -1;
+                break;
+            }
+        }
+    }
+    mysql_free_result(res);
+    return lag;
+}
+
+std::string ConnectionPoolManager::dumpStats() {
+    if (!initialized) {
+        return "ConnectionPool not initialized";
+    }
+    std::string report;
+    for (auto& p : pools) {
+        if (!report.empty()) {
+            report += "\n";
+        }
+        report += p->dumpStats();
+    }
+    for (auto& shard : shards) {
+        for (auto& replica : shard->replicas) {
+            report += "\n[replica " + replica->pool->getName() + "] lag="
+                    + std::to_string(replica->lagSeconds.load()) + "s";
+        }
+    }
+    return report;
+}
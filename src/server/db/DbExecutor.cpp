@@ -0,0 +1,111 @@
+#include "DbExecutor.h"
+#include "ConnectionPoolManager.h"
+#include <muduo/base/Logging.h>
+
+// DB线程数，查询阻塞在DB线程上而不是IO线程上；连接池的maxsize应不小于该值
+static const int kDbThreadNum = 8;
+// 队列上限，超过后直接拒绝，防止数据库变慢时请求无限积压
+static const size_t kMaxQueueSize = 10000;
+
+DbExecutor* DbExecutor::getInstance()
+{
+    static DbExecutor executor;
+    return &executor;
+}
+
+DbExecutor::DbExecutor()
+    : capacity(kMaxQueueSize)
+{
+    // 先构造连接池管理器，保证进程退出时它晚于本对象析构
+    ConnectionPoolManager::getInstance();
+    for (int i = 0; i < kDbThreadNum; i++)
+    {
+        workers.emplace_back(std::bind(&DbExecutor::workerTask, this));
+    }
+}
+
+DbExecutor::~DbExecutor()
+{
+    shutdown();
+}
+
+bool DbExecutor::enqueue(Job job)
+{
+    {
+        lock_guard<mutex> lock(jobMutex);
+        if (stopped || jobs.size() >= capacity)
+        {
+            rejected++;
+            return false;
+        }
+        jobs.push_back(std::move(job));
+    }
+    cv.notify_one();
+    return true;
+}
+
+void DbExecutor::shutdown()
+{
+    {
+        lock_guard<mutex> lock(jobMutex);
+        if (stopped)
+        {
+            return;
+        }
+        stopped = true;
+    }
+    cv.notify_all();
+    for (thread& worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+void DbExecutor::workerTask()
+{
+    while (true)
+    {
+        Job job;
+        {
+            unique_lock<mutex> lock(jobMutex);
+            cv.wait(lock, [this]() { return stopped || !jobs.empty(); });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        if (stopped || chrono::steady_clock::now() > job.queueDeadline)
+        {
+            timeouts++;
+            job.run(DbStatus::TIMEOUT);
+        }
+        else
+        {
+            executed++;
+            job.run(DbStatus::OK);
+        }
+    }
+}
+
+size_t DbExecutor::queueDepth()
+{
+    lock_guard<mutex> lock(jobMutex);
+    return jobs.size();
+}
+
+string DbExecutor::dumpStats()
+{
+    size_t queued = queueDepth();
+    return "[db executor] threads=" + to_string(workers.size())
+         + " queued=" + to_string(queued) + "/" + to_string(capacity)
+         + " executed=" + to_string(executed.load())
+         + " timeouts=" + to_string(timeouts.load())
+         + " rejected=" + to_string(rejected.load())
+         + " failures=" + to_string(failures.load());
+}
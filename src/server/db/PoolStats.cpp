@@ -0,0 +1,124 @@
+#include "PoolStats.h"
+#include <sstream>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(int64_t micros)
+{
+    if (micros <= 0)
+    {
+        return 0;
+    }
+    // 64 - clz 即为micros的二进制位数，位数为n的值落在[2^(n-1), 2^n)
+    int idx = 64 - __builtin_clzll(static_cast<uint64_t>(micros));
+    return idx < kBucketCount ? idx : kBucketCount - 1;
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int idx)
+{
+    return static_cast<int64_t>(1) << idx;
+}
+
+void LatencyHistogram::record(int64_t micros)
+{
+    if (micros < 0)
+    {
+        micros = 0;
+    }
+    buckets[bucketIndex(micros)].fetch_add(1, memory_order_relaxed);
+    totalCount.fetch_add(1, memory_order_relaxed);
+    totalSum.fetch_add(static_cast<uint64_t>(micros), memory_order_relaxed);
+
+    int64_t cur = maxValue.load(memory_order_relaxed);
+    while (micros > cur && !maxValue.compare_exchange_weak(cur, micros, memory_order_relaxed))
+    {
+    }
+}
+
+int64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (total == 0)
+    {
+        return 0;
+    }
+    // 需要累计到的样本数，至少为1
+    uint64_t target = static_cast<uint64_t>(total * p / 100.0 + 0.5);
+    if (target == 0)
+    {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++)
+    {
+        seen += bucketCount(i);
+        if (seen >= target)
+        {
+            // 桶上界不超过观测到的最大值，避免高分位被放大一倍
+            int64_t upper = bucketUpperBound(i);
+            int64_t maxSeen = max();
+            return upper < maxSeen ? upper : maxSeen;
+        }
+    }
+    return max();
+}
+
+string LatencyHistogram::summary() const
+{
+    uint64_t n = count();
+    ostringstream oss;
+    oss << "count=" << n
+        << " avg=" << (n == 0 ? 0 : sum() / n) << "us"
+        << " p50=" << percentile(50) << "us"
+        << " p90=" << percentile(90) << "us"
+        << " p99=" << percentile(99) << "us"
+        << " max=" << max() << "us";
+    return oss.str();
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < kBucketCount; i++)
+    {
+        buckets[i].store(0, memory_order_relaxed);
+    }
+    totalCount.store(0, memory_order_relaxed);
+    totalSum.store(0, memory_order_relaxed);
+    maxValue.store(0, memory_order_relaxed);
+}
+
+string PoolStats::dump(const string& poolName, size_t idle, int total) const
+{
+    ostringstream oss;
+    oss << "[pool " << poolName << "]"
+        << " total=" << total
+        << " idle=" << idle
+        << " checkouts=" << checkouts.load()
+        << " timeouts=" << timeouts.load()
+        << " creates=" << creates.load()
+        << " createFailures=" << createFailures.load()
+        << " destroys=" << destroys.load()
+        << " validationFailures=" << validationFailures.load()
+        << " queryFailures=" << queryFailures.load() << "\n"
+        << "  wait:  " << waitTime.summary() << "\n"
+        << "  hold:  " << holdTime.summary() << "\n"
+        << "  query: " << queryTime.summary();
+    return oss.str();
+}
+
+void PoolStats::reset()
+{
+    checkouts = 0;
+    timeouts = 0;
+    creates = 0;
+    createFailures = 0;
+    destroys = 0;
+    validationFailures = 0;
+    queryFailures = 0;
+    waitTime.reset();
+    holdTime.reset();
+    queryTime.reset();
+}
@@ -1,6 +1,7 @@
 #include "../../../include/server/db/SecureDB.hpp"
 #include "../../../include/public.hpp"
 #include <muduo/base/Logging.h>
+#include "../../../include/server/common/Logger.hpp"
 #include <cstring>
 
 // 数据库配置信息（应该从配置文件读取）
@@ -9,7 +10,7 @@ static string user = "root";
 static string password = "123456";
 static string dbname = "chat";
 
-SecureDB::SecureDB() : _conn(nullptr) {
+SecureDB::SecureDB() : _conn(nullptr), _lastErrno(0) {
     _conn = mysql_init(nullptr);
     if (_conn == nullptr) {
         LOG_ERROR << "Failed to initialize MySQL connection";
@@ -58,8 +59,9 @@ void SecureDB::close() {
 }
 
 bool SecureDB::executeUpdate(const string& sql, const vector<string>& params) {
+    _lastErrno = 0;
     if (_conn == nullptr) {
-        LOG_ERROR << "Database not connected";
+        CHAT_LOG_ERROR("Database not connected");
         return false;
     }
     
@@ -71,7 +73,7 @@ bool SecureDB::executeUpdate(const string& sql, const vector<string>& params) {
     
     // 预编译SQL语句
     if (mysql_stmt_prepare(stmt, sql.c_str(), sql.length()) != 0) {
-        LOG_ERROR << "Failed to prepare statement: " << mysql_stmt_error(stmt);
+        CHAT_LOG_ERROR_F("Failed to prepare statement: %s", mysql_stmt_error(stmt));
         mysql_stmt_close(stmt);
         return false;
     }
@@ -79,8 +81,7 @@ bool SecureDB::executeUpdate(const string& sql, const vector<string>& params) {
     // 检查参数数量
     unsigned long param_count = mysql_stmt_param_count(stmt);
     if (param_count != params.size()) {
-        LOG_ERROR << "Parameter count mismatch. Expected: " << param_count 
-                  << ", Got: " << params.size();
+        CHAT_LOG_ERROR_F("Parameter count mismatch. Expected: %lu, Got: %zu", param_count, params.size());
         mysql_stmt_close(stmt);
         return false;
     }
@@ -93,7 +94,8 @@ bool SecureDB::executeUpdate(const string& sql, const vector<string>& params) {
     
     // 执行语句
     if (mysql_stmt_execute(stmt) != 0) {
-        LOG_ERROR << "Failed to execute statement: " << mysql_stmt_error(stmt);
+        _lastErrno = mysql_stmt_errno(stmt);
+        CHAT_LOG_ERROR_F("Failed to execute statement: %s", mysql_stmt_error(stmt));
         mysql_stmt_close(stmt);
         return false;
     }
@@ -104,7 +106,7 @@ bool SecureDB::executeUpdate(const string& sql, const vector<string>& params) {
 
 MYSQL_RES* SecureDB::executeQuery(const string& sql, const vector<string>& params) {
     if (_conn == nullptr) {
-        LOG_ERROR << "Database not connected";
+        CHAT_LOG_ERROR("Database not connected");
         return nullptr;
     }
     
@@ -116,7 +118,7 @@ MYSQL_RES* SecureDB::executeQuery(const string& sql, const vector<string>& param
     
     // 预编译SQL语句
     if (mysql_stmt_prepare(stmt, sql.c_str(), sql.length()) != 0) {
-        LOG_ERROR << "Failed to prepare statement: " << mysql_stmt_error(stmt);
+        CHAT_LOG_ERROR_F("Failed to prepare statement: %s", mysql_stmt_error(stmt));
         mysql_stmt_close(stmt);
         return nullptr;
     }
@@ -124,8 +126,7 @@ MYSQL_RES* SecureDB::executeQuery(const string& sql, const vector<string>& param
     // 检查参数数量
     unsigned long param_count = mysql_stmt_param_count(stmt);
     if (param_count != params.size()) {
-        LOG_ERROR << "Parameter count mismatch. Expected: " << param_count 
-                  << ", Got: " << params.size();
+        CHAT_LOG_ERROR_F("Parameter count mismatch. Expected: %lu, Got: %zu", param_count, params.size());
         mysql_stmt_close(stmt);
         return nullptr;
     }
@@ -138,7 +139,7 @@ MYSQL_RES* SecureDB::executeQuery(const string& sql, const vector<string>& param
     
     // 执行语句
     if (mysql_stmt_execute(stmt) != 0) {
-        LOG_ERROR << "Failed to execute statement: " << mysql_stmt_error(stmt);
+        CHAT_LOG_ERROR_F("Failed to execute statement: %s", mysql_stmt_error(stmt));
         mysql_stmt_close(stmt);
         return nullptr;
     }
@@ -146,7 +147,7 @@ MYSQL_RES* SecureDB::executeQuery(const string& sql, const vector<string>& param
     // 获取结果
     MYSQL_RES* result = mysql_stmt_result_metadata(stmt);
     if (result == nullptr) {
-        LOG_ERROR << "No result metadata: " << mysql_stmt_error(stmt);
+        CHAT_LOG_ERROR_F("No result metadata: %s", mysql_stmt_error(stmt));
         mysql_stmt_close(stmt);
         return nullptr;
     }
@@ -154,7 +155,7 @@ MYSQL_RES* SecureDB::executeQuery(const string& sql, const vector<string>& param
     // 注意：这里需要特殊处理，因为预编译语句的结果处理与普通查询不同
     // 为了兼容现有代码，我们使用mysql_stmt_store_result
     if (mysql_stmt_store_result(stmt) != 0) {
-        LOG_ERROR << "Failed to store result: " << mysql_stmt_error(stmt);
+        CHAT_LOG_ERROR_F("Failed to store result: %s", mysql_stmt_error(stmt));
         mysql_free_result(result);
         mysql_stmt_close(stmt);
         return nullptr;
@@ -187,7 +188,7 @@ bool SecureDB::bindParameters(MYSQL_STMT* stmt, const vector<string>& params) {
     }
     
     if (mysql_stmt_bind_param(stmt, bind_params.data()) != 0) {
-        LOG_ERROR << "Failed to bind parameters: " << mysql_stmt_error(stmt);
+        CHAT_LOG_ERROR_F("Failed to bind parameters: %s", mysql_stmt_error(stmt));
         return false;
     }
     
@@ -269,9 +270,8 @@ string SecureDB::escapeString(const string& input) {
 
 void SecureDB::logMySQLError(const string& operation) {
     if (_conn != nullptr) {
-        LOG_ERROR << "MySQL " << operation << " failed: " 
-                  << mysql_error(_conn) << " (Error: " << mysql_errno(_conn) << ")";
+        CHAT_LOG_ERROR_F("MySQL %s failed: %s (Error: %u)", operation.c_str(), mysql_error(_conn), mysql_errno(_conn));
     } else {
-        LOG_ERROR << "MySQL " << operation << " failed: Connection is null";
+        CHAT_LOG_ERROR_F("MySQL %s failed: Connection is null", operation.c_str());
     }
 }
\ No newline at end of file
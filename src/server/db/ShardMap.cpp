@@ -0,0 +1,30 @@
+#include "ShardMap.h"
+
+ShardMap::ShardMap(int shardCount)
+    : count(shardCount < 1 ? 1 : shardCount)
+{
+}
+
+void ShardMap::setShardCount(int shardCount)
+{
+    count = shardCount < 1 ? 1 : shardCount;
+}
+
+int ShardMap::nextInsertShard()
+{
+    if (count <= 1)
+    {
+        return 0;
+    }
+    return insertCursor.fetch_add(1, memory_order_relaxed) % count;
+}
+
+vector<vector<int>> ShardMap::groupByShard(const vector<int>& ids) const
+{
+    vector<vector<int>> buckets(count);
+    for (int id : ids)
+    {
+        buckets[shardOf(id)].push_back(id);
+    }
+    return buckets;
+}
@@ -0,0 +1,208 @@
+#include "StateWriteBehind.h"
+#include "ConnectionPoolManager.h"
+#include "common/Logger.hpp"
+#include <map>
+
+// 单条update语句中id列表的最大长度
+static const size_t kMaxIdsPerStatement = 1000;
+
+StateWriteBehind* StateWriteBehind::getInstance()
+{
+    static StateWriteBehind queue;
+    return &queue;
+}
+
+StateWriteBehind::StateWriteBehind()
+{
+    // 先构造连接池管理器，保证进程退出时它晚于本对象析构
+    ConnectionPoolManager::getInstance();
+    worker = thread(std::bind(&StateWriteBehind::flushTask, this));
+}
+
+StateWriteBehind::~StateWriteBehind()
+{
+    shutdown();
+}
+
+void StateWriteBehind::enqueue(int userid, const string& state)
+{
+    unique_lock<mutex> lock(stateMutex);
+    if (stopped)
+    {
+        // 后台线程已停止（进程退出阶段），直接同步写入
+        string name = node;
+        lock.unlock();
+        writeStates({{userid, state}}, name);
+        return;
+    }
+    // 同一用户只保留最后一次变更
+    pending[userid] = state;
+    bool full = pending.size() >= maxPending;
+    lock.unlock();
+
+    if (full)
+    {
+        cv.notify_one();
+    }
+}
+
+bool StateWriteBehind::pendingState(int userid, string& state)
+{
+    lock_guard<mutex> lock(stateMutex);
+    auto it = pending.find(userid);
+    if (it != pending.end())
+    {
+        state = it->second;
+        return true;
+    }
+    it = inflight.find(userid);
+    if (it != inflight.end())
+    {
+        state = it->second;
+        return true;
+    }
+    return false;
+}
+
+void StateWriteBehind::flush()
+{
+    unique_lock<mutex> lock(stateMutex);
+    if (stopped)
+    {
+        return;
+    }
+    unsigned long long generation = flushGeneration;
+    flushRequested = true;
+    cv.notify_one();
+    flushedCv.wait(lock, [this, generation]() { return flushGeneration > generation || stopped; });
+}
+
+void StateWriteBehind::setFlushPolicy(size_t maxPending, int maxDelayMs)
+{
+    lock_guard<mutex> lock(stateMutex);
+    this->maxPending = maxPending > 0 ? maxPending : 1;
+    this->maxDelay = chrono::milliseconds(maxDelayMs > 0 ? maxDelayMs : 0);
+    cv.notify_one();
+}
+
+void StateWriteBehind::setNodeName(const string& name)
+{
+    lock_guard<mutex> lock(stateMutex);
+    node = name;
+}
+
+string StateWriteBehind::nodeName()
+{
+    lock_guard<mutex> lock(stateMutex);
+    return node;
+}
+
+void StateWriteBehind::shutdown()
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        if (stopped)
+        {
+            return;
+        }
+        stopped = true;
+    }
+    cv.notify_one();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void StateWriteBehind::flushTask()
+{
+    unique_lock<mutex> lock(stateMutex);
+    while (true)
+    {
+        // 攒一个刷出周期，期间同一用户的反复上下线被合并
+        cv.wait_for(lock, maxDelay, [this]() {
+            return flushRequested || stopped || pending.size() >= maxPending;
+        });
+        bool force = flushRequested || stopped;
+        flushRequested = false;
+
+        if (!pending.empty())
+        {
+            inflight.swap(pending);
+            string name = node;
+            lock.unlock();
+            unordered_map<int, string> failed = writeStates(inflight, name);
+            lock.lock();
+            // 写入失败的条目放回队列下个周期重试，期间又有新状态的以新状态为准
+            if (!stopped)
+            {
+                for (auto& entry : failed)
+                {
+                    pending.insert(entry);
+                }
+            }
+            inflight.clear();
+        }
+
+        if (force)
+        {
+            flushGeneration++;
+            flushedCv.notify_all();
+            if (stopped)
+            {
+                break;
+            }
+        }
+    }
+}
+
+unordered_map<int, string> StateWriteBehind::writeStates(const unordered_map<int, string>& states, const string& node)
+{
+    auto poolManager = ConnectionPoolManager::getInstance();
+    ShardMap& shardMap = poolManager->getShardMap();
+
+    // (分片, 状态) -> 用户id列表
+    map<pair<int, string>, vector<int>> groups;
+    for (const auto& entry : states)
+    {
+        groups[make_pair(shardMap.shardOf(entry.first), entry.second)].push_back(entry.first);
+    }
+
+    unordered_map<int, string> failed;
+    for (const auto& group : groups)
+    {
+        int shard = group.first.first;
+        const string& state = group.first.second;
+        const vector<int>& ids = group.second;
+        string prefix = "update user set state = '" + ConnectionPoolManager::escape(state) + "'";
+        if (state == "online")
+        {
+            // 记下用户在哪个节点上线，该节点重启时只清理自己名下的online
+            prefix += ", node = '" + ConnectionPoolManager::escape(node) + "'";
+        }
+        prefix += " where id in (";
+        for (size_t begin = 0; begin < ids.size(); begin += kMaxIdsPerStatement)
+        {
+            size_t end = min(ids.size(), begin + kMaxIdsPerStatement);
+            string sql = prefix;
+            for (size_t i = begin; i < end; i++)
+            {
+                if (i > begin)
+                {
+                    sql += ",";
+                }
+                sql += to_string(ids[i]);
+            }
+            sql += ")";
+            if (!poolManager->updateOn(shard, sql))
+            {
+                CHAT_LOG_ERROR_F("Failed to write %zu user states to shard %d", end - begin, shard);
+                for (size_t i = begin; i < end; i++)
+                {
+                    failed[ids[i]] = state;
+                }
+            }
+        }
+    }
+    return failed;
+}
@@ -1,22 +1,194 @@
 #include "chatserver.hpp"
+#include "adminServer.hpp"
 #include "chatservice.hpp"
+#include "ConnectionPoolManager.h"
+#include "DbExecutor.h"
+#include "relationLogModel.hpp"
+#include "socialGraph.hpp"
+#include "common/Logger.hpp"
+#include "common/MuduoLogBridge.hpp"
+#include "common/Metrics.hpp"
+#include "common/Tracer.hpp"
+#include "common/InstrumentedMutex.hpp"
+#include "common/FlightRecorder.hpp"
+#include <muduo/base/Logging.h>
 #include <iostream>
 #include <signal.h>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
 using namespace std;
 
+// SIGUSR1到达时置位，由事件循环中的定时器负责真正的输出（信号处理函数中不能加锁/分配内存）
+static volatile sig_atomic_t g_dumpStatsRequested = 0;
+
+// SIGINT/SIGTERM到达时置位，由事件循环退出后在主线程中完成下线和刷出
+static volatile sig_atomic_t g_quitRequested = 0;
+
+// SIGUSR2到达时置位，由事件循环中的定时器在INFO和DEBUG级别之间切换，用于线上临时打开详细日志
+static volatile sig_atomic_t g_toggleDebugRequested = 0;
+
+// 用户存在性过滤器的重建周期；启动后第二次重建起过滤器才对用户id做出"一定不存在"的判断，
+// 因此启动后先提前重建一次
+static const double kUserFilterRebuildSeconds = 600.0;
+static const double kUserFilterFirstRebuildSeconds = 120.0;
+
+// 社交关系图的重新加载周期
+static const double kSocialGraphReloadSeconds = 600.0;
+
+// 关系变更日志的清理周期，超过保留期限的版本号已改为全量同步，对应日志不再需要
+static const double kRelationLogPurgeSeconds = 24 * 3600.0;
+
+// 管理端口的默认值，环境变量CHAT_ADMIN_PORT可覆盖，设为0时不开启
+static const int kDefaultAdminPort = 6001;
+
+// 本节点名：环境变量CHAT_NODE_ID，默认为 主机名:端口；多节点部署时各节点必须不同，且重启后保持不变
+static string localNodeName(uint16_t port)
+{
+    const char *nodeEnv = getenv("CHAT_NODE_ID");
+    if (nodeEnv != nullptr && nodeEnv[0] != '\0')
+    {
+        return nodeEnv;
+    }
+    char host[256] = {0};
+    if (gethostname(host, sizeof(host) - 1) != 0)
+    {
+        strcpy(host, "localhost");
+    }
+    return string(host) + ":" + to_string(port);
+}
+
+// 连接池、DB执行器、用户缓存和热点锁的统计报告，SIGUSR1和管理端口的/stats共用
+static string statsReport()
+{
+    return ConnectionPoolManager::getInstance()->dumpStats()
+         + "\n" + DbExecutor::getInstance()->dumpStats()
+         + "\n" + UserModel::dumpCacheStats()
+         + "\n" + InstrumentedMutex::dumpAll();
+}
+
+// 各队列的长度在抓取时读取
+static void registerQueueGauges()
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    registry.gaugeCallback("chat_queue_depth", "Items waiting in an internal queue", []() {
+        return static_cast<int64_t>(DbExecutor::getInstance()->queueDepth());
+    }, MetricsRegistry::label("queue", "db_executor"));
+    registry.gaugeCallback("chat_queue_depth", "Items waiting in an internal queue", []() {
+        return static_cast<int64_t>(::Logger::getInstance().queueDepth());
+    }, MetricsRegistry::label("queue", "log"));
+}
+
 void resetHandler(int)
 {
-    ChatService::instance()->reset();
-    exit(0);
+    g_quitRequested = 1;
+}
+
+void dumpStatsHandler(int)
+{
+    g_dumpStatsRequested = 1;
+}
+
+void toggleDebugHandler(int)
+{
+    g_toggleDebugRequested = 1;
 }
 
 int main()
 {
+    // 热点锁的竞争统计默认关闭，CHAT_LOCK_STATS=1时运行期开启（编译期去掉用-DCHAT_LOCK_STATS=0）
+    const char *lockStatsEnv = getenv("CHAT_LOCK_STATS");
+    InstrumentedMutex::setEnabled(lockStatsEnv != nullptr && strcmp(lockStatsEnv, "1") == 0);
     signal(SIGINT, resetHandler);  // 注册信号捕捉
+    signal(SIGTERM, resetHandler);
+    signal(SIGUSR1, dumpStatsHandler);  // kill -USR1 <pid> 输出连接池统计，并写出飞行记录器
+    signal(SIGUSR2, toggleDebugHandler);  // kill -USR2 <pid> 切换DEBUG日志
+    // 业务日志和muduo的LOG_*都异步写入./logs/chat_server.log，不再写控制台（muduo也有Logger类，需显式限定）
+    // 设置环境变量CHAT_BINARY_LOG=1时改写二进制日志./logs/chat_server.blog，用chatlog_decode查看
+    LogConfig logConfig;
+    logConfig.enableConsole = false;
+    logConfig.enableBinary = getenv("CHAT_BINARY_LOG") != nullptr && strcmp(getenv("CHAT_BINARY_LOG"), "0") != 0;
+    ::Logger::getInstance().init(logConfig);
+    MuduoLogBridge::install();
+    // 飞行记录器常开，写在日志目录下；进程因致命信号退出前也会写出
+    FlightRecorder::setDumpDirectory(logConfig.logDir);
+    FlightRecorder::installCrashHandler();
+    // 使用连接池（读取mysql.ini，可配置从库）；配置文件缺失时自动退化为直连
+    UserModel::setConnectionType(DBConnectionType::CONNECTION_POOL);
     EventLoop loop;
     InetAddress addr("127.0.0.1", 6000);
     ChatServer server(&loop, addr, "ChatServer");
+    // 上线状态记在本节点名下，启动时只清理本节点上次退出时遗留的online
+    UserModel::setNodeName(localNodeName(addr.toPort()));
+    ChatService::instance()->startup();
+    loop.runEvery(0.2, [&loop, &logConfig]() {
+        if (g_quitRequested)
+        {
+            loop.quit();
+        }
+        if (g_dumpStatsRequested)
+        {
+            g_dumpStatsRequested = 0;
+            LOG_INFO << "\n" << statsReport();
+            string flightPath = FlightRecorder::dump();
+            if (flightPath.empty())
+            {
+                LOG_ERROR << "Failed to write flight recorder under " << logConfig.logDir;
+            }
+            else
+            {
+                LOG_INFO << "Flight recorder written to " << flightPath;
+            }
+        }
+        if (g_toggleDebugRequested)
+        {
+            g_toggleDebugRequested = 0;
+            bool debug = ::Logger::getInstance().getLogLevel() != LogLevel::DEBUG;
+            MuduoLogBridge::setLogLevel(debug ? LogLevel::DEBUG : LogLevel::INFO);
+            LOG_INFO << "Log level switched to " << (debug ? "DEBUG" : "INFO");
+        }
+    });
+    // 定期重建用户存在性过滤器，纠正丢失的跨节点通知和计数饱和带来的偏差，并推进可信的id范围
+    loop.runAfter(kUserFilterFirstRebuildSeconds, []() {
+        DbExecutor::getInstance()->submit([]() { return UserModel::loadExistenceFilter(); }, 60 * 1000);
+    });
+    loop.runEvery(kUserFilterRebuildSeconds, []() {
+        DbExecutor::getInstance()->submit([]() { return UserModel::loadExistenceFilter(); }, 60 * 1000);
+    });
+    // 定期重新加载社交关系图，纠正丢失的跨节点关系变更通知；群成员缓存过期后随之更新
+    loop.runEvery(kSocialGraphReloadSeconds, []() {
+        DbExecutor::getInstance()->submit([]() { return SocialGraph::instance()->load(); }, 60 * 1000);
+    });
+    loop.runEvery(kRelationLogPurgeSeconds, []() {
+        DbExecutor::getInstance()->submit([]() { return RelationLogModel().purgeExpired(); }, 60 * 1000);
+    });
+    // 环境变量CHAT_TRACE_SAMPLE=N时每N条消息追踪1条，各阶段耗时可从管理端口的/trace导出
+    const char *traceSampleEnv = getenv("CHAT_TRACE_SAMPLE");
+    if (traceSampleEnv != nullptr && atoi(traceSampleEnv) > 0)
+    {
+        Tracer::instance().setSampleEvery(static_cast<uint32_t>(atoi(traceSampleEnv)));
+    }
+    // 管理端口只监听本机：/metrics为Prometheus文本格式的指标，/stats为与SIGUSR1相同的统计报告，
+    // /trace为Chrome trace格式的采样消息阶段耗时
+    registerQueueGauges();
+    const char *adminPortEnv = getenv("CHAT_ADMIN_PORT");
+    int adminPort = adminPortEnv != nullptr ? atoi(adminPortEnv) : kDefaultAdminPort;
+    unique_ptr<AdminServer> admin;
+    if (adminPort > 0)
+    {
+        admin.reset(new AdminServer(&loop, InetAddress("127.0.0.1", static_cast<uint16_t>(adminPort))));
+        admin->addPage("/metrics", "text/plain; version=0.0.4", []() { return MetricsRegistry::instance().renderPrometheus(); });
+        admin->addPage("/stats", "text/plain", statsReport);
+        admin->addPage("/trace", "application/json", []() { return Tracer::instance().exportChromeJson(); });
+        admin->start();
+    }
     server.start();
     loop.loop();
+    ChatService::instance()->reset();
+    //IO线程仍在运行，停止DB线程时剩余任务的回调还能投递出去
+    DbExecutor::getInstance()->shutdown();
+    //写出队列中剩余的日志
+    ::Logger::getInstance().shutdown();
     return 0;
-}
\ No newline at end of file
+}
@@ -1,8 +1,10 @@
 #include "../../../include/server/model/SecureUserModel.hpp"
+#include "../../../include/server/model/userFilter.hpp"
 #include "../../../include/server/security/PasswordUtils.hpp"
 #include "../../../include/server/common/InputValidator.hpp"
 #include "../../../include/server/common/Logger.hpp"
 #include <muduo/base/Logging.h>
+#include <mysql/mysqld_error.h>
 #include <vector>
 
 SecureUserModel::SecureUserModel() {
@@ -36,7 +38,7 @@ ErrorCode SecureUserModel::insert(User& user) {
         return validationResult;
     }
     
-    // 检查用户名是否已存在
+    // 检查用户名是否已存在（提前给出明确的错误；其他节点刚注册的同名用户可能查不出，由唯一约束兜底）
     if (isUsernameExists(user.getName())) {
         CHAT_LOG_ERROR_F("Username already exists: %s", user.getName().c_str());
         return ErrorCode::USER_ALREADY_EXISTS;
@@ -59,8 +61,13 @@ ErrorCode SecureUserModel::insert(User& user) {
         // 获取插入的用户ID
         unsigned long long insertId = _db->getLastInsertId();
         user.setId(static_cast<int>(insertId));
+        UserFilter::instance()->addUser(user.getId(), user.getName());
         CHAT_LOG_INFO_F("User inserted successfully with ID: %d", user.getId());
         return ErrorCode::SUCCESS;
+    } else if (_db->getLastErrno() == ER_DUP_ENTRY) {
+        // 查重之后其他节点注册了同名用户，被user.name的唯一约束拦截
+        CHAT_LOG_ERROR_F("Username already exists: %s", user.getName().c_str());
+        return ErrorCode::USER_ALREADY_EXISTS;
     } else {
         CHAT_LOG_ERROR("Failed to insert user using prepared statement");
         return ErrorCode::DATABASE_INSERT_FAILED;
@@ -216,6 +223,12 @@ ErrorCode SecureUserModel::resetAllStates() {
 }
 
 bool SecureUserModel::isUsernameExists(const std::string& name) {
+    // 过滤器中没有时不必查库：其他节点刚注册、通知尚未到达的同名用户会漏判，
+    // 这只是提前给出明确错误的查重，重复注册最终由insert时的唯一约束拦截
+    if (!UserFilter::instance()->mightExistName(name)) {
+        return false;
+    }
+
     string sql = "SELECT COUNT(*) FROM user WHERE name = ?";
     vector<string> params = {name};
     
@@ -275,6 +288,9 @@ ErrorCode SecureUserModel::deleteUser(int userId) {
         return validationResult;
     }
     
+    // 先取得用户名，删除成功后从存在性过滤器中移除
+    std::pair<User, ErrorCode> existing = queryById(userId);
+
     // 使用预编译语句删除用户
     string sql = "DELETE FROM user WHERE id = ?";
     vector<string> params = {std::to_string(userId)};
@@ -282,6 +298,9 @@ ErrorCode SecureUserModel::deleteUser(int userId) {
     if (_db->executeUpdate(sql, params)) {
         unsigned long long affectedRows = _db->getAffectedRows();
         if (affectedRows > 0) {
+            if (existing.second == ErrorCode::SUCCESS) {
+                UserFilter::instance()->removeUser(userId, existing.first.getName());
+            }
             CHAT_LOG_INFO_F("User deleted successfully with ID: %d", userId);
             return ErrorCode::SUCCESS;
         } else {
@@ -2,11 +2,79 @@
 #include "UserModel.hpp"
 #include "../db/db.h"
 #include "../db/ConnectionPoolManager.h"
+#include "StateWriteBehind.h"
+#include "userFilter.hpp"
+#include "../../../include/server/common/ShardedCache.hpp"
 #include "../../../include/server/security/PasswordUtils.hpp"
 #include "../../../include/server/common/InputValidator.hpp"
 #include "../../../include/server/common/ErrorCodes.hpp"
 #include "../../../include/server/common/Logger.hpp"
 #include <muduo/base/Logging.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+// 用户记录缓存：热点用户的查询只需一次哈希查找；状态变更写穿透，其他节点的变更通过invalidateCache失效
+static ShardedCache<int, User>& userCache()
+{
+    static ShardedCache<int, User> cache(100000, std::chrono::seconds(60));
+    return cache;
+}
+
+// 其他节点推送来的状态：对方的回写队列落库之前，从数据库读到的仍是旧状态，
+// 收到推送后的一段时间内（远大于回写队列的刷出周期）以推送的状态为准
+static const chrono::milliseconds kRemoteStateWindow(2000);
+// 覆盖表超过该大小时清理一次已过期的条目
+static const size_t kRemoteStateSweepSize = 4096;
+
+struct RemoteStateOverlay {
+    mutex overlayMutex;
+    unordered_map<int, pair<string, chrono::steady_clock::time_point>> states; // userid -> (状态, 失效时刻)
+    atomic<size_t> size{0}; // 为0时读者不加锁
+};
+
+static RemoteStateOverlay& remoteStates()
+{
+    static RemoteStateOverlay overlay;
+    return overlay;
+}
+
+// 回写队列中尚未落库的状态、其他节点刚推送来的状态都比数据库中的更新
+static void overlayPendingState(User &user)
+{
+    string state;
+    if (StateWriteBehind::getInstance()->pendingState(user.getId(), state)) {
+        user.setState(state);
+        return;
+    }
+    RemoteStateOverlay &overlay = remoteStates();
+    if (overlay.size.load(memory_order_relaxed) == 0) {
+        return;
+    }
+    lock_guard<mutex> lock(overlay.overlayMutex);
+    auto it = overlay.states.find(user.getId());
+    if (it == overlay.states.end()) {
+        return;
+    }
+    if (chrono::steady_clock::now() < it->second.second) {
+        user.setState(it->second.first);
+    } else {
+        overlay.states.erase(it);
+        overlay.size.store(overlay.states.size(), memory_order_relaxed);
+    }
+}
+
+// 本节点修改了用户状态，之前收到的推送已过时
+static void forgetRemoteState(int id)
+{
+    RemoteStateOverlay &overlay = remoteStates();
+    if (overlay.size.load(memory_order_relaxed) == 0) {
+        return;
+    }
+    lock_guard<mutex> lock(overlay.overlayMutex);
+    overlay.states.erase(id);
+    overlay.size.store(overlay.states.size(), memory_order_relaxed);
+}
 
 // 静态成员初始化
 DBConnectionType UserModel::connectionType = DBConnectionType::SINGLE_CONNECTION;
@@ -53,10 +121,13 @@ ErrorCode UserModel::insert(User &user)
     if (connectionType == DBConnectionType::CONNECTION_POOL) {
         // 使用连接池
         auto poolManager = ConnectionPoolManager::getInstance();
-        if (poolManager->update(sql)) {
-            // 注意：连接池方式下获取insert_id需要特殊处理
-            // 这里简化处理，实际项目中需要在Connection类中添加getInsertId方法
-            user.setId(1); // 临时设置，实际需要获取真实的insert_id
+        // 新用户轮询写入各分片，生成的自增id本身即编码了所在分片
+        int shard = poolManager->getShardMap().nextInsertShard();
+        unsigned long long insertId = 0;
+        if (poolManager->updateOn(shard, sql, &insertId)) {
+            // 自增id在连接归还前从同一连接上读取
+            user.setId(insertId);
+            UserFilter::instance()->addUser(user.getId(), safeName);
             CHAT_LOG_INFO_F("User inserted successfully with ID: %d", user.getId());
             return ErrorCode::SUCCESS;
         } else {
@@ -72,6 +143,7 @@ ErrorCode UserModel::insert(User &user)
             {
                 // 获取插入成功的用户数据生成的主键id
                 user.setId(mysql_insert_id(mysql.getConnection()));
+                UserFilter::instance()->addUser(user.getId(), safeName);
                 CHAT_LOG_INFO_F("User inserted successfully with ID: %d", user.getId());
                 return ErrorCode::SUCCESS;
             } else {
@@ -96,6 +168,12 @@ pair<User, ErrorCode> UserModel::query(int id)
         return make_pair(User(), validationResult);
     }
     
+    User cached;
+    if (userCache().get(id, cached)) {
+        overlayPendingState(cached);
+        return make_pair(cached, ErrorCode::SUCCESS);
+    }
+
     // 1.组装sql语句
     char sql[1024] = {0};
     sprintf(sql, "select id, name, password, salt, state from user where id = %d", id);
@@ -103,7 +181,7 @@ pair<User, ErrorCode> UserModel::query(int id)
     if (connectionType == DBConnectionType::CONNECTION_POOL) {
         // 使用连接池
         auto poolManager = ConnectionPoolManager::getInstance();
-        MYSQL_RES *res = poolManager->query(sql);
+        MYSQL_RES *res = poolManager->queryOn(poolManager->getShardMap().shardOf(id), sql);
         if (res != nullptr)
         {
             MYSQL_ROW row = mysql_fetch_row(res);
@@ -116,6 +194,9 @@ pair<User, ErrorCode> UserModel::query(int id)
                 if (row[3]) user.setSalt(row[3]); // 设置盐值
                 user.setState(row[4]);
                 mysql_free_result(res);
+                // 缓存覆盖后的状态，避免在对方落库前把旧状态缓存到过期
+                overlayPendingState(user);
+                userCache().put(id, user);
                 CHAT_LOG_DEBUG_F("User found: %s", user.getName().c_str());
                 return make_pair(user, ErrorCode::SUCCESS);
             } else {
@@ -145,6 +226,8 @@ pair<User, ErrorCode> UserModel::query(int id)
                     if (row[3]) user.setSalt(row[3]); // 设置盐值
                     user.setState(row[4]);
                     mysql_free_result(res);
+                    overlayPendingState(user);
+                    userCache().put(id, user);
                     CHAT_LOG_DEBUG_F("User found: %s", user.getName().c_str());
                     return make_pair(user, ErrorCode::SUCCESS);
                 } else {
@@ -165,31 +248,35 @@ pair<User, ErrorCode> UserModel::query(int id)
 
 bool UserModel::updateState(User user)
 {
-    // 1.组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "update user set state = '%s' where id = %d", user.getState().c_str(), user.getId());
-    
-    if (connectionType == DBConnectionType::CONNECTION_POOL) {
-        auto poolManager = ConnectionPoolManager::getInstance();
-        return poolManager->update(sql);
-    } else {
-        MySQL mysql;
-        if (mysql.connect())
-        {
-            return mysql.update(sql);
-        }
-    }
-    return false;
+    // 写穿透：缓存中的记录同步更新
+    string state = user.getState();
+    userCache().update(user.getId(), [&state](User &cached) { cached.setState(state); });
+    forgetRemoteState(user.getId());
+    // 同一用户的多次变更在队列中合并，按分片批量写入
+    StateWriteBehind::getInstance()->enqueue(user.getId(), user.getState());
+    return true;
+}
+
+void UserModel::flushState()
+{
+    StateWriteBehind::getInstance()->flush();
+}
+
+void UserModel::setNodeName(const string &name)
+{
+    StateWriteBehind::getInstance()->setNodeName(name);
 }
 
 void UserModel::resetState()
 {
+    userCache().clear();
     // 1.组装sql语句
-    char sql[1024] = "update user set state = 'offline' where state = 'online'";
+    string node = ConnectionPoolManager::escape(StateWriteBehind::getInstance()->nodeName());
+    string sql = "update user set state = 'offline' where state = 'online' and node = '" + node + "'";
     
     if (connectionType == DBConnectionType::CONNECTION_POOL) {
         auto poolManager = ConnectionPoolManager::getInstance();
-        poolManager->update(sql);
+        poolManager->updateAll(sql);
     } else {
         MySQL mysql;
         if (mysql.connect())
@@ -199,3 +286,111 @@ void UserModel::resetState()
     }
 }
 
+vector<User> UserModel::queryByIds(const vector<int>& ids, bool* complete)
+{
+    if (complete != nullptr) {
+        *complete = true;
+    }
+    vector<User> vec;
+    if (ids.empty()) {
+        return vec;
+    }
+    // 先从缓存取，只查询未命中的id
+    vector<int> missing;
+    for (int id : ids) {
+        User cached;
+        if (userCache().get(id, cached)) {
+            overlayPendingState(cached);
+            vec.push_back(User(cached.getId(), cached.getName(), "", cached.getState()));
+        } else {
+            missing.push_back(id);
+        }
+    }
+    if (missing.empty()) {
+        return vec;
+    }
+    // 按分片分桶，每个分片一条 where id in (...) 查询，各分片并行执行
+    auto poolManager = ConnectionPoolManager::getInstance();
+    vector<vector<int>> buckets = poolManager->getShardMap().groupByShard(missing);
+    vector<string> sqls(buckets.size());
+    for (size_t shard = 0; shard < buckets.size(); shard++) {
+        if (buckets[shard].empty()) {
+            continue;
+        }
+        string sql = "select id, name, state from user where id in (";
+        for (size_t i = 0; i < buckets[shard].size(); i++) {
+            if (i > 0) sql += ",";
+            sql += to_string(buckets[shard][i]);
+        }
+        sql += ")";
+        sqls[shard] = sql;
+    }
+    vector<MYSQL_RES*> results = poolManager->scatterQuery(sqls);
+    for (size_t shard = 0; shard < results.size(); shard++) {
+        MYSQL_RES *res = results[shard];
+        if (res == nullptr) {
+            // 该分片查询失败，其中的用户缺失
+            if (complete != nullptr && !sqls[shard].empty()) {
+                *complete = false;
+            }
+            continue;
+        }
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr) {
+            vec.push_back(User(atoi(row[0]), row[1], "", row[2]));
+            overlayPendingState(vec.back());
+        }
+        mysql_free_result(res);
+    }
+    return vec;
+}
+
+void UserModel::invalidateCache(int id)
+{
+    userCache().invalidate(id);
+}
+
+void UserModel::applyRemoteState(int id, const string &state)
+{
+    userCache().update(id, [&state](User &cached) { cached.setState(state); });
+    RemoteStateOverlay &overlay = remoteStates();
+    lock_guard<mutex> lock(overlay.overlayMutex);
+    auto now = chrono::steady_clock::now();
+    if (overlay.states.size() >= kRemoteStateSweepSize) {
+        for (auto it = overlay.states.begin(); it != overlay.states.end();) {
+            it = now >= it->second.second ? overlay.states.erase(it) : next(it);
+        }
+    }
+    overlay.states[id] = make_pair(state, now + kRemoteStateWindow);
+    overlay.size.store(overlay.states.size(), memory_order_relaxed);
+}
+
+string UserModel::dumpCacheStats()
+{
+    return userCache().dumpStats("user cache");
+}
+
+bool UserModel::loadExistenceFilter()
+{
+    return UserFilter::instance()->load([](vector<pair<int, string>> &users) {
+        auto poolManager = ConnectionPoolManager::getInstance();
+        vector<string> sqls(poolManager->shardCount(), "select id, name from user");
+        bool ok = true;
+        for (MYSQL_RES *res : poolManager->scatterQuery(sqls))
+        {
+            if (res == nullptr)
+            {
+                ok = false;
+                continue;
+            }
+            users.reserve(users.size() + mysql_num_rows(res));
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                users.emplace_back(atoi(row[0]), row[1]);
+            }
+            mysql_free_result(res);
+        }
+        return ok;
+    }, [](int id) { return ConnectionPoolManager::getInstance()->getShardMap().shardOf(id); });
+}
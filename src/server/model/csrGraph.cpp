@@ -0,0 +1,211 @@
+#include "csrGraph.hpp"
+
+// 增量层的合并阈值：不少于4096条边，且不少于基础边数的1/8
+static const size_t kMinCompactThreshold = 4096;
+
+void CsrGraph::build(vector<pair<int, int>> edges)
+{
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    Csr csr;
+    csr.targets.reserve(edges.size());
+    for (const auto &edge : edges)
+    {
+        if (csr.vertices.empty() || csr.vertices.back() != edge.first)
+        {
+            csr.vertices.push_back(edge.first);
+            csr.offsets.push_back(static_cast<uint32_t>(csr.targets.size()));
+        }
+        csr.targets.push_back(edge.second);
+    }
+    csr.offsets.push_back(static_cast<uint32_t>(csr.targets.size()));
+
+    unique_lock<shared_mutex> lock(_mutex);
+    _base = std::move(csr);
+    _added.clear();
+    _removed.clear();
+    _overlayEdges = 0;
+}
+
+pair<const int *, const int *> CsrGraph::baseRange(const Csr &csr, int from)
+{
+    auto it = lower_bound(csr.vertices.begin(), csr.vertices.end(), from);
+    if (it == csr.vertices.end() || *it != from)
+    {
+        return make_pair(nullptr, nullptr);
+    }
+    size_t index = it - csr.vertices.begin();
+    const int *data = csr.targets.data();
+    return make_pair(data + csr.offsets[index], data + csr.offsets[index + 1]);
+}
+
+bool CsrGraph::hasEdgeLocked(int from, int to) const
+{
+    auto added = _added.find(from);
+    if (added != _added.end() && find(added->second.begin(), added->second.end(), to) != added->second.end())
+    {
+        return true;
+    }
+    auto range = baseRange(_base, from);
+    if (!binary_search(range.first, range.second, to))
+    {
+        return false;
+    }
+    auto removed = _removed.find(from);
+    return removed == _removed.end()
+        || find(removed->second.begin(), removed->second.end(), to) == removed->second.end();
+}
+
+bool CsrGraph::hasEdge(int from, int to)
+{
+    shared_lock<shared_mutex> lock(_mutex);
+    return hasEdgeLocked(from, to);
+}
+
+bool CsrGraph::addEdge(int from, int to)
+{
+    unique_lock<shared_mutex> lock(_mutex);
+    if (hasEdgeLocked(from, to))
+    {
+        return false;
+    }
+    auto removed = _removed.find(from);
+    if (removed != _removed.end())
+    {
+        auto it = find(removed->second.begin(), removed->second.end(), to);
+        if (it != removed->second.end())
+        {
+            //恢复一条之前删除的基础边
+            removed->second.erase(it);
+            if (removed->second.empty())
+            {
+                _removed.erase(removed);
+            }
+            _overlayEdges--;
+            return true;
+        }
+    }
+    _added[from].push_back(to);
+    _overlayEdges++;
+    if (_overlayEdges > max(kMinCompactThreshold, _base.targets.size() / 8))
+    {
+        compactLocked();
+    }
+    return true;
+}
+
+bool CsrGraph::removeEdge(int from, int to)
+{
+    unique_lock<shared_mutex> lock(_mutex);
+    auto added = _added.find(from);
+    if (added != _added.end())
+    {
+        auto it = find(added->second.begin(), added->second.end(), to);
+        if (it != added->second.end())
+        {
+            added->second.erase(it);
+            if (added->second.empty())
+            {
+                _added.erase(added);
+            }
+            _overlayEdges--;
+            return true;
+        }
+    }
+    if (!hasEdgeLocked(from, to))
+    {
+        return false;
+    }
+    _removed[from].push_back(to);
+    _overlayEdges++;
+    return true;
+}
+
+vector<int> CsrGraph::neighbors(int from)
+{
+    vector<int> result;
+    forEachNeighbor(from, [&result](int to) { result.push_back(to); });
+    return result;
+}
+
+void CsrGraph::compact()
+{
+    unique_lock<shared_mutex> lock(_mutex);
+    compactLocked();
+}
+
+void CsrGraph::compactLocked()
+{
+    if (_overlayEdges == 0)
+    {
+        return;
+    }
+    //按顶点顺序归并基础数组和增量层，输出仍然有序，无需整体排序
+    vector<int> vertices = _base.vertices;
+    for (const auto &entry : _added)
+    {
+        vertices.push_back(entry.first);
+    }
+    sort(vertices.begin(), vertices.end());
+    vertices.erase(unique(vertices.begin(), vertices.end()), vertices.end());
+
+    Csr csr;
+    csr.targets.reserve(_base.targets.size() + _overlayEdges);
+    vector<int> adjacency;
+    for (int from : vertices)
+    {
+        adjacency.clear();
+        auto range = baseRange(_base, from);
+        auto removed = _removed.find(from);
+        for (const int *it = range.first; it != range.second; ++it)
+        {
+            if (removed == _removed.end()
+                || find(removed->second.begin(), removed->second.end(), *it) == removed->second.end())
+            {
+                adjacency.push_back(*it);
+            }
+        }
+        auto added = _added.find(from);
+        if (added != _added.end())
+        {
+            adjacency.insert(adjacency.end(), added->second.begin(), added->second.end());
+            sort(adjacency.begin(), adjacency.end());
+        }
+        if (adjacency.empty())
+        {
+            continue;
+        }
+        csr.vertices.push_back(from);
+        csr.offsets.push_back(static_cast<uint32_t>(csr.targets.size()));
+        csr.targets.insert(csr.targets.end(), adjacency.begin(), adjacency.end());
+    }
+    csr.offsets.push_back(static_cast<uint32_t>(csr.targets.size()));
+
+    _base = std::move(csr);
+    _added.clear();
+    _removed.clear();
+    _overlayEdges = 0;
+}
+
+size_t CsrGraph::edgeCount()
+{
+    shared_lock<shared_mutex> lock(_mutex);
+    size_t removed = 0;
+    for (const auto &entry : _removed)
+    {
+        removed += entry.second.size();
+    }
+    size_t added = 0;
+    for (const auto &entry : _added)
+    {
+        added += entry.second.size();
+    }
+    return _base.targets.size() - removed + added;
+}
+
+size_t CsrGraph::overlaySize()
+{
+    shared_lock<shared_mutex> lock(_mutex);
+    return _overlayEdges;
+}
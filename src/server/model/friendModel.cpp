@@ -1,46 +1,89 @@
 #include "friendModel.hpp"
 #include "UserModel.hpp"
-#include "server/db/db.h"
+#include "ConnectionPoolManager.h"
+#include "BatchInsertWriter.h"
+#include "relationLogModel.hpp"
 #include <vector>
 using namespace std;
 //添加好友业务
-void FriendModel::insert(int userid, int friendid)
+void FriendModel::insert(int userid, int friendid, function<void(bool)> done)
 {
-    //1.组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "insert into friend(userid, friendid) values(%d, %d)", userid, friendid);
-    MySQL mysql;
-    if (mysql.connect())
-    {
-        mysql.update(sql);
-    }   
+    //好友关系存放在userid所在的分片
+    auto poolManager = ConnectionPoolManager::getInstance();
+    int shard = poolManager->getShardMap().shardOf(userid);
+    //插入成功后再记录变更日志，供客户端增量同步好友列表；回调在写入线程中执行，日志投递到DB线程
+    BatchInsertWriter::getInstance()->append(shard, _friendTable, "userid, friendid",
+                                             to_string(userid) + ", " + to_string(friendid),
+                                             [userid, friendid, done](bool inserted) {
+                                                 if (inserted)
+                                                 {
+                                                     RelationLogModel::appendFriendAsync(userid, friendid);
+                                                 }
+                                                 if (done)
+                                                 {
+                                                     done(inserted);
+                                                 }
+                                             });
 }
 //返回用户好友列表
-vector<User> FriendModel::query(int userid)
+vector<User> FriendModel::query(int userid, bool *complete)
 {
-    //1.组装sql语句
+    if (complete != nullptr)
+    {
+        *complete = true;
+    }
+    auto poolManager = ConnectionPoolManager::getInstance();
+    int shard = poolManager->getShardMap().shardOf(userid);
     char sql[1024] = {0};
-    sprintf(sql, "select a.id, a.name, a.state from user a inner join friend b on b.friendid = a.id where b.userid = %d", userid);
     vector<User> vec;
-    MySQL mysql;
-    if (mysql.connect())
+    if (poolManager->shardCount() > 1)
     {
-        MYSQL_RES *res = mysql.query(sql);
+        //好友的user记录可能位于其他分片：先取好友id，再按分片批量取用户信息
+        sprintf(sql, "select friendid from friend where userid = %d", userid);
+        vector<int> ids;
+        MYSQL_RES *res = poolManager->queryReplicaOn(shard, sql);
         if (res != nullptr)
         {
-            //把userid用户的所有好友信息返回
             MYSQL_ROW row;
             while ((row = mysql_fetch_row(res)) != nullptr)
             {
-                User user;
-                user.setId(atoi(row[0]));
-                user.setName(row[1]);
-                user.setState(row[2]);
-                vec.push_back(user);
+                ids.push_back(atoi(row[0]));
             }
             mysql_free_result(res);
-            return vec;
         }
+        else if (complete != nullptr)
+        {
+            *complete = false;
+        }
+        bool usersComplete = true;
+        vector<User> users = UserModel().queryByIds(ids, &usersComplete);
+        if (complete != nullptr && !usersComplete)
+        {
+            *complete = false;
+        }
+        return users;
+    }
+    //1.组装sql语句
+    sprintf(sql, "select a.id, a.name, a.state from user a inner join friend b on b.friendid = a.id where b.userid = %d", userid);
+    //好友列表允许轻微延迟，走从库
+    MYSQL_RES *res = poolManager->queryReplicaOn(shard, sql);
+    if (res != nullptr)
+    {
+        //把userid用户的所有好友信息返回
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            User user;
+            user.setId(atoi(row[0]));
+            user.setName(row[1]);
+            user.setState(row[2]);
+            vec.push_back(user);
+        }
+        mysql_free_result(res);
+    }
+    else if (complete != nullptr)
+    {
+        *complete = false;
     }
     return vec;
 }
\ No newline at end of file
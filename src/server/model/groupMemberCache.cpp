@@ -0,0 +1,97 @@
+#include "groupMemberCache.hpp"
+#include <algorithm>
+
+GroupMemberCache::GroupMemberCache(size_t maxGroups, chrono::seconds ttl)
+    : _maxGroupsPerSegment(max<size_t>(1, maxGroups / kSegmentCount)), _ttl(ttl)
+{
+}
+
+GroupMemberCache::Members GroupMemberCache::get(int groupid)
+{
+    Segment &seg = segmentOf(groupid);
+    lock_guard<mutex> lock(seg.segMutex);
+    auto it = seg.groups.find(groupid);
+    if (it == seg.groups.end())
+    {
+        return nullptr;
+    }
+    if (chrono::steady_clock::now() - it->second.loadedAt > _ttl)
+    {
+        seg.groups.erase(it);
+        return nullptr;
+    }
+    return it->second.members;
+}
+
+unsigned long long GroupMemberCache::version(int groupid)
+{
+    Segment &seg = segmentOf(groupid);
+    lock_guard<mutex> lock(seg.segMutex);
+    return seg.version;
+}
+
+bool GroupMemberCache::put(int groupid, vector<int> members, unsigned long long loadVersion)
+{
+    sort(members.begin(), members.end());
+    members.erase(unique(members.begin(), members.end()), members.end());
+    members.shrink_to_fit();
+    Entry entry{make_shared<const vector<int>>(std::move(members)), chrono::steady_clock::now()};
+
+    Segment &seg = segmentOf(groupid);
+    lock_guard<mutex> lock(seg.segMutex);
+    if (seg.version != loadVersion)
+    {
+        return false;
+    }
+    if (seg.groups.size() >= _maxGroupsPerSegment && seg.groups.find(groupid) == seg.groups.end())
+    {
+        //段已满，淘汰任意一个群，被淘汰的群下次访问时重新加载
+        seg.groups.erase(seg.groups.begin());
+    }
+    seg.groups[groupid] = std::move(entry);
+    return true;
+}
+
+void GroupMemberCache::addMember(int groupid, int userid)
+{
+    Segment &seg = segmentOf(groupid);
+    lock_guard<mutex> lock(seg.segMutex);
+    seg.version++;
+    auto it = seg.groups.find(groupid);
+    if (it == seg.groups.end())
+    {
+        return;
+    }
+    const vector<int> &old = *it->second.members;
+    auto pos = lower_bound(old.begin(), old.end(), userid);
+    if (pos != old.end() && *pos == userid)
+    {
+        return;
+    }
+    //复制后替换，正在遍历旧数组的读者不受影响
+    auto members = make_shared<vector<int>>();
+    members->reserve(old.size() + 1);
+    members->insert(members->end(), old.begin(), pos);
+    members->push_back(userid);
+    members->insert(members->end(), pos, old.end());
+    it->second.members = std::move(members);
+}
+
+void GroupMemberCache::invalidate(int groupid)
+{
+    Segment &seg = segmentOf(groupid);
+    lock_guard<mutex> lock(seg.segMutex);
+    seg.version++;
+    seg.groups.erase(groupid);
+}
+
+size_t GroupMemberCache::size()
+{
+    size_t total = 0;
+    for (Segment &seg : _segments)
+    {
+        lock_guard<mutex> lock(seg.segMutex);
+        total += seg.groups.size();
+    }
+    return total;
+}
@@ -1,87 +1,299 @@
 #include "groupModel.hpp"
-#include "server/db/db.h"
+#include "UserModel.hpp"
+#include "ConnectionPoolManager.h"
+#include "BatchInsertWriter.h"
+#include "relationLogModel.hpp"
+#include <algorithm>
 
-//创建群组
-bool GroupModel::createGroup(Group &group)
+//拼接 "1,2,3" 形式的id列表
+static string joinIds(const vector<int> &ids)
 {
-    //1.组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "insert into allgroup(groupname, groupdesc) values('%s', '%s')", group.getName().c_str(), group.getDesc().c_str());
-    MySQL mysql;
-    if (mysql.connect())
+    string out;
+    for (size_t i = 0; i < ids.size(); i++)
     {
-        if (mysql.update(sql))
+        if (i > 0)
         {
-            //获取插入成功的用户id
-            group.setId(mysql_insert_id(mysql.getConnection()));
-            return true;
+            out += ",";
         }
+        out += to_string(ids[i]);
     }
-    return false;
+    return out;
 }
 
-//加入群组
-void GroupModel::addGroup(int userid, int groupid, string role)
+//创建群组
+bool GroupModel::createGroup(Group &group)
 {
     //1.组装sql语句
     char sql[1024] = {0};
-    sprintf(sql, "insert into groupuser(groupid, userid, grouprole) values(%d, %d, '%s')", groupid, userid, role.c_str());
-    MySQL mysql;
-    if (mysql.connect())
+    sprintf(sql, "insert into allgroup(groupname, groupdesc) values('%s', '%s')", group.getName().c_str(), group.getDesc().c_str());
+    //新群组轮询写入各分片，群组id本身即编码了所在分片，群成员关系随群组存放
+    auto poolManager = ConnectionPoolManager::getInstance();
+    int shard = poolManager->getShardMap().nextInsertShard();
+    unsigned long long insertId = 0;
+    if (poolManager->updateOn(shard, sql, &insertId))
     {
-        mysql.update(sql);
+        //获取插入成功的群组id
+        group.setId(insertId);
+        return true;
     }
+    return false;
+}
 
+//加入群组
+void GroupModel::addGroup(int userid, int groupid, string role, function<void(bool)> done)
+{
+    //群成员关系随群组存放在groupid所在的分片
+    auto poolManager = ConnectionPoolManager::getInstance();
+    int shard = poolManager->getShardMap().shardOf(groupid);
+    //插入成功后再记录变更日志，供客户端增量同步群组列表；回调在写入线程中执行，日志投递到DB线程
+    BatchInsertWriter::getInstance()->append(shard, "groupuser", "groupid, userid, grouprole",
+        to_string(groupid) + ", " + to_string(userid) + ", '" + ConnectionPoolManager::escape(role) + "'",
+        [groupid, userid, done](bool inserted) {
+            if (inserted)
+            {
+                RelationLogModel::appendGroupMemberAsync(groupid, userid);
+            }
+            if (done)
+            {
+                done(inserted);
+            }
+        });
 }
 //查询用户所在群组信息
-vector<Group> GroupModel::queryGroups(int userid)
+vector<Group> GroupModel::queryGroups(int userid, bool *complete)
 {
+    if (complete != nullptr)
+    {
+        *complete = true;
+    }
     //1.组装sql语句
     char sql[1024] = {0};
     sprintf(sql, "select a.id, a.groupname, a.groupdesc from allgroup a inner join groupuser b on a.id = b.groupid where b.userid = %d", userid);
     vector<Group> vec;
-    MySQL mysql;
-    if (mysql.connect())
+    auto poolManager = ConnectionPoolManager::getInstance();
+    //用户加入的群组可能分布在任意分片，allgroup与groupuser同分片存放，join可在各分片内完成
+    vector<string> sqls(poolManager->shardCount(), sql);
+    vector<MYSQL_RES *> results = poolManager->scatterQuery(sqls);
+    for (size_t shard = 0; shard < results.size(); shard++)
     {
-        MYSQL_RES *res = mysql.query(sql);
-        if (res != nullptr)
+        MYSQL_RES *res = results[shard];
+        if (res == nullptr)
         {
-            //把userid用户的所有群组信息查询出来
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res)) != nullptr)
+            //该分片查询失败，其上的数据缺失
+            if (complete != nullptr && !sqls[shard].empty())
             {
-                Group group;
-                group.setId(atoi(row[0]));
-                group.setName(row[1]);
-                group.setDesc(row[2]);
-                vec.push_back(group);
+                *complete = false;
             }
-            mysql_free_result(res);
+            continue;
+        }
+        //把userid用户的所有群组信息查询出来
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            Group group;
+            group.setId(atoi(row[0]));
+            group.setName(row[1]);
+            group.setDesc(row[2]);
+            vec.push_back(group);
         }
+        mysql_free_result(res);
+    }
+    fillMembers(vec, complete);
+    return vec;
+}
+
+//按id批量查询群组信息和成员
+vector<Group> GroupModel::queryGroupsByIds(const vector<int> &groupids, bool *complete)
+{
+    if (complete != nullptr)
+    {
+        *complete = true;
+    }
+    vector<Group> vec;
+    if (groupids.empty())
+    {
+        return vec;
+    }
+    auto poolManager = ConnectionPoolManager::getInstance();
+    vector<vector<int>> buckets = poolManager->getShardMap().groupByShard(groupids);
+    vector<string> sqls(buckets.size());
+    for (size_t shard = 0; shard < buckets.size(); shard++)
+    {
+        if (!buckets[shard].empty())
+        {
+            sqls[shard] = "select id, groupname, groupdesc from allgroup where id in (" + joinIds(buckets[shard]) + ")";
+        }
+    }
+    vector<MYSQL_RES *> results = poolManager->scatterQuery(sqls);
+    for (size_t shard = 0; shard < results.size(); shard++)
+    {
+        MYSQL_RES *res = results[shard];
+        if (res == nullptr)
+        {
+            //该分片查询失败，其上的数据缺失
+            if (complete != nullptr && !sqls[shard].empty())
+            {
+                *complete = false;
+            }
+            continue;
+        }
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            Group group;
+            group.setId(atoi(row[0]));
+            group.setName(row[1]);
+            group.setDesc(row[2]);
+            vec.push_back(group);
+        }
+        mysql_free_result(res);
+    }
+    fillMembers(vec, complete);
+    return vec;
+}
+
+//填充群组的成员列表
+void GroupModel::fillMembers(vector<Group> &vec, bool *complete)
+{
+    //一次批量加载所有群组的成员，不再逐个群组查询
+    vector<int> groupids;
+    groupids.reserve(vec.size());
+    for (Group &group : vec)
+    {
+        groupids.push_back(group.getId());
+    }
+    bool membersComplete = true;
+    unordered_map<int, vector<GroupUser>> members = queryGroupMembers(groupids, &membersComplete);
+    if (complete != nullptr && !membersComplete)
+    {
+        *complete = false;
     }
-    //查询群组用户信息
     for (Group &group : vec)
     {
-        sprintf(sql, "select a.id, a.name, a.state, b.grouprole from user a inner join groupuser b on b.userid = a.id where b.groupid = %d", group.getId());
-        MYSQL_RES *res = mysql.query(sql);
-        if (res!= nullptr)
+        auto it = members.find(group.getId());
+        if (it != members.end())
+        {
+            group.getUsers() = std::move(it->second);
+        }
+    }
+}
+
+//批量查询一组群组的成员信息
+unordered_map<int, vector<GroupUser>> GroupModel::queryGroupMembers(const vector<int> &groupids, bool *complete)
+{
+    if (complete != nullptr)
+    {
+        *complete = true;
+    }
+    unordered_map<int, vector<GroupUser>> members;
+    if (groupids.empty())
+    {
+        return members;
+    }
+    auto poolManager = ConnectionPoolManager::getInstance();
+    //群成员关系与群组同分片，每个分片一条 where groupid in (...) 查询，各分片并行执行
+    vector<vector<int>> buckets = poolManager->getShardMap().groupByShard(groupids);
+    vector<string> sqls(buckets.size());
+
+    if (poolManager->shardCount() == 1)
+    {
+        //单分片时user与groupuser在同一个库，一条join取回全部成员
+        sqls[0] = "select b.groupid, a.id, a.name, a.state, b.grouprole from user a inner join groupuser b on b.userid = a.id where b.groupid in ("
+                + joinIds(buckets[0]) + ")";
+        vector<MYSQL_RES *> results = poolManager->scatterQuery(sqls);
+        for (size_t shard = 0; shard < results.size(); shard++)
         {
-            //把userid用户的所有群组信息查询出来
+            MYSQL_RES *res = results[shard];
+            if (res == nullptr)
+            {
+                //该分片查询失败，其上的数据缺失
+                if (complete != nullptr && !sqls[shard].empty())
+                {
+                    *complete = false;
+                }
+                continue;
+            }
             MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res))!= nullptr)
+            while ((row = mysql_fetch_row(res)) != nullptr)
             {
                 GroupUser user;
-                user.setId(atoi(row[0]));
-                user.setName(row[1]);
-                user.setState(row[2]);
-                user.setRole(row[3]);
-                group.getUsers().push_back(user);
+                user.setId(atoi(row[1]));
+                user.setName(row[2]);
+                user.setState(row[3]);
+                user.setRole(row[4]);
+                members[atoi(row[0])].push_back(user);
             }
             mysql_free_result(res);
         }
+        return members;
     }
-    return vec;
-};
+
+    //多分片时成员的user记录可能位于其他分片：先取各群的成员id和角色，再按用户分片批量取用户信息
+    for (size_t shard = 0; shard < buckets.size(); shard++)
+    {
+        if (!buckets[shard].empty())
+        {
+            sqls[shard] = "select groupid, userid, grouprole from groupuser where groupid in (" + joinIds(buckets[shard]) + ")";
+        }
+    }
+    struct Membership
+    {
+        int groupid;
+        int userid;
+        string role;
+    };
+    vector<Membership> rows;
+    vector<int> userids;
+    vector<MYSQL_RES *> results = poolManager->scatterQuery(sqls);
+    for (size_t shard = 0; shard < results.size(); shard++)
+    {
+        MYSQL_RES *res = results[shard];
+        if (res == nullptr)
+        {
+            //该分片查询失败，其上的数据缺失
+            if (complete != nullptr && !sqls[shard].empty())
+            {
+                *complete = false;
+            }
+            continue;
+        }
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            rows.push_back(Membership{atoi(row[0]), atoi(row[1]), row[2]});
+            userids.push_back(rows.back().userid);
+        }
+        mysql_free_result(res);
+    }
+    //同一用户可能在多个群中，只查询一次
+    sort(userids.begin(), userids.end());
+    userids.erase(unique(userids.begin(), userids.end()), userids.end());
+    unordered_map<int, User> users;
+    bool usersComplete = true;
+    for (User &user : UserModel().queryByIds(userids, &usersComplete))
+    {
+        users[user.getId()] = user;
+    }
+    if (complete != nullptr && !usersComplete)
+    {
+        *complete = false;
+    }
+    for (Membership &membership : rows)
+    {
+        auto it = users.find(membership.userid);
+        if (it == users.end())
+        {
+            continue;
+        }
+        GroupUser user;
+        user.setId(it->second.getId());
+        user.setName(it->second.getName());
+        user.setState(it->second.getState());
+        user.setRole(membership.role);
+        members[membership.groupid].push_back(user);
+    }
+    return members;
+}
 //根据指定的groupid查询群组用户id列表，除userid自己，主要用户群聊业务给群组其他成员群发消息
 vector<int> GroupModel::queryGroupUsers(int userid, int groupid)
 {
@@ -89,21 +301,37 @@ vector<int> GroupModel::queryGroupUsers(int userid, int groupid)
     char sql[1024] = {0};
     sprintf(sql, "select userid from groupuser where groupid = %d and userid != %d", groupid, userid);
     vector<int> vec;
-    MySQL mysql;
-    if (mysql.connect())
+    auto poolManager = ConnectionPoolManager::getInstance();
+    MYSQL_RES *res = poolManager->queryReplicaOn(poolManager->getShardMap().shardOf(groupid), sql);
+    if (res!= nullptr)
     {
-        MYSQL_RES *res = mysql.query(sql);
-        if (res!= nullptr)
+        //把userid用户的所有群组信息查询出来
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res))!= nullptr)
         {
-            //把userid用户的所有群组信息查询出来
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res))!= nullptr)
-            {
-                vec.push_back(atoi(row[0]));
-            }
-            mysql_free_result(res);
-            return vec;
+            vec.push_back(atoi(row[0]));
         }
+        mysql_free_result(res);
     }
     return vec;
-}
\ No newline at end of file
+}
+//查询群组全部成员id
+bool GroupModel::queryGroupMemberIds(int groupid, vector<int> &ids)
+{
+    char sql[1024] = {0};
+    sprintf(sql, "select userid from groupuser where groupid = %d", groupid);
+    //结果会被缓存，读主库避免把从库上的旧数据缓存下来
+    auto poolManager = ConnectionPoolManager::getInstance();
+    MYSQL_RES *res = poolManager->queryOn(poolManager->getShardMap().shardOf(groupid), sql);
+    if (res == nullptr)
+    {
+        return false;
+    }
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr)
+    {
+        ids.push_back(atoi(row[0]));
+    }
+    mysql_free_result(res);
+    return true;
+}
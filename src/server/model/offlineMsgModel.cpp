@@ -1,52 +1,91 @@
 #include "offlineMsgModel.hpp"
-#include "db.h"
+#include "ConnectionPoolManager.h"
+#include "BatchInsertWriter.h"
+
+//离线消息存放在接收者userid所在的分片
+static int shardOfUser(int userid)
+{
+    return ConnectionPoolManager::getInstance()->getShardMap().shardOf(userid);
+}
+
+//组装一行 (userid, message) 的values内容
+static string offlineRow(int userid, const string &msg)
+{
+    return to_string(userid) + ", '" + ConnectionPoolManager::escape(msg) + "'";
+}
 
 //存储离线消息
-void OfflineMsgModel::insert(int userid, string msg)
+future<bool> OfflineMsgModel::insert(int userid, string msg)
 {
-    // 1.组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "insert into offlinemessage values(%d, '%s')", userid, msg.c_str());
-    MySQL mysql;
-    if (mysql.connect())
+    return BatchInsertWriter::getInstance()->append(shardOfUser(userid), _offlineMsgTable, "userid, message", offlineRow(userid, msg));
+}
+//给多个用户存储同一条离线消息
+vector<future<bool>> OfflineMsgModel::insert(const vector<int> &userids, const string &msg)
+{
+    //按分片分桶，每个分片一次追加
+    vector<vector<int>> buckets = ConnectionPoolManager::getInstance()->getShardMap().groupByShard(userids);
+    vector<future<bool>> acks;
+    for (size_t shard = 0; shard < buckets.size(); shard++)
     {
-        mysql.update(sql);
+        if (buckets[shard].empty())
+        {
+            continue;
+        }
+        vector<string> rows;
+        for (int userid : buckets[shard])
+        {
+            rows.push_back(offlineRow(userid, msg));
+        }
+        for (auto &ack : BatchInsertWriter::getInstance()->append(shard, _offlineMsgTable, "userid, message", std::move(rows)))
+        {
+            acks.push_back(std::move(ack));
+        }
     }
+    return acks;
 }
-//删除用户的离线消息
-void OfflineMsgModel::remove(int userid)
+//删除用户已确认收到的离线消息
+bool OfflineMsgModel::remove(int userid, const vector<int> &ids)
 {
-    // 1.组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "delete from offlinemessage where userid=%d", userid);
-    MySQL mysql;
-    if (mysql.connect())
+    if (ids.empty())
+    {
+        return true;
+    }
+    //按主键删除确认过的行，期间新到的离线消息不受影响
+    string sql = "delete from offlinemessage where userid=" + to_string(userid) + " and id in (";
+    for (size_t i = 0; i < ids.size(); i++)
     {
-        mysql.update(sql);
+        if (i > 0)
+        {
+            sql += ",";
+        }
+        sql += to_string(ids[i]);
     }
+    sql += ")";
+    return ConnectionPoolManager::getInstance()->updateOn(shardOfUser(userid), sql);
 }
-//查询用户的离线消息
-vector<string> OfflineMsgModel::query(int userid)
+//分页查询用户的离线消息
+vector<OfflineMsg> OfflineMsgModel::queryPage(int userid, int afterId, int limit)
 {
+    if (afterId == 0)
+    {
+        //第一页之前先刷出批量写入器中尚未落库的离线消息，避免登录时漏读
+        BatchInsertWriter::getInstance()->flush();
+    }
     // 1.组装sql语句
     char sql[1024] = {0};
-    sprintf(sql, "select message from offlinemessage where userid=%d", userid);
-    vector<string> vec;
-    MySQL mysql;
-    if (mysql.connect())
+    sprintf(sql, "select id, message from offlinemessage where userid=%d and id>%d order by id limit %d",
+            userid, afterId, limit);
+    vector<OfflineMsg> vec;
+    //确认后会删除这些消息，必须读主库，不能读到从库上的旧数据
+    MYSQL_RES *res = ConnectionPoolManager::getInstance()->queryOn(shardOfUser(userid), sql);
+    if (res != nullptr)
     {
-        MYSQL_RES *res = mysql.query(sql);
-        if (res != nullptr)
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
         {
-            //把userid用户的所有离线消息放入vec中返回
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res)) != nullptr)
-            {
-                vec.push_back(row[0]);
-            }
-            mysql_free_result(res);
-            return vec;
+            vec.push_back(OfflineMsg{atoi(row[0]), row[1]});
         }
+        mysql_free_result(res);
     }
     return vec;
-}
\ No newline at end of file
+}
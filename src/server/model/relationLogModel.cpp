@@ -0,0 +1,262 @@
+#include "relationLogModel.hpp"
+#include "ConnectionPoolManager.h"
+#include "DbExecutor.h"
+#include "common/Logger.hpp"
+#include <set>
+#include <mutex>
+
+//日志保留天数，早于此的行被清理，版本号落在清理范围内的客户端需要全量同步
+static const int kRetentionDays = 30;
+//异步写日志的排队期限，写关系表已经成功，日志尽量不丢
+static const int kAppendTimeoutMs = 60 * 1000;
+
+//写日志失败、且未能使客户端版本号失效的分片；在补做成功之前，本节点对这些分片不做增量同步
+static mutex g_staleMutex;
+static set<int> g_staleShards;
+
+static void markStale(int shard)
+{
+    lock_guard<mutex> lock(g_staleMutex);
+    g_staleShards.insert(shard);
+}
+
+void RelationLogModel::appendFriendAsync(int userid, int friendid)
+{
+    future<bool> ack = DbExecutor::getInstance()->submit([userid, friendid]() { return RelationLogModel().appendFriend(userid, friendid); },
+                                                         kAppendTimeoutMs);
+    //队列已满时任务不会执行，立即可知
+    if (ack.wait_for(chrono::seconds(0)) == future_status::ready)
+    {
+        try
+        {
+            ack.get();
+        }
+        catch (const DbExecutorError &)
+        {
+            markStale(ConnectionPoolManager::getInstance()->getShardMap().shardOf(userid));
+        }
+    }
+}
+
+void RelationLogModel::appendGroupMemberAsync(int groupid, int userid)
+{
+    future<bool> ack = DbExecutor::getInstance()->submit([groupid, userid]() { return RelationLogModel().appendGroupMember(groupid, userid); },
+                                                         kAppendTimeoutMs);
+    if (ack.wait_for(chrono::seconds(0)) == future_status::ready)
+    {
+        try
+        {
+            ack.get();
+        }
+        catch (const DbExecutorError &)
+        {
+            ShardMap &shardMap = ConnectionPoolManager::getInstance()->getShardMap();
+            markStale(shardMap.shardOf(userid));
+            markStale(shardMap.shardOf(groupid));
+        }
+    }
+}
+
+bool RelationLogModel::appendFriend(int userid, int friendid)
+{
+    int shard = ConnectionPoolManager::getInstance()->getShardMap().shardOf(userid);
+    return appendOn(shard, userid, "friend", friendid);
+}
+
+bool RelationLogModel::appendGroupMember(int groupid, int userid)
+{
+    ShardMap &shardMap = ConnectionPoolManager::getInstance()->getShardMap();
+    bool ok = appendOn(shardMap.shardOf(userid), userid, "group", groupid);
+    return appendOn(shardMap.shardOf(groupid), groupid, "member", userid) && ok;
+}
+
+bool RelationLogModel::appendOn(int shard, int ownerid, const char *kind, int targetid)
+{
+    flushStale();
+    auto poolManager = ConnectionPoolManager::getInstance();
+    auto body = [ownerid, kind, targetid](ConnectionPoolManager::Transaction &txn) {
+        //行锁持有到提交，同一分片上版本号较小的日志一定先提交
+        unsigned long long version = 0;
+        if (!txn.update("update relation_seq set version = last_insert_id(version + 1) where id = 1", &version) || version == 0)
+        {
+            return false;
+        }
+        return txn.update("insert into relation_log(ownerid, kind, targetid, version) values(" + to_string(ownerid) + ", '"
+                          + kind + "', " + to_string(targetid) + ", " + to_string(version) + ")", nullptr);
+    };
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (poolManager->transactionOn(shard, body))
+        {
+            return true;
+        }
+    }
+    CHAT_LOG_ERROR_F("relation_log append failed on shard %d, forcing full sync", shard);
+    if (!invalidate(shard))
+    {
+        markStale(shard);
+    }
+    return false;
+}
+
+bool RelationLogModel::invalidate(int shard)
+{
+    //单表UPDATE按从左到右的顺序赋值，purged取到的是推进后的version
+    return ConnectionPoolManager::getInstance()->updateOn(shard,
+        "update relation_seq set version = version + 1, purged = version where id = 1");
+}
+
+bool RelationLogModel::flushStale()
+{
+    lock_guard<mutex> lock(g_staleMutex);
+    for (auto it = g_staleShards.begin(); it != g_staleShards.end();)
+    {
+        if (invalidate(*it))
+        {
+            it = g_staleShards.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return g_staleShards.empty();
+}
+
+bool RelationLogModel::queryWatermark(RelationWatermark &mark)
+{
+    if (!flushStale())
+    {
+        return false;
+    }
+    auto poolManager = ConnectionPoolManager::getInstance();
+    int count = poolManager->shardCount();
+    vector<string> sqls(count, "select version, purged from relation_seq where id = 1");
+    //水位必须反映已提交的最新值，读主库
+    vector<MYSQL_RES *> results = poolManager->scatterQuery(sqls, false);
+    mark.version.assign(count, 0);
+    mark.purged.assign(count, 0);
+    bool ok = true;
+    for (int shard = 0; shard < count; shard++)
+    {
+        MYSQL_RES *res = results[shard];
+        if (res == nullptr)
+        {
+            ok = false;
+            continue;
+        }
+        MYSQL_ROW row = mysql_fetch_row(res);
+        if (row != nullptr)
+        {
+            mark.version[shard] = atoll(row[0]);
+            mark.purged[shard] = atoll(row[1]);
+        }
+        else
+        {
+            ok = false;
+        }
+        mysql_free_result(res);
+    }
+    return ok;
+}
+
+bool RelationLogModel::covers(const RelationWatermark &mark, const vector<long long> &version)
+{
+    if (version.size() != mark.version.size())
+    {
+        return false;
+    }
+    for (size_t shard = 0; shard < version.size(); shard++)
+    {
+        if (version[shard] < mark.purged[shard] || version[shard] > mark.version[shard])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static string versionRange(int shard, const vector<long long> &since, const vector<long long> &until)
+{
+    return " and version > " + to_string(since[shard]) + " and version <= " + to_string(until[shard]);
+}
+
+bool RelationLogModel::queryFriendsSince(int userid, const vector<long long> &since, const vector<long long> &until, vector<int> &ids)
+{
+    auto poolManager = ConnectionPoolManager::getInstance();
+    vector<string> sqls(poolManager->shardCount());
+    int shard = poolManager->getShardMap().shardOf(userid);
+    sqls[shard] = "select distinct targetid from relation_log where ownerid = " + to_string(userid)
+        + " and kind = 'friend'" + versionRange(shard, since, until);
+    return queryIds(sqls, ids);
+}
+
+bool RelationLogModel::queryGroupsSince(int userid, const vector<long long> &since, const vector<long long> &until, vector<int> &ids)
+{
+    auto poolManager = ConnectionPoolManager::getInstance();
+    vector<string> sqls(poolManager->shardCount());
+    int shard = poolManager->getShardMap().shardOf(userid);
+    sqls[shard] = "select distinct targetid from relation_log where ownerid = " + to_string(userid)
+        + " and kind = 'group'" + versionRange(shard, since, until);
+    return queryIds(sqls, ids);
+}
+
+bool RelationLogModel::queryChangedGroups(const vector<int> &groupids, const vector<long long> &since, const vector<long long> &until,
+                                          vector<int> &ids)
+{
+    if (groupids.empty())
+    {
+        return true;
+    }
+    auto poolManager = ConnectionPoolManager::getInstance();
+    vector<vector<int>> buckets = poolManager->getShardMap().groupByShard(groupids);
+    vector<string> sqls(buckets.size());
+    for (size_t shard = 0; shard < buckets.size(); shard++)
+    {
+        if (buckets[shard].empty())
+        {
+            continue;
+        }
+        string in;
+        for (int groupid : buckets[shard])
+        {
+            in += (in.empty() ? "" : ",") + to_string(groupid);
+        }
+        sqls[shard] = "select distinct ownerid from relation_log where kind = 'member' and ownerid in (" + in + ")"
+            + versionRange(shard, since, until);
+    }
+    return queryIds(sqls, ids);
+}
+
+bool RelationLogModel::purgeExpired()
+{
+    flushStale();
+    auto poolManager = ConnectionPoolManager::getInstance();
+    //先推进purged再删除，删除失败时留下的行不影响正确性
+    return poolManager->updateAll("update relation_seq set purged = greatest(purged, (select coalesce(max(version), 0) from relation_log"
+                                  " where created_at < now() - interval " + to_string(kRetentionDays) + " day)) where id = 1")
+        && poolManager->updateAll("delete from relation_log where version <= (select purged from relation_seq where id = 1)");
+}
+
+bool RelationLogModel::queryIds(const vector<string> &sqls, vector<int> &ids)
+{
+    //水位之内的日志已提交，读主库；按(ownerid, kind, version)索引做范围扫描
+    bool ok = true;
+    vector<MYSQL_RES *> results = ConnectionPoolManager::getInstance()->scatterQuery(sqls, false);
+    for (size_t shard = 0; shard < results.size(); shard++)
+    {
+        MYSQL_RES *res = results[shard];
+        if (res == nullptr)
+        {
+            ok = ok && sqls[shard].empty();
+            continue;
+        }
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            ids.push_back(atoi(row[0]));
+        }
+        mysql_free_result(res);
+    }
+    return ok;
+}
@@ -0,0 +1,145 @@
+#include "socialGraph.hpp"
+#include "ConnectionPoolManager.h"
+#include <muduo/base/Logging.h>
+
+SocialGraph *SocialGraph::instance()
+{
+    static SocialGraph graph;
+    return &graph;
+}
+
+bool SocialGraph::loadEdges(const string &sql, vector<pair<int, int>> &edges)
+{
+    auto poolManager = ConnectionPoolManager::getInstance();
+    vector<string> sqls(poolManager->shardCount(), sql);
+    bool ok = true;
+    for (MYSQL_RES *res : poolManager->scatterQuery(sqls))
+    {
+        if (res == nullptr)
+        {
+            ok = false;
+            continue;
+        }
+        edges.reserve(edges.size() + mysql_num_rows(res));
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            edges.emplace_back(atoi(row[0]), atoi(row[1]));
+        }
+        mysql_free_result(res);
+    }
+    return ok;
+}
+
+bool SocialGraph::load()
+{
+    chrono::steady_clock::time_point replayFrom;
+    {
+        lock_guard<mutex> lock(_changeMutex);
+        if (_loading)
+        {
+            return false;
+        }
+        _loading = true;
+        replayFrom = chrono::steady_clock::now() - kReplayWindow;
+    }
+    vector<pair<int, int>> friendEdges;
+    vector<pair<int, int>> memberEdges;
+    if (!loadEdges("select userid, friendid from friend", friendEdges)
+        || !loadEdges("select groupid, userid from groupuser", memberEdges))
+    {
+        lock_guard<mutex> lock(_changeMutex);
+        _loading = false;
+        LOG_ERROR << (isLoaded() ? "Failed to reload social graph, keeping the current one"
+                                 : "Failed to load social graph, falling back to database queries");
+        return false;
+    }
+
+    vector<pair<int, int>> reversed;
+    reversed.reserve(memberEdges.size());
+    for (const auto &edge : memberEdges)
+    {
+        reversed.emplace_back(edge.second, edge.first);
+    }
+    vector<pair<int, int>> friendOfEdges;
+    friendOfEdges.reserve(friendEdges.size());
+    for (const auto &edge : friendEdges)
+    {
+        friendOfEdges.emplace_back(edge.second, edge.first);
+    }
+    size_t friendCount = friendEdges.size();
+    size_t memberCount = memberEdges.size();
+    _friends.build(std::move(friendEdges));
+    _friendOf.build(std::move(friendOfEdges));
+    _groupUsers.build(std::move(memberEdges));
+    _userGroups.build(std::move(reversed));
+    {
+        //加载期间（包括redis订阅线程收到的其他节点通知）的增删，以及加载前尚在批量写入器中或未同步到从库的增删，
+        //可能不在查询结果中，或被build丢弃，按发生顺序重放；增删都是幂等的，已包含在结果中的变更重放后不变
+        lock_guard<mutex> lock(_changeMutex);
+        for (const auto &recent : _recentChanges)
+        {
+            if (recent.first >= replayFrom)
+            {
+                applyToGraphs(recent.second);
+            }
+        }
+        _loading = false;
+    }
+    _loaded.store(true, memory_order_release);
+    LOG_INFO << "Social graph loaded: friends=" << friendCount << " group members=" << memberCount;
+    return true;
+}
+
+bool SocialGraph::applyLocked(const Change &change)
+{
+    auto now = chrono::steady_clock::now();
+    if (!_loading)
+    {
+        while (!_recentChanges.empty() && _recentChanges.front().first < now - kReplayWindow)
+        {
+            _recentChanges.pop_front();
+        }
+    }
+    _recentChanges.emplace_back(now, change);
+    return applyToGraphs(change);
+}
+
+bool SocialGraph::applyToGraphs(const Change &change)
+{
+    CsrGraph &forward = change.member ? _groupUsers : _friends;
+    CsrGraph &backward = change.member ? _userGroups : _friendOf;
+    if (change.add)
+    {
+        bool added = forward.addEdge(change.a, change.b);
+        backward.addEdge(change.b, change.a);
+        return added;
+    }
+    bool removed = forward.removeEdge(change.a, change.b);
+    backward.removeEdge(change.b, change.a);
+    return removed;
+}
+
+bool SocialGraph::addFriend(int userid, int friendid)
+{
+    lock_guard<mutex> lock(_changeMutex);
+    return applyLocked(Change{true, false, userid, friendid});
+}
+
+void SocialGraph::removeFriend(int userid, int friendid)
+{
+    lock_guard<mutex> lock(_changeMutex);
+    applyLocked(Change{false, false, userid, friendid});
+}
+
+bool SocialGraph::addGroupMember(int groupid, int userid)
+{
+    lock_guard<mutex> lock(_changeMutex);
+    return applyLocked(Change{true, true, groupid, userid});
+}
+
+void SocialGraph::removeGroupMember(int groupid, int userid)
+{
+    lock_guard<mutex> lock(_changeMutex);
+    applyLocked(Change{false, true, groupid, userid});
+}
@@ -0,0 +1,134 @@
+#include "userFilter.hpp"
+#include <muduo/base/Logging.h>
+
+// 过滤器容量至少为当前用户数的2倍，为新注册用户留出空间，超出后误判率上升，由定期重建恢复
+static const size_t kMinFilterCapacity = 1 << 20;
+static const double kFalsePositiveRate = 0.01;
+
+UserFilter *UserFilter::instance()
+{
+    static UserFilter filter;
+    return &filter;
+}
+
+bool UserFilter::load(const UserScanner &scanner, const ShardOf &shardOf)
+{
+    auto scanStart = chrono::steady_clock::now();
+    {
+        unique_lock<shared_mutex> lock(_mutex);
+        if (_loading)
+        {
+            return false;
+        }
+        _loading = true;
+        _changesDuringLoad.clear();
+    }
+
+    vector<pair<int, string>> users;
+    if (!scanner(users))
+    {
+        unique_lock<shared_mutex> lock(_mutex);
+        _loading = false;
+        LOG_ERROR << "Failed to load user filter, lookups will go to the database";
+        return false;
+    }
+
+    auto scanEnd = chrono::steady_clock::now();
+    unordered_map<int, int> maxIds;
+    for (const auto &user : users)
+    {
+        int &maxId = maxIds[shardOf(user.first)];
+        maxId = max(maxId, user.first);
+    }
+
+    size_t capacity = max(kMinFilterCapacity, users.size() * 2);
+    unique_ptr<CountingBloomFilter> ids(new CountingBloomFilter(capacity, kFalsePositiveRate));
+    unique_ptr<CountingBloomFilter> names(new CountingBloomFilter(capacity, kFalsePositiveRate));
+    for (const auto &user : users)
+    {
+        ids->add(user.first);
+        names->add(user.second);
+    }
+
+    unique_lock<shared_mutex> lock(_mutex);
+    //加载期间的增删可能未包含在查询结果中，重放一遍；重复的add只会让计数多1，不影响判断
+    for (const Change &change : _changesDuringLoad)
+    {
+        if (change.add)
+        {
+            ids->add(change.id);
+            names->add(change.name);
+        }
+        else
+        {
+            ids->remove(change.id);
+            names->remove(change.name);
+        }
+    }
+    _changesDuringLoad.clear();
+    _ids = std::move(ids);
+    _names = std::move(names);
+    _shardOf = shardOf;
+    //上一次扫描结束时已分配的id，到本次扫描开始时都已提交或放弃，本次结果中没有的就一定不存在
+    if (_scanned && scanStart - _lastScanEnd >= kTrustDelay)
+    {
+        _trustedMaxIds = std::move(_lastMaxIds);
+    }
+    if (!_scanned || scanStart - _lastScanEnd >= kTrustDelay)
+    {
+        //两次重建间隔太短时保留上一次的结果，留给之后的重建使用
+        _lastMaxIds = std::move(maxIds);
+        _lastScanEnd = scanEnd;
+        _scanned = true;
+    }
+    _loading = false;
+    _loaded.store(true, memory_order_release);
+    LOG_INFO << "User filter loaded: users=" << users.size() << " bytes=" << _ids->memoryBytes() * 2;
+    return true;
+}
+
+void UserFilter::addUser(int id, const string &name)
+{
+    unique_lock<shared_mutex> lock(_mutex);
+    if (_loading)
+    {
+        _changesDuringLoad.push_back(Change{true, id, name});
+    }
+    if (_ids != nullptr)
+    {
+        _ids->add(id);
+        _names->add(name);
+    }
+}
+
+void UserFilter::removeUser(int id, const string &name)
+{
+    unique_lock<shared_mutex> lock(_mutex);
+    if (_loading)
+    {
+        _changesDuringLoad.push_back(Change{false, id, name});
+    }
+    if (_ids != nullptr)
+    {
+        _ids->remove(id);
+        _names->remove(name);
+    }
+}
+
+bool UserFilter::mightExist(int id)
+{
+    shared_lock<shared_mutex> lock(_mutex);
+    if (_ids == nullptr || _ids->mightContain(id))
+    {
+        return true;
+    }
+    //超出可信范围的id可能是其他节点刚注册、通知尚未到达的用户
+    auto it = _trustedMaxIds.find(_shardOf(id));
+    return it == _trustedMaxIds.end() || id > it->second;
+}
+
+bool UserFilter::mightExistName(const string &name)
+{
+    shared_lock<shared_mutex> lock(_mutex);
+    return _names == nullptr || _names->mightContain(name);
+}
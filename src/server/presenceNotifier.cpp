@@ -0,0 +1,123 @@
+#include "presenceNotifier.hpp"
+#include "public.hpp"
+#include "json.hpp"
+using json = nlohmann::json;
+
+PresenceNotifier::PresenceNotifier(int debounceMs, size_t maxChanges)
+    : _queue(chrono::milliseconds(debounceMs), maxChanges)
+{
+    _worker = thread(std::bind(&PresenceNotifier::flushTask, this));
+}
+
+PresenceNotifier::~PresenceNotifier()
+{
+    shutdown();
+}
+
+void PresenceNotifier::notify(int recipient, const TcpConnectionPtr &conn, int userid, const string &state)
+{
+    bool full = false;
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_stopped)
+        {
+            return;
+        }
+        bool wasEmpty = _queue.empty();
+        full = _queue.add(recipient, userid, state);
+        _conns[recipient] = conn;
+        //队列由空变为非空时后台线程处于无限期等待，需要唤醒它设置定时
+        full = full || wasEmpty;
+    }
+    if (full)
+    {
+        _cv.notify_one();
+    }
+}
+
+void PresenceNotifier::cancel(int recipient)
+{
+    lock_guard<mutex> lock(_mutex);
+    _queue.erase(recipient);
+    _conns.erase(recipient);
+}
+
+void PresenceNotifier::shutdown()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_stopped)
+        {
+            return;
+        }
+        _stopped = true;
+    }
+    _cv.notify_one();
+    if (_worker.joinable())
+    {
+        _worker.join();
+    }
+}
+
+void PresenceNotifier::flushTask()
+{
+    unique_lock<mutex> lock(_mutex);
+    while (!_stopped)
+    {
+        auto ready = _queue.takeReady();
+        if (ready.empty())
+        {
+            if (_queue.empty())
+            {
+                _cv.wait(lock);
+            }
+            else
+            {
+                _cv.wait_until(lock, _queue.nextDue());
+            }
+            continue;
+        }
+        vector<pair<TcpConnectionPtr, DebounceQueue<int, int, string>::Items>> frames;
+        for (auto &batch : ready)
+        {
+            auto it = _conns.find(batch.first);
+            if (it == _conns.end())
+            {
+                continue;
+            }
+            TcpConnectionPtr conn = it->second.lock();
+            _conns.erase(it);
+            if (conn != nullptr)
+            {
+                frames.emplace_back(conn, std::move(batch.second));
+            }
+        }
+        //在锁外发送，发送期间新的变化继续入队
+        lock.unlock();
+        for (auto &frame : frames)
+        {
+            send(frame.first, frame.second);
+        }
+        lock.lock();
+    }
+}
+
+void PresenceNotifier::send(const TcpConnectionPtr &conn, const DebounceQueue<int, int, string>::Items &changes)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    json js;
+    js["msgid"] = PRESENCE_MSG;
+    json list = json::array();
+    for (const auto &change : changes)
+    {
+        json item;
+        item["id"] = change.first;
+        item["state"] = change.second;
+        list.push_back(item);
+    }
+    js["changes"] = list;
+    conn->send(js.dump());
+}
@@ -3,7 +3,19 @@
 #include <string>
 #include <vector>
 #include <hiredis/hiredis.h>
+#include <muduo/base/Logging.h>
+#include "common/Logger.hpp"
+#include "common/Metrics.hpp"
+#include "common/FlightRecorder.hpp"
 using namespace std;
+//PUBLISH的耗时，含等待发布锁的时间，跨节点转发排队时也能反映出来
+static HdrHistogram &publishLatency()
+{
+    static HdrHistogram &latency = MetricsRegistry::instance().histogram("chat_redis_latency_microseconds",
+        "Redis command round trip", MetricsRegistry::label("op", "publish"));
+    return latency;
+}
+
 Redis::Redis() : _publish_context(nullptr), _subscribe_context(nullptr)
 {
 
@@ -25,14 +37,14 @@ bool Redis::connect()
     _publish_context = redisConnect("127.0.0.1", 6379);
     if(_publish_context == nullptr)
     {
-        cerr << "connect redis failed!" << endl;
+        LOG_ERROR << "connect redis failed!";
         return false;
     }
     //在单独的线程中，监听通道上的事件，有消息给业务层上报
     _subscribe_context = redisConnect("127.0.0.1", 6379);
     if(_subscribe_context == nullptr)
     {
-        cerr << "connect redis failed!" << endl;
+        LOG_ERROR << "connect redis failed!";
         return false;
     }
     //单独线程中，监听通道上的事件，有消息给业务层上报
@@ -40,16 +52,19 @@ bool Redis::connect()
         observer_channel_message();
     });
     t.detach();
-    cout << "connect redis-server success!" << endl;
+    LOG_INFO << "connect redis-server success!";
     return true;
 }
 //向redis指定的通道channel发布消息
 bool Redis::publish(int channel, string message)
 {
+    ScopedLatency timer(publishLatency());
+    lock_guard<mutex> lock(_publish_mutex);
     redisReply* reply = (redisReply*)redisCommand(_publish_context, "PUBLISH %d %s", channel, message.c_str());
+    FlightRecorder::record(FlightEvent::REDIS_PUBLISH, channel, reply != nullptr ? 1 : 0);
     if(reply == nullptr)
     {
-        cerr << "publish command failed!" << endl;
+        CHAT_LOG_ERROR("publish command failed!");
         return false;
     }
     freeReplyObject(reply);
@@ -63,7 +78,7 @@ bool Redis::subscribe(int channel)
     //只负责发送命令，不阻塞接收redis服务器响应消息，否则和notifyMsg线程抢占响应资源
     if(REDIS_ERR == redisAppendCommand(this->_subscribe_context, "SUBSCRIBE %d", channel))
     {
-        cerr << "subscribe command failed!" << endl;
+        CHAT_LOG_ERROR("subscribe command failed!");
         return false;
     }
     //redisBufferWrite可以循环发送缓冲区，直到缓冲区数据发送完毕（done被置为true）
@@ -72,7 +87,7 @@ bool Redis::subscribe(int channel)
     {
         if(REDIS_ERR == redisBufferWrite(this->_subscribe_context, &done))
         {
-            cerr << "subscribe command failed!" << endl;
+            CHAT_LOG_ERROR("subscribe command failed!");
             return false;
         }
     }
@@ -85,7 +100,7 @@ bool Redis::unsubscribe(int channel)
 {
     if(REDIS_ERR == redisAppendCommand(this->_subscribe_context, "UNSUBSCRIBE %d", channel))
     {
-        cerr << "unsubscribe command failed!" << endl;
+        CHAT_LOG_ERROR("unsubscribe command failed!");
         return false;
     }
     //redisBufferWrite可以循环发送缓冲区，直到缓冲区数据发送完毕（done被置为true）
@@ -94,7 +109,7 @@ bool Redis::unsubscribe(int channel)
     {
         if(REDIS_ERR == redisBufferWrite(this->_subscribe_context, &done))
         {
-            cerr << "unsubscribe command failed!" << endl;
+            CHAT_LOG_ERROR("unsubscribe command failed!");
             return false;
         }
 
@@ -107,14 +122,79 @@ void Redis::observer_channel_message()
     redisReply* reply = nullptr;
     while(REDIS_OK == redisGetReply(this->_subscribe_context, (void**)&reply))
     {
-        //订阅收到的消息是一个带三元素的数组
-        if(reply != nullptr && reply->element[2] != nullptr && reply->element[2]->str != nullptr)
+        //订阅收到的消息是一个带三元素的数组，订阅/取消订阅的回复第三个元素为整数
+        if(reply != nullptr && reply->elements == 3 && reply->element[2]->str != nullptr)
         {
-            //给业务层上报通道上发生的消息
-            _notify_message_handler(stoi(reply->element[1]->str), reply->element[2]->str);
+            string channel = reply->element[1]->str;
+            function<void(string)> handler;
+            {
+                lock_guard<mutex> lock(_handler_mutex);
+                auto it = _channel_handlers.find(channel);
+                if(it != _channel_handlers.end())
+                {
+                    handler = it->second;
+                }
+            }
+            if(handler)
+            {
+                //命名通道的消息交给注册的回调
+                handler(reply->element[2]->str);
+            }
+            else
+            {
+                //给业务层上报通道上发生的消息
+                _notify_message_handler(stoi(channel), reply->element[2]->str);
+            }
         }
+        freeReplyObject(reply);
+        reply = nullptr;
+    }
+}
+
+//向命名通道发布消息
+bool Redis::publish(const string &channel, const string &message)
+{
+    ScopedLatency timer(publishLatency());
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply* reply = (redisReply*)redisCommand(_publish_context, "PUBLISH %s %b", channel.c_str(), message.data(), message.size());
+    FlightRecorder::record(FlightEvent::REDIS_PUBLISH, -1, reply != nullptr ? 1 : 0);
+    if(reply == nullptr)
+    {
+        CHAT_LOG_ERROR("publish command failed!");
+        return false;
     }
     freeReplyObject(reply);
+    return true;
+}
+
+//订阅命名通道，收到的消息在订阅线程中交给handler
+bool Redis::subscribe(const string &channel, function<void(string)> handler)
+{
+    {
+        lock_guard<mutex> lock(_handler_mutex);
+        _channel_handlers[channel] = handler;
+    }
+    return sendSubscribeCommand("SUBSCRIBE", channel);
+}
+
+//只发送命令不等待回复，回复由observer_channel_message线程读取
+bool Redis::sendSubscribeCommand(const char *command, const string &channel)
+{
+    if(REDIS_ERR == redisAppendCommand(this->_subscribe_context, "%s %s", command, channel.c_str()))
+    {
+        CHAT_LOG_ERROR_F("%s command failed!", command);
+        return false;
+    }
+    int done = 0;
+    while(!done)
+    {
+        if(REDIS_ERR == redisBufferWrite(this->_subscribe_context, &done))
+        {
+            CHAT_LOG_ERROR_F("%s command failed!", command);
+            return false;
+        }
+    }
+    return true;
 }
 
 void Redis::init_notify_handler(function<void(int, string)> fn)
@@ -0,0 +1,125 @@
+#include "server/common/BinaryLogFormat.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <strings.h>
+using namespace std;
+
+/*
+二进制日志解码工具：把服务端LogConfig::enableBinary产生的日志还原为文本行或JSON行
+用法：chatlog_decode [--json] [--level LEVEL] [file ...]
+不指定文件或文件名为 - 时从标准输入读取；多个文件按参数顺序输出，轮转后的文件可以按 .N ... .1 原文件 的顺序传入
+*/
+
+static void usage(const char* prog)
+{
+    cerr << "usage: " << prog << " [--json] [--level DEBUG|INFO|WARN|ERROR|FATAL] [file ...]" << endl;
+}
+
+static int parseLevel(const string& name)
+{
+    for (int level = 0; level < 5; level++)
+    {
+        string expected = BinaryLogFormat::levelName(level);
+        while (!expected.empty() && expected.back() == ' ')
+        {
+            expected.pop_back();
+        }
+        if (strcasecmp(name.c_str(), expected.c_str()) == 0)
+        {
+            return level;
+        }
+    }
+    return -1;
+}
+
+// 解码一个输入流，返回是否完整读完
+static bool decode(istream& in, const string& name, bool json, int minLevel)
+{
+    BinaryLogReader reader(in);
+    if (!reader.readHeader())
+    {
+        cerr << name << ": " << reader.error() << endl;
+        return false;
+    }
+    BinaryLogReader::Entry entry;
+    while (reader.next(entry))
+    {
+        if (!entry.dropped && entry.level < minLevel)
+        {
+            continue;
+        }
+        cout << (json ? BinaryLogReader::toJson(entry) : BinaryLogReader::toText(entry)) << '\n';
+    }
+    if (!reader.error().empty())
+    {
+        // 进程崩溃时最后一条记录可能只写了一半，之前的内容仍然有效
+        cerr << name << ": " << reader.error() << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    int minLevel = 0;
+    vector<string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--json")
+        {
+            json = true;
+        }
+        else if (arg == "--level" && i + 1 < argc)
+        {
+            minLevel = parseLevel(argv[++i]);
+            if (minLevel < 0)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty())
+    {
+        files.push_back("-");
+    }
+
+    bool ok = true;
+    for (const string& file : files)
+    {
+        if (file == "-")
+        {
+            ok = decode(cin, "<stdin>", json, minLevel) && ok;
+            continue;
+        }
+        ifstream in(file, ios::binary);
+        if (!in.is_open())
+        {
+            cerr << file << ": cannot open" << endl;
+            ok = false;
+            continue;
+        }
+        ok = decode(in, file, json, minLevel) && ok;
+    }
+    cout.flush();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/Logger.hpp"
+#include "../include/server/common/MuduoLogBridge.hpp"
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <regex>
+
+// 统计日志文件中包含marker的行数
+static int countLines(const std::string& path, const std::string& marker) {
+    std::ifstream in(path);
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line)) {
+        count += line.find(marker) != std::string::npos ? 1 : 0;
+    }
+    return count;
+}
+
+class AsyncLoggerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        config_.logDir = "./async_logger_test_logs";
+        config_.logFileName = "test_" + std::to_string(getpid()) + ".log";
+        config_.enableConsole = false;
+        config_.enableRotation = false;
+        config_.level = LogLevel::DEBUG;
+        ::unlink(path().c_str());
+    }
+
+    void TearDown() override {
+        Logger::getInstance().shutdown();
+        ::unlink(path().c_str());
+    }
+
+    std::string path() const { return config_.logDir + "/" + config_.logFileName; }
+
+    LogConfig config_;
+};
+
+TEST_F(AsyncLoggerTest, FlushWritesEveryLineFromAllThreads) {
+    config_.blockWhenFull = true;
+    config_.queueCapacity = 256;
+    Logger::getInstance().init(config_);
+
+    const int kThreads = 4;
+    const int kLines = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < kLines; i++) {
+                CHAT_LOG_INFO("marker-line " + std::to_string(t) + ":" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    Logger::getInstance().flush();
+    EXPECT_EQ(countLines(path(), "marker-line"), kThreads * kLines);
+}
+
+TEST_F(AsyncLoggerTest, FilteredLevelsAreNotWritten) {
+    config_.level = LogLevel::WARN;
+    Logger::getInstance().init(config_);
+    CHAT_LOG_INFO("marker-info");
+    CHAT_LOG_WARN("marker-warn");
+    Logger::getInstance().flush();
+    EXPECT_EQ(countLines(path(), "marker-info"), 0);
+    EXPECT_EQ(countLines(path(), "marker-warn"), 1);
+}
+
+TEST_F(AsyncLoggerTest, ShutdownDrainsQueuedLines) {
+    Logger::getInstance().init(config_);
+    for (int i = 0; i < 100; i++) {
+        CHAT_LOG_INFO("marker-drain");
+    }
+    Logger::getInstance().shutdown();
+    EXPECT_EQ(countLines(path(), "marker-drain"), 100);
+}
+
+TEST_F(AsyncLoggerTest, FilteredMacroDoesNotEvaluateArguments) {
+    config_.level = LogLevel::INFO;
+    Logger::getInstance().init(config_);
+    int evaluated = 0;
+    auto expensive = [&evaluated]() {
+        evaluated++;
+        return std::string("marker-debug");
+    };
+    CHAT_LOG_DEBUG(expensive());
+    CHAT_LOG_DEBUG_F("%s", expensive().c_str());
+    EXPECT_EQ(evaluated, 0);
+    CHAT_LOG_INFO(expensive());
+    EXPECT_EQ(evaluated, 1);
+}
+
+TEST(LoggerFormatTest, FormatsLongMessagesWithoutTruncation) {
+    std::string longArg(2000, 'x');
+    std::string out = Logger::format("id=%d name=%s", 42, longArg.c_str());
+    EXPECT_EQ(out, "id=42 name=" + longArg);
+}
+
+TEST_F(AsyncLoggerTest, LinePrefixHasMillisecondTimestampLevelAndThread) {
+    Logger::getInstance().init(config_);
+    CHAT_LOG_WARN("marker-prefix");
+    Logger::getInstance().flush();
+
+    std::ifstream in(path());
+    std::string line;
+    std::string found;
+    while (std::getline(in, line)) {
+        if (line.find("marker-prefix") != std::string::npos) {
+            found = line;
+        }
+    }
+    std::regex pattern(R"(^\[\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2}\.\d{3}\] \[WARN \] \[\d+\] \[async_logger_test\.cpp:\d+\] marker-prefix$)");
+    EXPECT_TRUE(std::regex_match(found, pattern)) << found;
+}
+
+TEST(MuduoLogBridgeTest, FindsLevelOfMuduoLines) {
+    LogLevel level = LogLevel::INFO;
+    std::string text = "20240501 08:15:30.123456Z  4321 WARN  pool exhausted - CommonconnectionPool.cpp:218\n";
+    ASSERT_TRUE(MuduoLogBridge::levelOf(text.data(), static_cast<int>(text.size()), level));
+    EXPECT_EQ(level, LogLevel::WARN);
+
+    text = "20240501 08:15:30.123456 123456 ERROR a - b failed - chatservice.cpp:7\n";
+    ASSERT_TRUE(MuduoLogBridge::levelOf(text.data(), static_cast<int>(text.size()), level));
+    EXPECT_EQ(level, LogLevel::ERROR);
+
+    text = "not a muduo line\n";
+    EXPECT_FALSE(MuduoLogBridge::levelOf(text.data(), static_cast<int>(text.size()), level));
+}
+
+TEST_F(AsyncLoggerTest, PreformattedLinesAreWrittenVerbatim) {
+    config_.level = LogLevel::WARN;
+    Logger::getInstance().init(config_);
+    std::string text = "20240501 08:15:30.123456Z  4321 WARN  marker-muduo - CommonconnectionPool.cpp:218";
+    Logger::getInstance().logFormatted(LogLevel::WARN, text.data(), text.size());
+    Logger::getInstance().logFormatted(LogLevel::INFO, "marker-filtered", 15);
+    Logger::getInstance().flush();
+
+    std::ifstream in(path());
+    std::string line;
+    std::string found;
+    while (std::getline(in, line)) {
+        if (line.find("marker-muduo") != std::string::npos) {
+            found = line;
+        }
+    }
+    EXPECT_EQ(found, text);
+    EXPECT_EQ(countLines(path(), "marker-filtered"), 0);
+}
+
+TEST_F(AsyncLoggerTest, RotationKeepsEveryLineAcrossFiles) {
+    config_.enableRotation = true;
+    config_.maxFileSize = 2048;
+    config_.maxFileCount = 50;
+    config_.blockWhenFull = true;
+    Logger::getInstance().init(config_);
+    const int kLines = 300;
+    for (int i = 0; i < kLines; i++) {
+        CHAT_LOG_INFO("marker-rotate " + std::to_string(i));
+    }
+    // 改名在后台完成，关闭后所有文件都已就位
+    Logger::getInstance().shutdown();
+
+    int total = countLines(path(), "marker-rotate");
+    int files = 1;
+    for (int i = 1; i < config_.maxFileCount; i++) {
+        std::string rotated = path() + "." + std::to_string(i);
+        if (::access(rotated.c_str(), F_OK) != 0) {
+            break;
+        }
+        total += countLines(rotated, "marker-rotate");
+        files++;
+        ::unlink(rotated.c_str());
+    }
+    EXPECT_EQ(total, kLines);
+    EXPECT_GT(files, 1);
+    // 未启用的备用文件在关闭时删除
+    EXPECT_NE(::access((path() + ".next").c_str(), F_OK), 0);
+}
+
+TEST_F(AsyncLoggerTest, TimedRotationSwitchesFiles) {
+    config_.enableRotation = true;
+    config_.rotateIntervalSeconds = 1;
+    Logger::getInstance().init(config_);
+    CHAT_LOG_INFO("marker-before");
+    Logger::getInstance().flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    CHAT_LOG_INFO("marker-after");
+    Logger::getInstance().shutdown();
+
+    // 轮转时刻对齐到整秒，期间可能轮转了一到两次
+    int before = 0;
+    for (int i = 1; i <= 2; i++) {
+        std::string rotated = path() + "." + std::to_string(i);
+        before += countLines(rotated, "marker-before");
+        ::unlink(rotated.c_str());
+    }
+    EXPECT_EQ(before, 1);
+    EXPECT_EQ(countLines(path(), "marker-before"), 0);
+    EXPECT_EQ(countLines(path(), "marker-after"), 1);
+}
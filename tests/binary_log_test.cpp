@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/Logger.hpp"
+#include "../include/server/common/BinaryLogFormat.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// 编码一组参数后按格式串还原
+template <typename... Args>
+static std::string roundTrip(const std::string& fmt, const Args&... args) {
+    BinaryLogBuffer buf;
+    BinaryLogEncoder::encode(buf, args...);
+
+    // 手工拼一个只有一个调用点、一条事件的文件
+    std::string file(BinaryLogFormat::kMagic, sizeof(BinaryLogFormat::kMagic));
+    auto put = [&file](const void* p, size_t n) { file.append(static_cast<const char*>(p), n); };
+    uint32_t id = 0;
+    uint8_t level = 1;
+    uint32_t line = 7;
+    uint16_t fileLen = 5;
+    uint16_t fmtLen = static_cast<uint16_t>(fmt.size());
+    file += BinaryLogFormat::kSiteRecord;
+    put(&id, 4); put(&level, 1); put(&line, 4);
+    put(&fileLen, 2); file += "a.cpp";
+    put(&fmtLen, 2); file += fmt;
+    uint64_t timeUs = 1000000;
+    uint32_t tid = 9;
+    uint16_t len = static_cast<uint16_t>(buf.size());
+    file += BinaryLogFormat::kEventRecord;
+    put(&id, 4); put(&timeUs, 8); put(&tid, 4); put(&len, 2);
+    put(buf.data(), buf.size());
+
+    std::istringstream in(file);
+    BinaryLogReader reader(in);
+    EXPECT_TRUE(reader.readHeader());
+    BinaryLogReader::Entry entry;
+    EXPECT_TRUE(reader.next(entry)) << reader.error();
+    EXPECT_FALSE(reader.next(entry));
+    EXPECT_TRUE(reader.error().empty()) << reader.error();
+    return BinaryLogReader::render(entry.fmt, entry.args);
+}
+
+TEST(BinaryLogFormatTest, RendersLikePrintf) {
+    std::string name = "alice";
+    EXPECT_EQ(roundTrip("user %d (%s) sent %zu bytes", 42, name, static_cast<size_t>(1024)),
+              "user 42 (alice) sent 1024 bytes");
+    EXPECT_EQ(roundTrip("%5d|%-4s|%05.1f|%c|%%", -3, "ab", 2.25, 'x'), "   -3|ab  |002.2|x|%");
+    EXPECT_EQ(roundTrip("%x %lx %llu", -1, 255L, 18446744073709551615ULL), "ffffffff ff 18446744073709551615");
+    EXPECT_EQ(roundTrip("%*d|%.*s", 4, 7, 2, "hello"), "   7|he");
+    const char* nothing = nullptr;
+    EXPECT_EQ(roundTrip("%s %d", nothing), "(null) <missing>");
+}
+
+TEST(BinaryLogFormatTest, LongArgumentsSpillOutOfInlineBuffer) {
+    std::string big(BinaryLogBuffer::kInlineBytes * 3, 'z');
+    EXPECT_EQ(roundTrip("%d:%s:%d", 1, big, 2), "1:" + big + ":2");
+}
+
+TEST(BinaryLogFormatTest, RejectsOtherFiles) {
+    std::istringstream in("[2024-01-01 00:00:00.000] [INFO ] text log");
+    BinaryLogReader reader(in);
+    EXPECT_FALSE(reader.readHeader());
+}
+
+class BinaryLogSinkTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        config_.logDir = "./binary_log_test_logs";
+        config_.logFileName = "text_" + std::to_string(getpid()) + ".log";
+        config_.binaryFileName = "bin_" + std::to_string(getpid()) + ".blog";
+        config_.enableConsole = false;
+        config_.enableRotation = false;
+        config_.enableBinary = true;
+        config_.level = LogLevel::INFO;
+        removeFiles();
+    }
+
+    void TearDown() override {
+        Logger::getInstance().shutdown();
+        removeFiles();
+    }
+
+    void removeFiles() {
+        ::unlink((config_.logDir + "/" + config_.logFileName).c_str());
+        ::unlink(binaryPath().c_str());
+        for (int i = 1; i < config_.maxFileCount; i++) {
+            ::unlink((binaryPath() + "." + std::to_string(i)).c_str());
+        }
+    }
+
+    std::string binaryPath() const { return config_.logDir + "/" + config_.binaryFileName; }
+
+    // 解码一个文件中含marker的事件
+    std::vector<std::string> decode(const std::string& path, const std::string& marker) {
+        std::ifstream in(path, std::ios::binary);
+        BinaryLogReader reader(in);
+        std::vector<std::string> lines;
+        if (!reader.readHeader()) {
+            ADD_FAILURE() << path << ": " << reader.error();
+            return lines;
+        }
+        BinaryLogReader::Entry entry;
+        while (reader.next(entry)) {
+            std::string text = BinaryLogReader::toText(entry);
+            if (text.find(marker) != std::string::npos) {
+                lines.push_back(text);
+            }
+        }
+        EXPECT_TRUE(reader.error().empty()) << reader.error();
+        return lines;
+    }
+
+    LogConfig config_;
+};
+
+TEST_F(BinaryLogSinkTest, MacrosWriteDecodableEvents) {
+    Logger::getInstance().init(config_);
+    for (int i = 0; i < 3; i++) {
+        CHAT_LOG_INFO_F("marker-f user %d sent %s", i, "hi");
+    }
+    CHAT_LOG_WARN("marker-plain " + std::to_string(7));
+    CHAT_LOG_DEBUG_F("marker-debug %d", 1);   // 低于运行期级别，不写入
+    Logger::getInstance().flush();
+
+    std::vector<std::string> lines = decode(binaryPath(), "marker-");
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_NE(lines[0].find("[INFO ]"), std::string::npos) << lines[0];
+    EXPECT_NE(lines[0].find("[binary_log_test.cpp:"), std::string::npos) << lines[0];
+    EXPECT_NE(lines[2].find("marker-f user 2 sent hi"), std::string::npos) << lines[2];
+    EXPECT_NE(lines[3].find("[WARN ]"), std::string::npos) << lines[3];
+    EXPECT_NE(lines[3].find("marker-plain 7"), std::string::npos) << lines[3];
+}
+
+TEST_F(BinaryLogSinkTest, EveryRotatedFileCarriesItsCallSites) {
+    config_.enableRotation = true;
+    config_.maxFileSize = 4096;
+    config_.maxFileCount = 3;
+    Logger::getInstance().init(config_);
+    for (int i = 0; i < 400; i++) {
+        CHAT_LOG_INFO_F("marker-rot %d %s", i, "padding-padding-padding");
+    }
+    // 改名在后台完成，关闭后才确定
+    Logger::getInstance().shutdown();
+
+    // 当前文件和上一个文件都能单独解码，事件编号连续
+    std::vector<std::string> previous = decode(binaryPath() + ".1", "marker-rot");
+    std::vector<std::string> current = decode(binaryPath(), "marker-rot");
+    ASSERT_FALSE(previous.empty());
+    ASSERT_FALSE(current.empty());
+    EXPECT_NE(current.back().find("marker-rot 399 padding"), std::string::npos) << current.back();
+}
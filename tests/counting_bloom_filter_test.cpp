@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/CountingBloomFilter.hpp"
+#include <string>
+
+TEST(CountingBloomFilterTest, NoFalseNegatives) {
+    CountingBloomFilter filter(10000, 0.01);
+    for (int id = 1; id <= 10000; id++) {
+        filter.add(id);
+    }
+    for (int id = 1; id <= 10000; id++) {
+        EXPECT_TRUE(filter.mightContain(id));
+    }
+    EXPECT_EQ(filter.size(), 10000u);
+}
+
+TEST(CountingBloomFilterTest, FalsePositiveRateNearTarget) {
+    CountingBloomFilter filter(10000, 0.01);
+    for (int id = 1; id <= 10000; id++) {
+        filter.add(id);
+    }
+    int falsePositives = 0;
+    for (int id = 1000000; id < 1100000; id++) {
+        falsePositives += filter.mightContain(id) ? 1 : 0;
+    }
+    // 目标1%，留出余量
+    EXPECT_LT(falsePositives, 2000);
+}
+
+TEST(CountingBloomFilterTest, RemoveDeletesOnlyThatItem) {
+    CountingBloomFilter filter(1000, 0.01);
+    filter.add(std::string("alice"));
+    filter.add(std::string("bob"));
+    filter.remove(std::string("alice"));
+    EXPECT_FALSE(filter.mightContain(std::string("alice")));
+    EXPECT_TRUE(filter.mightContain(std::string("bob")));
+    // 删除不存在的元素不影响已有元素
+    filter.remove(std::string("carol"));
+    EXPECT_TRUE(filter.mightContain(std::string("bob")));
+    EXPECT_EQ(filter.size(), 1u);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "../include/server/model/csrGraph.hpp"
+
+TEST(CsrGraphTest, BuildDeduplicatesAndSortsNeighbors) {
+    CsrGraph graph;
+    graph.build({{1, 3}, {1, 2}, {2, 1}, {1, 3}, {5, 1}});
+    EXPECT_EQ(graph.neighbors(1), (std::vector<int>{2, 3}));
+    EXPECT_EQ(graph.neighbors(2), (std::vector<int>{1}));
+    EXPECT_TRUE(graph.neighbors(4).empty());
+    EXPECT_EQ(graph.edgeCount(), 4u);
+    EXPECT_TRUE(graph.hasEdge(5, 1));
+    EXPECT_FALSE(graph.hasEdge(1, 5));
+}
+
+TEST(CsrGraphTest, OverlayAddsAndRemovesEdges) {
+    CsrGraph graph;
+    graph.build({{1, 2}, {1, 3}});
+    EXPECT_TRUE(graph.addEdge(1, 4));
+    EXPECT_FALSE(graph.addEdge(1, 2));
+    EXPECT_TRUE(graph.removeEdge(1, 3));
+    EXPECT_FALSE(graph.removeEdge(1, 3));
+    EXPECT_TRUE(graph.addEdge(7, 1));
+    EXPECT_EQ(graph.neighbors(1), (std::vector<int>{2, 4}));
+    EXPECT_EQ(graph.neighbors(7), (std::vector<int>{1}));
+    EXPECT_EQ(graph.edgeCount(), 3u);
+
+    // 删除后再加回基础边只需撤销删除记录
+    EXPECT_TRUE(graph.addEdge(1, 3));
+    EXPECT_TRUE(graph.hasEdge(1, 3));
+    EXPECT_EQ(graph.overlaySize(), 2u);
+}
+
+TEST(CsrGraphTest, CompactMergesOverlayIntoBase) {
+    CsrGraph graph;
+    graph.build({{1, 2}, {3, 1}});
+    graph.addEdge(2, 9);
+    graph.addEdge(1, 0);
+    graph.removeEdge(3, 1);
+    graph.compact();
+    EXPECT_EQ(graph.overlaySize(), 0u);
+    EXPECT_EQ(graph.neighbors(1), (std::vector<int>{0, 2}));
+    EXPECT_EQ(graph.neighbors(2), (std::vector<int>{9}));
+    EXPECT_TRUE(graph.neighbors(3).empty());
+    EXPECT_EQ(graph.edgeCount(), 3u);
+}
+
+TEST(CsrGraphTest, LargeOverlayCompactsAutomatically) {
+    CsrGraph graph;
+    graph.build({});
+    for (int i = 0; i < 5000; i++) {
+        graph.addEdge(i % 10, i);
+    }
+    EXPECT_LT(graph.overlaySize(), 5000u);
+    EXPECT_EQ(graph.edgeCount(), 5000u);
+    EXPECT_EQ(graph.neighbors(3).size(), 500u);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/DebounceQueue.hpp"
+#include <string>
+
+using Queue = DebounceQueue<int, int, std::string>;
+using std::chrono::milliseconds;
+
+TEST(DebounceQueueTest, HoldsUntilWindowElapses) {
+    Queue queue(milliseconds(100), 64);
+    auto start = Queue::Clock::now();
+    queue.add(1, 10, "online", start);
+    queue.add(1, 11, "online", start + milliseconds(50));
+    EXPECT_TRUE(queue.takeReady(start + milliseconds(99)).empty());
+    EXPECT_EQ(queue.nextDue(), start + milliseconds(100));
+
+    auto ready = queue.takeReady(start + milliseconds(100));
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready[0].first, 1);
+    ASSERT_EQ(ready[0].second.size(), 2u);
+    EXPECT_EQ(ready[0].second[0].first, 10);
+    EXPECT_EQ(ready[0].second[1].first, 11);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(DebounceQueueTest, CoalescesRepeatedKeysKeepingLatestValue) {
+    Queue queue(milliseconds(100), 64);
+    auto start = Queue::Clock::now();
+    queue.add(1, 10, "online", start);
+    queue.add(1, 20, "online", start);
+    queue.add(1, 10, "offline", start);
+    auto ready = queue.takeReady(start + milliseconds(100));
+    ASSERT_EQ(ready.size(), 1u);
+    ASSERT_EQ(ready[0].second.size(), 2u);
+    // 保持首次出现的顺序，值取最新
+    EXPECT_EQ(ready[0].second[0].first, 10);
+    EXPECT_EQ(ready[0].second[0].second, "offline");
+    EXPECT_EQ(ready[0].second[1].second, "online");
+}
+
+TEST(DebounceQueueTest, FullBatchIsReadyImmediately) {
+    Queue queue(milliseconds(1000), 3);
+    auto start = Queue::Clock::now();
+    EXPECT_FALSE(queue.add(1, 1, "online", start));
+    EXPECT_FALSE(queue.add(1, 2, "online", start));
+    EXPECT_TRUE(queue.add(1, 3, "online", start));
+    queue.add(2, 1, "online", start);
+    auto ready = queue.takeReady(start);
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready[0].first, 1);
+    EXPECT_EQ(queue.recipients(), 1u);
+}
+
+TEST(DebounceQueueTest, EraseDropsPendingBatch) {
+    Queue queue(milliseconds(100), 64);
+    auto start = Queue::Clock::now();
+    queue.add(1, 10, "online", start);
+    queue.add(2, 10, "online", start);
+    queue.erase(1);
+    auto all = queue.takeAll();
+    ASSERT_EQ(all.size(), 1u);
+    EXPECT_EQ(all[0].first, 2);
+    EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/FlightRecorder.hpp"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static std::string dumpToString() {
+    char path[] = "/tmp/flight_recorder_test_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_GE(fd, 0);
+    FlightRecorder::dumpTo(fd);
+    close(fd);
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    unlink(path);
+    return content.str();
+}
+
+// 取出某个线程段内的事件行
+static std::vector<std::string> threadEvents(const std::string& dump, long tid, std::string* header = nullptr) {
+    std::vector<std::string> lines;
+    std::istringstream in(dump);
+    std::string line;
+    bool inSection = false;
+    std::string prefix = "# thread " + std::to_string(tid) + " ";
+    while (std::getline(in, line)) {
+        if (line.compare(0, 2, "# ") == 0) {
+            inSection = line.compare(0, prefix.size(), prefix) == 0;
+            if (inSection && header != nullptr) {
+                *header = line;
+            }
+            continue;
+        }
+        if (inSection) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+TEST(FlightRecorderTest, EventsAreKeptPerThreadInOrder) {
+    long tid = 0;
+    std::thread worker([&tid]() {
+        tid = syscall(SYS_gettid);
+        FlightRecorder::record(FlightEvent::MSG_RECEIVED, 120);
+        FlightRecorder::record(FlightEvent::DB_QUERY_START, 1);
+        FlightRecorder::record(FlightEvent::DB_QUERY_END, 1, 1);
+        FlightRecorder::record(FlightEvent::MSG_SENT, 42, -7);
+        FlightRecorder::record(FlightEvent::MSG_DISPATCHED, 5);
+    });
+    worker.join();
+
+    std::string dump = dumpToString();
+    std::vector<std::string> lines = threadEvents(dump, tid);
+    ASSERT_EQ(lines.size(), 5u) << dump;
+    EXPECT_NE(lines[0].find(" MSG_RECEIVED a=120 b=0"), std::string::npos) << lines[0];
+    EXPECT_NE(lines[2].find(" DB_QUERY_END a=1 b=1"), std::string::npos) << lines[2];
+    EXPECT_NE(lines[3].find(" MSG_SENT a=42 b=-7"), std::string::npos) << lines[3];
+    EXPECT_NE(lines[4].find(" MSG_DISPATCHED a=5 b=0"), std::string::npos) << lines[4];
+    // 行首为微秒时间戳，段内不递减
+    for (size_t i = 1; i < lines.size(); i++) {
+        EXPECT_LE(std::stoull(lines[i - 1]), std::stoull(lines[i]));
+    }
+}
+
+TEST(FlightRecorderTest, RingKeepsNewestEvents) {
+    long tid = 0;
+    const int total = static_cast<int>(FlightRecorder::kEventsPerThread) + 500;
+    std::thread worker([&tid, total]() {
+        tid = syscall(SYS_gettid);
+        for (int i = 0; i < total; i++) {
+            FlightRecorder::record(FlightEvent::REDIS_PUBLISH, i, 1);
+        }
+    });
+    worker.join();
+
+    std::string header;
+    std::vector<std::string> lines = threadEvents(dumpToString(), tid, &header);
+    const size_t capacity = FlightRecorder::kEventsPerThread;
+    ASSERT_EQ(lines.size(), capacity);
+    EXPECT_NE(header.find("events 1024/1524"), std::string::npos) << header;
+    EXPECT_NE(lines.front().find(" REDIS_PUBLISH a=500 b=1"), std::string::npos) << lines.front();
+    EXPECT_NE(lines.back().find(" REDIS_PUBLISH a=1523 b=1"), std::string::npos) << lines.back();
+}
+
+TEST(FlightRecorderTest, DumpWhileWritersRun) {
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 3; t++) {
+        writers.emplace_back([&stop]() {
+            int64_t i = 0;
+            while (!stop.load()) {
+                FlightRecorder::record(FlightEvent::MSG_RECEIVED, i++);
+            }
+        });
+    }
+    for (int i = 0; i < 20; i++) {
+        std::string dump = dumpToString();
+        EXPECT_EQ(dump.find("UNKNOWN"), std::string::npos);
+    }
+    stop = true;
+    for (auto& writer : writers) {
+        writer.join();
+    }
+}
+
+TEST(FlightRecorderTest, DumpWritesNamedFile) {
+    char dir[] = "/tmp/flight_recorder_dir_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    FlightRecorder::setDumpDirectory(dir);
+    FlightRecorder::record(FlightEvent::MSG_RECEIVED, 9);
+    std::string path = FlightRecorder::dump();
+    ASSERT_FALSE(path.empty());
+    EXPECT_EQ(path.compare(0, strlen(dir) + 8, std::string(dir) + "/flight-"), 0) << path;
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    EXPECT_NE(content.str().find(" MSG_RECEIVED a=9 b=0"), std::string::npos);
+    unlink(path.c_str());
+    rmdir(dir);
+}
+
+// 读出死亡测试子进程写出的<dir>/flight-<pid>-crash.log并删除目录
+static std::string takeCrashFile(const char* dir) {
+    std::string crashFile;
+    DIR* handle = opendir(dir);
+    EXPECT_NE(handle, nullptr);
+    if (handle == nullptr) {
+        return "";
+    }
+    while (dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name.size() > 10 && name.compare(name.size() - 10, 10, "-crash.log") == 0) {
+            crashFile = std::string(dir) + "/" + name;
+        }
+    }
+    closedir(handle);
+    EXPECT_FALSE(crashFile.empty());
+    std::ifstream in(crashFile);
+    std::stringstream content;
+    content << in.rdbuf();
+    unlink(crashFile.c_str());
+    rmdir(dir);
+    return content.str();
+}
+
+// 每层占用一页栈且结果依赖递归返回值，不会被优化成循环
+static int exhaustStack(int depth) {
+    volatile char frame[4096];
+    frame[0] = static_cast<char>(depth);
+    if (depth < 0) {
+        return 0;
+    }
+    return exhaustStack(depth + 1) + frame[0];
+}
+
+TEST(FlightRecorderDeathTest, CrashHandlerWritesEventsBeforeDying) {
+    char dir[] = "/tmp/flight_recorder_crash_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    EXPECT_DEATH({
+        FlightRecorder::setDumpDirectory(dir);
+        FlightRecorder::installCrashHandler();
+        FlightRecorder::record(FlightEvent::DB_QUERY_START, 77);
+        raise(SIGSEGV);
+    }, "flight recorder written to");
+
+    std::string content = takeCrashFile(dir);
+    EXPECT_NE(content.find("# fatal signal 11"), std::string::npos) << content;
+    EXPECT_NE(content.find(" DB_QUERY_START a=77 b=0"), std::string::npos) << content;
+}
+
+TEST(FlightRecorderDeathTest, StackOverflowOnWorkerThreadIsRecorded) {
+    char dir[] = "/tmp/flight_recorder_crash_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    EXPECT_DEATH({
+        FlightRecorder::setDumpDirectory(dir);
+        FlightRecorder::installCrashHandler();
+        // 备用栈在线程第一次记录时设置，处理函数不依赖已经耗尽的线程栈
+        std::thread worker([]() {
+            FlightRecorder::record(FlightEvent::MSG_DISPATCHED, 5);
+            exhaustStack(0);
+        });
+        worker.join();
+    }, "flight recorder written to");
+
+    std::string content = takeCrashFile(dir);
+    EXPECT_NE(content.find("# fatal signal 11"), std::string::npos) << content;
+    EXPECT_NE(content.find(" MSG_DISPATCHED a=5 b=0"), std::string::npos) << content;
+}
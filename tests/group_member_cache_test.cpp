@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include "../include/server/model/groupMemberCache.hpp"
+#include <thread>
+
+TEST(GroupMemberCacheTest, PutSortsAndDeduplicates) {
+    GroupMemberCache cache;
+    EXPECT_EQ(cache.get(1), nullptr);
+    EXPECT_TRUE(cache.put(1, {30, 10, 20, 10}, cache.version(1)));
+    auto members = cache.get(1);
+    ASSERT_NE(members, nullptr);
+    EXPECT_EQ(*members, (std::vector<int>{10, 20, 30}));
+}
+
+TEST(GroupMemberCacheTest, AddMemberCopiesOnWrite) {
+    GroupMemberCache cache;
+    cache.put(1, {10, 30}, cache.version(1));
+    auto before = cache.get(1);
+    cache.addMember(1, 20);
+    cache.addMember(1, 20);
+    // 旧快照不受影响
+    EXPECT_EQ(*before, (std::vector<int>{10, 30}));
+    EXPECT_EQ(*cache.get(1), (std::vector<int>{10, 20, 30}));
+    // 未缓存的群不会凭一个成员建出不完整的条目
+    cache.addMember(2, 10);
+    EXPECT_EQ(cache.get(2), nullptr);
+}
+
+TEST(GroupMemberCacheTest, StaleLoadIsDiscarded) {
+    GroupMemberCache cache;
+    unsigned long long version = cache.version(1);
+    // 加载期间有成员加入
+    cache.addMember(1, 40);
+    EXPECT_FALSE(cache.put(1, {10}, version));
+    EXPECT_EQ(cache.get(1), nullptr);
+    EXPECT_TRUE(cache.put(1, {10, 40}, cache.version(1)));
+    cache.invalidate(1);
+    EXPECT_EQ(cache.get(1), nullptr);
+}
+
+TEST(GroupMemberCacheTest, ExpiredEntriesAreReloaded) {
+    GroupMemberCache cache(100, std::chrono::seconds(0));
+    cache.put(1, {10}, cache.version(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(cache.get(1), nullptr);
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/InstrumentedMutex.hpp"
+#include "../include/server/common/Metrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <thread>
+
+static MetricCounter& acquisitions(const char* name) {
+    return MetricsRegistry::instance().counter("chat_lock_acquisitions_total", "", MetricsRegistry::label("lock", name));
+}
+
+static MetricCounter& contended(const char* name) {
+    return MetricsRegistry::instance().counter("chat_lock_contended_total", "", MetricsRegistry::label("lock", name));
+}
+
+// 统计默认关闭：记下默认值，并在用例开始前打开
+static const bool g_enabledByDefault = InstrumentedMutex::enabled();
+
+class EnableLockStats : public ::testing::Environment {
+public:
+    void SetUp() override { InstrumentedMutex::setEnabled(true); }
+};
+
+static ::testing::Environment* const g_enableLockStats = ::testing::AddGlobalTestEnvironment(new EnableLockStats);
+
+TEST(InstrumentedMutexTest, DisabledByDefault) {
+    EXPECT_FALSE(g_enabledByDefault);
+}
+
+TEST(InstrumentedMutexTest, CountsAcquisitionsPerLockName) {
+    InstrumentedMutex a("test_shared");
+    InstrumentedMutex b("test_shared");   // 同名实例共用统计
+    for (int i = 0; i < 10; i++) {
+        std::lock_guard<InstrumentedMutex> lock(i % 2 == 0 ? a : b);
+    }
+    ASSERT_TRUE(a.try_lock());
+    EXPECT_FALSE(a.try_lock());   // 失败的try_lock不计数
+    a.unlock();
+    EXPECT_EQ(acquisitions("test_shared").value(), 11u);
+    EXPECT_EQ(contended("test_shared").value(), 0u);
+}
+
+TEST(InstrumentedMutexTest, RecordsWaitAndBlamesHolder) {
+    InstrumentedMutex mutex("test_contended");
+    std::unique_lock<InstrumentedMutex> held(mutex);
+    std::thread waiter([&mutex]() {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    held.unlock();
+    waiter.join();
+
+    EXPECT_EQ(acquisitions("test_contended").value(), 2u);
+    EXPECT_EQ(contended("test_contended").value(), 1u);
+    HdrHistogram& wait = MetricsRegistry::instance().histogram("chat_lock_wait_microseconds", "",
+                                                               MetricsRegistry::label("lock", "test_contended"));
+    EXPECT_EQ(wait.count(), 1u);
+    EXPECT_GE(wait.max(), 10000);
+
+    std::string report = InstrumentedMutex::dumpAll();
+    size_t pos = report.find("[lock test_contended] acquisitions=2 contended=1");
+    ASSERT_NE(pos, std::string::npos) << report;
+    // 持有者调用点解析为 模块+偏移，而不是<unknown>
+    size_t holder = report.find("  holder contended=1 wait=", pos);
+    ASSERT_NE(holder, std::string::npos) << report;
+    EXPECT_EQ(report.find("<unknown>", pos), std::string::npos) << report;
+    EXPECT_NE(report.find("+0x", holder), std::string::npos) << report;
+}
+
+// 两个不同的持有者：加锁后通知等待方，再持有一段时间，让等待方的阻塞记在各自的调用点名下
+static const int kGuardLine = __LINE__ + 2;
+static void holdFromGuard(InstrumentedMutex& mutex, std::atomic<bool>& held) {
+    std::lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(mutex));
+    held = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+static const int kUniqueLockLine = __LINE__ + 2;
+static void holdFromUniqueLock(InstrumentedMutex& mutex, std::atomic<bool>& held) {
+    std::unique_lock<InstrumentedMutex> lock(CHAT_LOCK_SITE(mutex));
+    held = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+static void waitBehind(InstrumentedMutex& mutex, void (*holder)(InstrumentedMutex&, std::atomic<bool>&)) {
+    std::atomic<bool> held{false};
+    std::thread thread(holder, std::ref(mutex), std::ref(held));
+    while (!held) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<InstrumentedMutex> lock(CHAT_LOCK_SITE(mutex));
+    }
+    thread.join();
+}
+
+TEST(InstrumentedMutexTest, BlamesDistinctMarkedSites) {
+    InstrumentedMutex mutex("test_two_holders");
+    waitBehind(mutex, holdFromGuard);
+    waitBehind(mutex, holdFromUniqueLock);
+    EXPECT_EQ(contended("test_two_holders").value(), 2u);
+
+    // 与优化级别无关，两次等待分别记在两个持有者的 文件名:行号 名下
+    std::string report = InstrumentedMutex::dumpAll();
+    size_t pos = report.find("[lock test_two_holders]");
+    ASSERT_NE(pos, std::string::npos) << report;
+    size_t end = report.find("[lock ", pos + 1);
+    std::string section = report.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    EXPECT_NE(section.find("contended=1 wait=", 0), std::string::npos) << section;
+    EXPECT_NE(section.find("at instrumented_mutex_test.cpp:" + std::to_string(kGuardLine) + "\n"), std::string::npos) << section;
+    EXPECT_NE(section.find("at instrumented_mutex_test.cpp:" + std::to_string(kUniqueLockLine) + "\n"), std::string::npos) << section;
+    EXPECT_EQ(section.find("<unknown>"), std::string::npos) << section;
+}
+
+TEST(InstrumentedMutexTest, UnconsumedSiteDoesNotLeakToNextLock) {
+    InstrumentedMutex mutex("test_try_lock_site");
+    // try_lock失败时标记留给随后的lock()，成功加锁后标记被取走
+    ASSERT_TRUE(CHAT_LOCK_SITE(mutex).try_lock());
+    mutex.unlock();
+    std::unique_lock<InstrumentedMutex> held(mutex);
+    std::thread waiter([&mutex]() {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    held.unlock();
+    waiter.join();
+    std::string report = InstrumentedMutex::dumpAll();
+    size_t pos = report.find("[lock test_try_lock_site]");
+    ASSERT_NE(pos, std::string::npos) << report;
+    size_t end = report.find("[lock ", pos + 1);
+    std::string section = report.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    // 持有者是未标记的unique_lock，显示为返回地址而不是上面try_lock的行号
+    EXPECT_EQ(section.find("instrumented_mutex_test.cpp:"), std::string::npos) << section;
+    EXPECT_NE(section.find("+0x"), std::string::npos) << section;
+}
+
+TEST(InstrumentedMutexTest, WorksWithConditionVariableAny) {
+    InstrumentedMutex mutex("test_cv");
+    std::condition_variable_any cv;
+    bool ready = false;
+    std::thread producer([&]() {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+        ready = true;
+        cv.notify_one();
+    });
+    {
+        std::unique_lock<InstrumentedMutex> lock(mutex);
+        cv.wait(lock, [&ready]() { return ready; });
+    }
+    producer.join();
+    EXPECT_GE(acquisitions("test_cv").value(), 2u);
+}
+
+TEST(InstrumentedMutexTest, RuntimeSwitchStopsCounting) {
+    InstrumentedMutex mutex("test_disabled");
+    InstrumentedMutex::setEnabled(false);
+    {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+    }
+    InstrumentedMutex::setEnabled(true);
+    EXPECT_EQ(acquisitions("test_disabled").value(), 0u);
+    {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+    }
+    EXPECT_EQ(acquisitions("test_disabled").value(), 1u);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/Metrics.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(HdrHistogramTest, BucketsCoverEveryValueWithBoundedError) {
+    // 小值精确，大值的桶上界相对误差不超过1/64，且桶是连续的
+    for (uint64_t v = 0; v < HdrHistogram::kSubBucketCount; v++) {
+        EXPECT_EQ(HdrHistogram::bucketUpperBound(HdrHistogram::bucketIndex(v)), v);
+    }
+    for (uint64_t v : {128ULL, 129ULL, 1000ULL, 65535ULL, 1234567ULL, (1ULL << 35) + 12345}) {
+        uint64_t upper = HdrHistogram::bucketUpperBound(HdrHistogram::bucketIndex(v));
+        EXPECT_GE(upper, v);
+        EXPECT_LE(upper - v, v / 64) << v;
+    }
+    for (size_t i = 1; i < HdrHistogram::kBucketCount; i++) {
+        ASSERT_EQ(HdrHistogram::bucketIndex(HdrHistogram::bucketUpperBound(i - 1) + 1), i);
+    }
+    EXPECT_EQ(HdrHistogram::bucketIndex(1ULL << 50), HdrHistogram::kBucketCount - 1);
+}
+
+TEST(HdrHistogramTest, PercentilesOfUniformValues) {
+    HdrHistogram h;
+    EXPECT_EQ(h.percentile(99), 0);
+    for (int v = 1; v <= 10000; v++) {
+        h.record(v);
+    }
+    EXPECT_EQ(h.count(), 10000u);
+    EXPECT_EQ(h.sum(), 10000u * 10001u / 2);
+    EXPECT_EQ(h.max(), 10000);
+    EXPECT_NEAR(h.percentile(50), 5000, 5000 / 64 + 1);
+    EXPECT_NEAR(h.percentile(99), 9900, 9900 / 64 + 1);
+    EXPECT_NEAR(h.percentile(99.9), 9990, 9990 / 64 + 1);
+    EXPECT_EQ(h.percentile(100), 10000);
+    EXPECT_EQ(h.percentile(0), 1);
+
+    h.reset();
+    EXPECT_EQ(h.count(), 0u);
+    EXPECT_EQ(h.percentile(50), 0);
+}
+
+TEST(HdrHistogramTest, ConcurrentRecordsAreNotLost) {
+    HdrHistogram h;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&h, t]() {
+            for (int i = 0; i < 50000; i++) {
+                h.record(t * 1000 + i % 1000);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(h.count(), 200000u);
+    EXPECT_EQ(h.max(), 3999);
+}
+
+TEST(MetricsRegistryTest, RendersPrometheusText) {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    MetricCounter& counter = registry.counter("test_requests_total", "Requests", MetricsRegistry::label("msgid", "5"));
+    EXPECT_EQ(&counter, &registry.counter("test_requests_total", "Requests", MetricsRegistry::label("msgid", "5")));
+    counter.inc();
+    counter.inc(2);
+    registry.gauge("test_online", "Online users").set(-3);
+    registry.gaugeCallback("test_queue_depth", "Queue", []() { return int64_t(42); });
+    HdrHistogram& latency = registry.histogram("test_latency_microseconds", "Latency", MetricsRegistry::label("msgid", "5"));
+    for (int i = 0; i < 100; i++) {
+        latency.record(100);
+    }
+
+    std::string text = registry.renderPrometheus();
+    EXPECT_NE(text.find("# TYPE test_requests_total counter\ntest_requests_total{msgid=\"5\"} 3\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_online -3\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_queue_depth 42\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("# TYPE test_latency_microseconds summary\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_microseconds{msgid=\"5\",quantile=\"0.5\"} 100\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_microseconds{msgid=\"5\",quantile=\"0.999\"} 100\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_microseconds_sum{msgid=\"5\"} 10000\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_microseconds_count{msgid=\"5\"} 100\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("# TYPE test_latency_microseconds_max gauge\n"), std::string::npos) << text;
+
+    EXPECT_THROW(registry.gauge("test_requests_total", "Requests"), std::logic_error);
+    EXPECT_EQ(MetricsRegistry::label("path", "a\"b\\c"), "path=\"a\\\"b\\\\c\"");
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/MpscRingBuffer.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(MpscRingBufferTest, CapacityRoundsUpToPowerOfTwo) {
+    MpscRingBuffer<int> ring(1000);
+    EXPECT_EQ(ring.capacity(), 1024u);
+}
+
+TEST(MpscRingBufferTest, FullQueueRejectsWithoutConsumingValue) {
+    MpscRingBuffer<std::string> ring(4);
+    for (int i = 0; i < 4; i++) {
+        std::string value = "line" + std::to_string(i);
+        ASSERT_TRUE(ring.tryPush(value));
+    }
+    std::string extra = "overflow";
+    EXPECT_FALSE(ring.tryPush(extra));
+    EXPECT_EQ(extra, "overflow");
+
+    std::string out;
+    ASSERT_TRUE(ring.tryPop(out));
+    EXPECT_EQ(out, "line0");
+    EXPECT_TRUE(ring.tryPush(extra));
+    EXPECT_EQ(ring.sizeApprox(), 4u);
+}
+
+TEST(MpscRingBufferTest, ConcurrentProducersPreserveEveryItemInPerProducerOrder) {
+    const int kProducers = 4;
+    const int kItems = 100000;
+    MpscRingBuffer<std::pair<int, int>> ring(1024);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&ring, p]() {
+            for (int i = 0; i < kItems; i++) {
+                std::pair<int, int> item(p, i);
+                while (!ring.tryPush(item)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<int> next(kProducers, 0);
+    int received = 0;
+    std::pair<int, int> item;
+    while (received < kProducers * kItems) {
+        if (!ring.tryPop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        // 同一生产者的条目按入队顺序出队
+        ASSERT_EQ(item.second, next[item.first]);
+        next[item.first]++;
+        received++;
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    EXPECT_FALSE(ring.tryPop(item));
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "../include/server/db/PoolStats.h"
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * 延迟直方图分桶与分位数测试
+ */
+TEST(LatencyHistogramTest, BucketsAndPercentiles) {
+    LatencyHistogram hist;
+    EXPECT_EQ(hist.count(), 0u);
+    EXPECT_EQ(hist.percentile(99), 0);
+
+    // 90个1us，10个1000us
+    for (int i = 0; i < 90; i++) {
+        hist.record(1);
+    }
+    for (int i = 0; i < 10; i++) {
+        hist.record(1000);
+    }
+
+    EXPECT_EQ(hist.count(), 100u);
+    EXPECT_EQ(hist.sum(), 90u + 10000u);
+    EXPECT_EQ(hist.max(), 1000);
+    EXPECT_EQ(hist.percentile(50), 2);       // 1us 落在 [1,2) 桶
+    EXPECT_EQ(hist.percentile(90), 2);
+    EXPECT_EQ(hist.percentile(99), 1000);    // 上界被截断到最大值
+    EXPECT_EQ(hist.percentile(100), 1000);
+}
+
+/**
+ * 负数与超大值不越界
+ */
+TEST(LatencyHistogramTest, OutOfRangeValues) {
+    LatencyHistogram hist;
+    hist.record(-5);
+    hist.record(static_cast<int64_t>(1) << 40);
+    EXPECT_EQ(hist.bucketCount(0), 1u);
+    EXPECT_EQ(hist.bucketCount(LatencyHistogram::kBucketCount - 1), 1u);
+
+    hist.reset();
+    EXPECT_EQ(hist.count(), 0u);
+    EXPECT_EQ(hist.max(), 0);
+}
+
+/**
+ * 多线程并发记录不丢计数
+ */
+TEST(LatencyHistogramTest, ConcurrentRecord) {
+    PoolStats stats;
+    const int threads = 4;
+    const int perThread = 10000;
+
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&stats, perThread]() {
+            for (int i = 0; i < perThread; i++) {
+                stats.waitTime.record(i % 100);
+                stats.checkouts++;
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    EXPECT_EQ(stats.waitTime.count(), static_cast<uint64_t>(threads * perThread));
+    EXPECT_EQ(stats.checkouts.load(), static_cast<uint64_t>(threads * perThread));
+
+    string report = stats.dump("test", 3, 5);
+    EXPECT_NE(report.find("total=5"), string::npos);
+    EXPECT_NE(report.find("checkouts=40000"), string::npos);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/ShardedCache.hpp"
+#include <thread>
+#include <vector>
+#include <string>
+
+TEST(ShardedCacheTest, GetPutUpdateInvalidate) {
+    ShardedCache<int, std::string> cache(64, std::chrono::milliseconds(0), 4);
+    std::string value;
+    EXPECT_FALSE(cache.get(1, value));
+    EXPECT_TRUE(cache.put(1, "a"));
+    ASSERT_TRUE(cache.get(1, value));
+    EXPECT_EQ(value, "a");
+
+    EXPECT_TRUE(cache.update(1, [](std::string& v) { v += "b"; }));
+    EXPECT_FALSE(cache.update(2, [](std::string& v) { v = "x"; }));
+    ASSERT_TRUE(cache.get(1, value));
+    EXPECT_EQ(value, "ab");
+
+    cache.invalidate(1);
+    EXPECT_FALSE(cache.get(1, value));
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 2u);
+}
+
+TEST(ShardedCacheTest, EntriesExpireAfterTtl) {
+    ShardedCache<int, int> cache(64, std::chrono::milliseconds(1), 1);
+    cache.put(1, 10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int value = 0;
+    EXPECT_FALSE(cache.get(1, value));
+    EXPECT_EQ(cache.stats().expirations, 1u);
+}
+
+TEST(ShardedCacheTest, AdmissionKeepsHotKeysUnderScan) {
+    ShardedCache<int, int> cache(64, std::chrono::milliseconds(0), 1);
+    int value = 0;
+    // 热点key被反复访问
+    for (int round = 0; round < 5; round++) {
+        for (int key = 0; key < 64; key++) {
+            if (!cache.get(key, value)) {
+                cache.put(key, key);
+            }
+        }
+    }
+    // 一次性扫描冷key，数量是容量的4倍
+    for (int key = 1000; key < 1256; key++) {
+        if (!cache.get(key, value)) {
+            cache.put(key, key);
+        }
+    }
+    int retained = 0;
+    for (int key = 0; key < 64; key++) {
+        retained += cache.get(key, value) ? 1 : 0;
+    }
+    EXPECT_EQ(retained, 64);
+    EXPECT_GT(cache.stats().rejections, 0u);
+}
+
+TEST(ShardedCacheTest, ConcurrentAccessIsSafe) {
+    ShardedCache<int, int> cache(1024, std::chrono::milliseconds(0));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&cache, t]() {
+            int value = 0;
+            for (int i = 0; i < 10000; i++) {
+                int key = (i * 7 + t) % 2048;
+                if (!cache.get(key, value)) {
+                    cache.put(key, key);
+                } else {
+                    EXPECT_EQ(value, key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_LE(cache.stats().size, 1024u);
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "../include/server/common/Tracer.hpp"
+#include "json.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+TEST(TracerTest, SamplesOneInN) {
+    Tracer tracer(64);
+    EXPECT_EQ(tracer.sample(), 0u);   // 默认关闭
+    tracer.setSampleEvery(4);
+    int sampled = 0;
+    uint64_t last = 0;
+    for (int i = 0; i < 100; i++) {
+        uint64_t id = tracer.sample();
+        if (id != 0) {
+            EXPECT_NE(id, last);
+            last = id;
+            sampled++;
+        }
+    }
+    EXPECT_EQ(sampled, 25);
+}
+
+TEST(TracerTest, IdRoundTripsThroughString) {
+    uint64_t id = 0x0123456789abcdefULL;
+    EXPECT_EQ(Tracer::idToString(id), "0123456789abcdef");
+    EXPECT_EQ(Tracer::idFromString(Tracer::idToString(id)), id);
+    EXPECT_EQ(Tracer::idFromString("ABCDEF"), 0xabcdefULL);
+    EXPECT_EQ(Tracer::idFromString(""), 0u);
+    EXPECT_EQ(Tracer::idFromString("xyz"), 0u);
+    EXPECT_EQ(Tracer::idFromString("00000000000000001"), 0u);
+}
+
+TEST(TracerTest, SpansRecordOnlyInsideTraceScope) {
+    Tracer& tracer = Tracer::instance();
+    size_t before = tracer.size();
+    {
+        TraceSpan untraced("untraced");
+    }
+    EXPECT_EQ(tracer.size(), before);
+    EXPECT_EQ(Tracer::current(), 0u);
+    {
+        TraceScope scope(0x42);
+        EXPECT_EQ(Tracer::current(), 0x42u);
+        {
+            TraceScope inner(0);   // 嵌套的不追踪上下文
+            TraceSpan skipped("skipped");
+        }
+        EXPECT_EQ(Tracer::current(), 0x42u);
+        TraceSpan outer("outer_stage", 7);
+        TraceSpan inner("inner_stage");
+    }
+    EXPECT_EQ(Tracer::current(), 0u);
+    EXPECT_EQ(tracer.size(), before + 2);
+
+    json doc = json::parse(tracer.exportChromeJson());
+    std::vector<std::string> names;
+    for (const json& event : doc["traceEvents"]) {
+        if (event["args"]["trace"] == Tracer::idToString(0x42)) {
+            EXPECT_EQ(event["ph"], "X");
+            EXPECT_GE(event["dur"].get<int64_t>(), 0);
+            names.push_back(event["name"].get<std::string>());
+        }
+    }
+    ASSERT_EQ(names.size(), 2u);
+    EXPECT_TRUE((names[0] == "outer_stage" && names[1] == "inner_stage") ||
+                (names[0] == "inner_stage" && names[1] == "outer_stage"));
+}
+
+TEST(TracerTest, RingKeepsNewestSpansUnderConcurrentWriters) {
+    Tracer tracer(16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&tracer, t]() {
+            for (int i = 0; i < 1000; i++) {
+                tracer.record(t + 1, "stage", i, 1000 + i, 1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(tracer.size(), 16u);
+    json doc = json::parse(tracer.exportChromeJson());
+    ASSERT_EQ(doc["traceEvents"].size(), 16u);
+    // 按开始时间排序
+    for (size_t i = 1; i < doc["traceEvents"].size(); i++) {
+        EXPECT_LE(doc["traceEvents"][i - 1]["ts"].get<uint64_t>(), doc["traceEvents"][i]["ts"].get<uint64_t>());
+    }
+}